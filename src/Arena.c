@@ -0,0 +1,112 @@
+#include "Arena.h"
+
+#include <stdlib.h>
+#include <memory.h>
+
+#define ARENA_ALIGNMENT      16
+#define ARENA_MIN_BLOCK_SIZE 1024
+#define ARENA_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+struct ArenaBlock {
+    ArenaBlock* Next;
+    uint64_t Size;
+    _Alignas(ARENA_ALIGNMENT) uint8_t Data[];
+};
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void* Arena_AllocatorReallocate(void* userData, void* ptr, uint64_t oldSize, uint64_t newSize) {
+    return Arena_Reallocate(userData, ptr, oldSize, newSize);
+}
+
+Arena* Arena_Create(uint64_t sizeHint) {
+    Arena* arena = malloc(sizeof(Arena));
+    if (!arena) {
+        return NULL;
+    }
+
+    *arena = (Arena){
+        .NextBlockSize = sizeHint < ARENA_MIN_BLOCK_SIZE ? ARENA_MIN_BLOCK_SIZE : AlignUp(sizeHint, ARENA_ALIGNMENT),
+        .Allocator =
+            (Allocator){
+                .Reallocate = Arena_AllocatorReallocate,
+                .UserData   = arena,
+            },
+    };
+    return arena;
+}
+
+void Arena_Destroy(Arena* arena) {
+    if (!arena) {
+        return;
+    }
+
+    ArenaBlock* block = arena->FirstBlock;
+    while (block) {
+        ArenaBlock* next = block->Next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+void* Arena_Allocate(Arena* arena, uint64_t size) {
+    size = AlignUp(size, ARENA_ALIGNMENT);
+
+    if (!arena->CurrentBlock || arena->Offset + size > arena->CurrentBlock->Size) {
+        // Blocks double in size so a growing arena only needs a few of them
+        uint64_t blockSize = arena->NextBlockSize;
+        while (blockSize < size) {
+            blockSize *= 2;
+        }
+        if (arena->NextBlockSize < ARENA_MAX_BLOCK_SIZE) {
+            arena->NextBlockSize *= 2;
+        }
+
+        ArenaBlock* block = malloc(sizeof(ArenaBlock) + blockSize);
+        if (!block) {
+            return NULL;
+        }
+
+        block->Next = NULL;
+        block->Size = blockSize;
+        if (arena->CurrentBlock) {
+            arena->CurrentBlock->Next = block;
+        } else {
+            arena->FirstBlock = block;
+        }
+        arena->CurrentBlock = block;
+        arena->Offset       = 0;
+    }
+
+    arena->Last = &arena->CurrentBlock->Data[arena->Offset];
+    arena->Offset += size;
+    return arena->Last;
+}
+
+void* Arena_Reallocate(Arena* arena, void* ptr, uint64_t oldSize, uint64_t newSize) {
+    if (ptr && ptr == arena->Last) {
+        uint64_t start = (uint8_t*)ptr - arena->CurrentBlock->Data;
+        if (newSize == 0) {
+            arena->Offset = start;
+            arena->Last   = NULL;
+            return NULL;
+        }
+        if (start + AlignUp(newSize, ARENA_ALIGNMENT) <= arena->CurrentBlock->Size) {
+            arena->Offset = start + AlignUp(newSize, ARENA_ALIGNMENT);
+            return ptr;
+        }
+    }
+
+    if (newSize == 0) {
+        return NULL;
+    }
+
+    void* result = Arena_Allocate(arena, newSize);
+    if (result && ptr) {
+        memcpy(result, ptr, oldSize < newSize ? oldSize : newSize);
+    }
+    return result;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Array.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator where everything is freed at once when the arena is destroyed
+// Freeing or growing the most recent allocation is done in place, anything else just leaves a hole
+typedef struct Arena {
+    ArenaBlock* FirstBlock;
+    ArenaBlock* CurrentBlock;
+    uint64_t Offset;
+    // The start of the most recent allocation, so it can be grown in place
+    uint8_t* Last;
+    uint64_t NextBlockSize;
+    // Lets arrays allocate from the arena
+    Allocator Allocator;
+} Arena;
+
+// The arena is allocated on the heap so the pointer stays valid when the owner is copied around
+// The first block is sizeHint bytes, it should be around how much memory the owner is expected to use
+Arena* Arena_Create(uint64_t sizeHint);
+void Arena_Destroy(Arena* arena);
+void* Arena_Allocate(Arena* arena, uint64_t size);
+void* Arena_Reallocate(Arena* arena, void* ptr, uint64_t oldSize, uint64_t newSize);
@@ -1,53 +1,103 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdlib.h>
 
-#define ARRAY_DECL(type, name)                                   \
-    typedef struct name##Array {                                 \
-        type* Data;                                              \
-        uint64_t Length;                                         \
-        uint64_t Capacity;                                       \
-    } name##Array;                                               \
-                                                                 \
-    name##Array name##Array_Create();                            \
-    void name##Array_Destroy(name##Array* array);                \
-                                                                 \
-    void name##Array_Clone(name##Array* out, name##Array array); \
-                                                                 \
-    type* name##Array_Push(name##Array* array, type value);      \
-    type name##Array_Pop(name##Array* array);                    \
+// Lets arrays get their memory from somewhere other than malloc
+// Reallocate is called with a NULL ptr to allocate and with a newSize of 0 to free
+typedef struct Allocator {
+    void* (*Reallocate)(void* userData, void* ptr, uint64_t oldSize, uint64_t newSize);
+    void* UserData;
+} Allocator;
+
+static inline void* Allocator_Reallocate(Allocator* allocator, void* ptr, uint64_t oldSize, uint64_t newSize) {
+    if (allocator) {
+        return allocator->Reallocate(allocator->UserData, ptr, oldSize, newSize);
+    }
+    if (newSize == 0) {
+        free(ptr);
+        return NULL;
+    }
+    return realloc(ptr, newSize);
+}
+
+#define ARRAY_DECL(type, name)                                                                \
+    typedef struct name##Array {                                                              \
+        type* Data;                                                                           \
+        uint64_t Length;                                                                      \
+        uint64_t Capacity;                                                                    \
+        /* NULL uses malloc */                                                                \
+        Allocator* Allocator;                                                                 \
+    } name##Array;                                                                            \
+                                                                                              \
+    name##Array name##Array_Create();                                                         \
+    name##Array name##Array_CreateWithAllocator(Allocator* allocator);                        \
+    void name##Array_Destroy(name##Array* array);                                             \
+                                                                                              \
+    void name##Array_Clone(name##Array* out, name##Array array);                              \
+                                                                                              \
+    /* Makes sure the array can hold at least capacity elements without growing */            \
+    void name##Array_Reserve(name##Array* array, uint64_t capacity);                          \
+    type* name##Array_Push(name##Array* array, type value);                                   \
+    /* Copies count elements to the end of the array and returns where they were put */       \
+    type* name##Array_Append(name##Array* array, const type* values, uint64_t count);         \
+    /* Adds count uninitialized elements to the end of the array for the caller to fill in */ \
+    type* name##Array_Emplace(name##Array* array, uint64_t count);                            \
+    type name##Array_Pop(name##Array* array);                                                 \
     type name##Array_Remove(name##Array* array, uint64_t index)
 
 #define ARRAY_IMPL(type, name)                                                                                       \
     name##Array name##Array_Create() {                                                                               \
+        return name##Array_CreateWithAllocator(NULL);                                                                \
+    }                                                                                                                \
+                                                                                                                     \
+    name##Array name##Array_CreateWithAllocator(Allocator* allocator) {                                              \
         return (name##Array){                                                                                        \
-            .Data     = NULL,                                                                                        \
-            .Length   = 0,                                                                                           \
-            .Capacity = 0,                                                                                           \
+            .Data      = NULL,                                                                                       \
+            .Length    = 0,                                                                                          \
+            .Capacity  = 0,                                                                                          \
+            .Allocator = allocator,                                                                                  \
         };                                                                                                           \
     }                                                                                                                \
                                                                                                                      \
     void name##Array_Destroy(name##Array* array) {                                                                   \
-        free(array->Data);                                                                                           \
+        Allocator_Reallocate(array->Allocator, array->Data, array->Capacity * sizeof(type), 0);                      \
                                                                                                                      \
         *array = (name##Array){                                                                                      \
-            .Data     = NULL,                                                                                        \
-            .Length   = 0,                                                                                           \
-            .Capacity = 0,                                                                                           \
+            .Data      = NULL,                                                                                       \
+            .Length    = 0,                                                                                          \
+            .Capacity  = 0,                                                                                          \
+            .Allocator = array->Allocator,                                                                           \
         };                                                                                                           \
     }                                                                                                                \
                                                                                                                      \
     void name##Array_Clone(name##Array* out, name##Array array) {                                                    \
-        out->Length   = array.Length;                                                                                \
-        out->Capacity = array.Length;                                                                                \
-        out->Data     = malloc(out->Length * sizeof(type));                                                          \
+        out->Length    = array.Length;                                                                               \
+        out->Capacity  = array.Length;                                                                               \
+        out->Allocator = array.Allocator;                                                                            \
+        out->Data      = Allocator_Reallocate(out->Allocator, NULL, 0, out->Length * sizeof(type));                  \
         memcpy(out->Data, array.Data, out->Length * sizeof(type));                                                   \
     }                                                                                                                \
                                                                                                                      \
+    void name##Array_Reserve(name##Array* array, uint64_t capacity) {                                                \
+        if (capacity <= array->Capacity) {                                                                           \
+            return;                                                                                                  \
+        }                                                                                                            \
+                                                                                                                     \
+        uint64_t newCapacity = array->Capacity == 0 ? 1 : array->Capacity * 2;                                       \
+        if (newCapacity < capacity) {                                                                                \
+            newCapacity = capacity;                                                                                  \
+        }                                                                                                            \
+        array->Data     = Allocator_Reallocate(array->Allocator,                                                     \
+                                           array->Data,                                                              \
+                                           array->Capacity * sizeof(type),                                           \
+                                           newCapacity * sizeof(type));                                              \
+        array->Capacity = newCapacity;                                                                               \
+    }                                                                                                                \
+                                                                                                                     \
     type* name##Array_Push(name##Array* array, type value) {                                                         \
         if (array->Length >= array->Capacity) {                                                                      \
-            array->Capacity = array->Capacity == 0 ? 1 : array->Capacity * 2;                                        \
-            array->Data     = realloc(array->Data, array->Capacity * sizeof(array->Data[0]));                        \
+            name##Array_Reserve(array, array->Length + 1);                                                           \
         }                                                                                                            \
                                                                                                                      \
         array->Data[array->Length] = value;                                                                          \
@@ -55,6 +105,19 @@
         return &array->Data[array->Length - 1];                                                                      \
     }                                                                                                                \
                                                                                                                      \
+    type* name##Array_Append(name##Array* array, const type* values, uint64_t count) {                               \
+        type* start = name##Array_Emplace(array, count);                                                             \
+        memcpy(start, values, count * sizeof(type));                                                                 \
+        return start;                                                                                                \
+    }                                                                                                                \
+                                                                                                                     \
+    type* name##Array_Emplace(name##Array* array, uint64_t count) {                                                  \
+        name##Array_Reserve(array, array->Length + count);                                                           \
+        type* start = &array->Data[array->Length];                                                                   \
+        array->Length += count;                                                                                      \
+        return start;                                                                                                \
+    }                                                                                                                \
+                                                                                                                     \
     type name##Array_Pop(name##Array* array) {                                                                       \
         return array->Data[--array->Length];                                                                         \
     }                                                                                                                \
@@ -0,0 +1,459 @@
+#include "Assembler.h"
+#include "Module.h"
+#include "Optimizer.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+
+ARRAY_IMPL(MacroDependency, MacroDependency);
+ARRAY_IMPL(AssemblerSection, AssemblerSection);
+
+typedef struct SourceSpan {
+    uint64_t Start;
+    uint64_t End;
+    uint64_t Line;
+    uint64_t Column;
+    bool IsMacro;
+} SourceSpan;
+
+ARRAY_DECL(SourceSpan, SourceSpan);
+ARRAY_IMPL(SourceSpan, SourceSpan);
+
+// Open addressing table from a hash to an index into some other array
+typedef struct IndexTable {
+    uint64_t* Hashes;
+    // Index + 1, so 0 is an empty slot
+    uint64_t* Indices;
+    uint64_t Mask;
+} IndexTable;
+
+static void IndexTable_Create(IndexTable* table, uint64_t count) {
+    uint64_t capacity = 16;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+    table->Hashes  = calloc(capacity, sizeof(uint64_t));
+    table->Indices = calloc(capacity, sizeof(uint64_t));
+    table->Mask    = capacity - 1;
+}
+
+static void IndexTable_Destroy(IndexTable* table) {
+    free(table->Hashes);
+    free(table->Indices);
+    *table = (IndexTable){};
+}
+
+static void IndexTable_Insert(IndexTable* table, uint64_t hash, uint64_t index) {
+    uint64_t slot = hash & table->Mask;
+    while (table->Indices[slot] != 0) {
+        slot = (slot + 1) & table->Mask;
+    }
+    table->Hashes[slot]  = hash;
+    table->Indices[slot] = index + 1;
+}
+
+// Splits the source at every label definition and around every macro definition
+// Only comments and strings have to be understood to do this, so it is a lot cheaper than lexing the file
+static SourceSpanArray SplitSource(String source) {
+    SourceSpanArray spans = SourceSpanArray_Create();
+
+    SourceSpan current = (SourceSpan){
+        .Start  = 0,
+        .Line   = 1,
+        .Column = 1,
+    };
+    uint64_t line   = 1;
+    uint64_t column = 1;
+    uint64_t i      = 0;
+
+#define SPLIT_AT(position, isMacro)                      \
+    do {                                                 \
+        current.End = (position);                        \
+        if (current.End > current.Start) {               \
+            SourceSpanArray_Push(&spans, current);       \
+        }                                                \
+        current = (SourceSpan){                          \
+            .Start   = (position),                       \
+            .Line    = line,                             \
+            .Column  = column,                           \
+            .IsMacro = (isMacro),                        \
+        };                                               \
+    } while (0)
+
+    while (i < source.Length) {
+        uint8_t chr = source.Data[i];
+        if (chr == '/' && i + 1 < source.Length && source.Data[i + 1] == '/') {
+            while (i < source.Length && source.Data[i] != '\n') {
+                i++;
+                column++;
+            }
+        } else if (chr == '"') {
+            // Strings end at the end of the line, like in the lexer
+            do {
+                i++;
+                column++;
+            } while (i < source.Length && source.Data[i] != '"' && source.Data[i] != '\n');
+            if (i < source.Length && source.Data[i] == '"') {
+                i++;
+                column++;
+            }
+        } else if ((chr >= 'A' && chr <= 'Z') || (chr >= 'a' && chr <= 'z') || (chr >= '0' && chr <= '9') || chr == '_' ||
+                   chr == '-') {
+            uint64_t start = i;
+            while (i < source.Length &&
+                   ((source.Data[i] >= 'A' && source.Data[i] <= 'Z') || (source.Data[i] >= 'a' && source.Data[i] <= 'z') ||
+                    (source.Data[i] >= '0' && source.Data[i] <= '9') || source.Data[i] == '_' || source.Data[i] == '-')) {
+                i++;
+            }
+            if (!current.IsMacro && String_Equal((String){ .Data = &source.Data[start], .Length = i - start },
+                                                 String_FromLiteral("macro"))) {
+                SPLIT_AT(start, true);
+            }
+            column += i - start;
+        } else if (chr == ':' && !current.IsMacro) {
+            SPLIT_AT(i, false);
+            i++;
+            column++;
+        } else if (chr == ')' && current.IsMacro) {
+            i++;
+            column++;
+            SPLIT_AT(i, false);
+        } else {
+            i++;
+            column++;
+            if (chr == '\n') {
+                line++;
+                column = 1;
+            }
+        }
+    }
+
+    SPLIT_AT(source.Length, false);
+
+#undef SPLIT_AT
+
+    return spans;
+}
+
+static void AssemblerSection_Destroy(AssemblerSection* section) {
+    Emitter_Destroy(&section->Emitter);
+    MacroDependencyArray_Destroy(&section->Dependencies);
+}
+
+// Finds the definition an expansion of the macro would use, the first one that was defined
+static const MacroDependency* FindMacroDefinition(MacroDependencyArray definitions, uint64_t nameHash) {
+    for (uint64_t i = 0; i < definitions.Length; i++) {
+        if (definitions.Data[i].NameHash == nameHash) {
+            return &definitions.Data[i];
+        }
+    }
+    return NULL;
+}
+
+static bool AssemblerSection_IsUpToDate(AssemblerSection* section, MacroDependencyArray definitions) {
+    for (uint64_t i = 0; i < section->Dependencies.Length; i++) {
+        const MacroDependency* definition = FindMacroDefinition(definitions, section->Dependencies.Data[i].NameHash);
+        if (!definition || definition->Hash != section->Dependencies.Data[i].Hash) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Assembler_Create(Assembler* assembler, String filepath) {
+    *assembler                 = (Assembler){};
+    assembler->FilePath.Data   = malloc(filepath.Length);
+    assembler->FilePath.Length = filepath.Length;
+    if (!assembler->FilePath.Data) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to allocate file path\n");
+        return false;
+    }
+    memcpy(assembler->FilePath.Data, filepath.Data, filepath.Length);
+    assembler->Sections = AssemblerSectionArray_Create();
+    assembler->Code     = ByteArray_Create();
+    return true;
+}
+
+void Assembler_Destroy(Assembler* assembler) {
+    for (uint64_t i = 0; i < assembler->Sections.Length; i++) {
+        AssemblerSection_Destroy(&assembler->Sections.Data[i]);
+    }
+    AssemblerSectionArray_Destroy(&assembler->Sections);
+    ByteArray_Destroy(&assembler->Code);
+    free(assembler->FilePath.Data);
+    *assembler = (Assembler){};
+}
+
+// Appends the code to the linked code, the labels and references are only moved
+// The uses that still need a label by name are collected in UnknownLabels and resolved once everything is linked
+static void LinkCode(Emitter* linked, Emitter* emitter, bool isModule) {
+    uint64_t base = linked->Code.Length;
+    Emitter_EmitBytes(linked, emitter->Code.Data, emitter->Code.Length);
+    for (uint64_t j = 0; j < emitter->Labels.Length; j++) {
+        LabelArray_Push(&linked->Labels,
+                        (Label){
+                            .Token    = emitter->Labels.Data[j].Token,
+                            .Location = emitter->Labels.Data[j].Location + base,
+                        });
+    }
+    for (uint64_t j = 0; j < emitter->References.Length; j++) {
+        LabelReference reference = (LabelReference){
+            .Token           = emitter->References.Data[j].Token,
+            .IndexForAddress = emitter->References.Data[j].IndexForAddress + base,
+        };
+        LabelReferenceArray_Push(&linked->References, reference);
+        if (isModule) {
+            // The module resolved these itself, looking them up by name again could find a label of the file
+            *(uint64_t*)&linked->Code.Data[reference.IndexForAddress] += base;
+        } else {
+            // References inside a section were only resolved relative to the section, labels of other sections are unknown
+            UnknownLabelArray_Push(&linked->UnknownLabels,
+                                   (UnknownLabel){
+                                       .Token           = reference.Token,
+                                       .IndexForAddress = reference.IndexForAddress,
+                                   });
+        }
+    }
+    if (isModule) {
+        // Only the labels the module left unknown come from outside of it
+        for (uint64_t j = 0; j < emitter->UnknownLabels.Length; j++) {
+            UnknownLabelArray_Push(&linked->UnknownLabels,
+                                   (UnknownLabel){
+                                       .Token           = emitter->UnknownLabels.Data[j].Token,
+                                       .IndexForAddress = emitter->UnknownLabels.Data[j].IndexForAddress + base,
+                                   });
+        }
+    }
+}
+
+static bool Assembler_Link(Assembler* assembler) {
+    Emitter linked       = (Emitter){};
+    linked.Code          = ByteArray_Create();
+    linked.Labels        = LabelArray_Create();
+    linked.References    = LabelReferenceArray_Create();
+    linked.UnknownLabels = UnknownLabelArray_Create();
+
+    // Modules imported by several sections are only linked once, after the code of the file
+    ModulePointerArray modules = ModulePointerArray_Create();
+    for (uint64_t i = 0; i < assembler->Sections.Length; i++) {
+        ModulePointerArray imports = assembler->Sections.Data[i].Emitter.Imports;
+        for (uint64_t j = 0; j < imports.Length; j++) {
+            bool isLinked = false;
+            for (uint64_t k = 0; k < modules.Length; k++) {
+                if (modules.Data[k] == imports.Data[j]) {
+                    isLinked = true;
+                    break;
+                }
+            }
+            if (!isLinked) {
+                ModulePointerArray_Push(&modules, imports.Data[j]);
+            }
+        }
+    }
+
+    uint64_t codeSize       = 0;
+    uint64_t labelCount     = 0;
+    uint64_t referenceCount = 0;
+    for (uint64_t i = 0; i < assembler->Sections.Length; i++) {
+        codeSize += assembler->Sections.Data[i].Emitter.Code.Length;
+        labelCount += assembler->Sections.Data[i].Emitter.Labels.Length;
+        referenceCount += assembler->Sections.Data[i].Emitter.References.Length;
+    }
+    for (uint64_t i = 0; i < modules.Length; i++) {
+        codeSize += modules.Data[i]->Emitter.Code.Length;
+        labelCount += modules.Data[i]->Emitter.Labels.Length;
+        referenceCount += modules.Data[i]->Emitter.References.Length;
+    }
+    ByteArray_Reserve(&linked.Code, codeSize);
+    LabelArray_Reserve(&linked.Labels, labelCount);
+    LabelReferenceArray_Reserve(&linked.References, referenceCount);
+    UnknownLabelArray_Reserve(&linked.UnknownLabels, referenceCount);
+
+    for (uint64_t i = 0; i < assembler->Sections.Length; i++) {
+        LinkCode(&linked, &assembler->Sections.Data[i].Emitter, false);
+    }
+    for (uint64_t i = 0; i < modules.Length; i++) {
+        LinkCode(&linked, &modules.Data[i]->Emitter, true);
+    }
+    ModulePointerArray_Destroy(&modules);
+
+    IndexTable labels;
+    IndexTable_Create(&labels, linked.Labels.Length);
+    for (uint64_t i = 0; i < linked.Labels.Length; i++) {
+        String name = Token_GetString(linked.Labels.Data[i].Token);
+        IndexTable_Insert(&labels, String_Hash(name), i);
+    }
+
+    // The labels of the file come first, so its own uses find them before a label of the same name in a module
+    for (uint64_t i = 0; i < linked.UnknownLabels.Length; i++) {
+        UnknownLabel reference = linked.UnknownLabels.Data[i];
+        String name            = Token_GetString(reference.Token);
+        uint64_t hash            = String_Hash(name);
+        bool found               = false;
+        for (uint64_t slot = hash & labels.Mask; labels.Indices[slot] != 0; slot = (slot + 1) & labels.Mask) {
+            Label* label = &linked.Labels.Data[labels.Indices[slot] - 1];
+            if (labels.Hashes[slot] == hash && String_Equal(Token_GetString(label->Token), name)) {
+                *(uint64_t*)&linked.Code.Data[reference.IndexForAddress] = label->Location;
+                found                                                    = true;
+                break;
+            }
+        }
+        if (!found) {
+            SourceLocation location = Token_GetLocation(reference.Token);
+            linked.WasError         = true;
+            fflush(stdout);
+            fprintf(stderr,
+                    "%.*s:%llu:%llu: Unknown label '%.*s'\n",
+                    String_Fmt(location.FilePath),
+                    location.Line,
+                    location.Column,
+                    String_Fmt(name));
+        }
+    }
+
+    IndexTable_Destroy(&labels);
+
+    if (!linked.WasError) {
+        Optimizer_Optimize(&linked);
+    }
+
+    // The linked emitter has no lexer, so its arrays come from malloc and are freed here
+    LabelArray_Destroy(&linked.Labels);
+    LabelReferenceArray_Destroy(&linked.References);
+    UnknownLabelArray_Destroy(&linked.UnknownLabels);
+
+    if (linked.WasError) {
+        ByteArray_Destroy(&linked.Code);
+        return false;
+    }
+
+    ByteArray_Destroy(&assembler->Code);
+    assembler->Code = linked.Code;
+    return true;
+}
+
+bool Assembler_Update(Assembler* assembler) {
+    Lexer file;
+    if (!Lexer_Create(&file, assembler->FilePath)) {
+        return false;
+    }
+
+    SourceSpanArray spans = SplitSource(file.Source);
+
+    AssemblerSectionArray old = assembler->Sections;
+    IndexTable cache;
+    IndexTable_Create(&cache, old.Length);
+    for (uint64_t i = 0; i < old.Length; i++) {
+        old.Data[i].Reused = false;
+        IndexTable_Insert(&cache, old.Data[i].Hash, i);
+    }
+
+    AssemblerSectionArray sections = AssemblerSectionArray_Create();
+    // Every macro defined so far in the order they were defined, with the hash of the section that defines it
+    MacroArray macros                = MacroArray_Create();
+    MacroDependencyArray definitions = MacroDependencyArray_Create();
+    bool wasError                    = false;
+
+    assembler->EmittedSectionCount = 0;
+    assembler->ReusedSectionCount  = 0;
+
+    for (uint64_t i = 0; i < spans.Length; i++) {
+        SourceSpan span = spans.Data[i];
+        String text     = (String){
+            .Data   = &file.Source.Data[span.Start],
+            .Length = span.End - span.Start,
+        };
+        uint64_t hash = String_Hash(text);
+
+        AssemblerSection* section = NULL;
+        for (uint64_t slot = hash & cache.Mask; cache.Indices[slot] != 0; slot = (slot + 1) & cache.Mask) {
+            AssemblerSection* cached = &old.Data[cache.Indices[slot] - 1];
+            // Sections with imports are emitted again, the module cache notices when the imported files change
+            if (cache.Hashes[slot] == hash && !cached->Reused && cached->IsMacro == span.IsMacro &&
+                cached->Emitter.Imports.Length == 0 && String_Equal(cached->Emitter.Lexer.Source, text) &&
+                AssemblerSection_IsUpToDate(cached, definitions)) {
+                cached->Reused = true;
+                section        = AssemblerSectionArray_Push(&sections, *cached);
+                assembler->ReusedSectionCount++;
+                break;
+            }
+        }
+
+        if (!section) {
+            Lexer lexer;
+            // Keeps the locations in error messages relative to the whole file
+            if (!Lexer_CreateFromSource(&lexer, assembler->FilePath, text, span.Line, span.Column)) {
+                wasError = true;
+                break;
+            }
+
+            AssemblerSection emitted = (AssemblerSection){
+                .Hash         = hash,
+                .IsMacro      = span.IsMacro,
+                .Dependencies = MacroDependencyArray_Create(),
+            };
+            if (!Emitter_Create(&emitted.Emitter, lexer)) {
+                wasError = true;
+                break;
+            }
+            emitted.Emitter.ExternalMacros     = &macros;
+            emitted.Emitter.DeferUnknownLabels = true;
+            Emitter_Emit(&emitted.Emitter);
+            emitted.Emitter.ExternalMacros = NULL;
+
+            if (emitted.Emitter.WasError) {
+                AssemblerSection_Destroy(&emitted);
+                wasError = true;
+                continue;
+            }
+
+            for (uint64_t j = 0; j < emitted.Emitter.ExpandedExternalMacros.Length; j++) {
+                String name                       = Token_GetString(emitted.Emitter.ExpandedExternalMacros.Data[j]);
+                uint64_t nameHash                 = String_Hash(name);
+                const MacroDependency* definition = FindMacroDefinition(definitions, nameHash);
+                MacroDependencyArray_Push(&emitted.Dependencies, *definition);
+            }
+
+            section = AssemblerSectionArray_Push(&sections, emitted);
+            assembler->EmittedSectionCount++;
+        }
+
+        // Imported macros change with the module, so the text of the modules is part of the definition
+        uint64_t definitionHash = section->Hash;
+        for (uint64_t j = 0; j < section->Emitter.Imports.Length; j++) {
+            definitionHash = (definitionHash ^ section->Emitter.Imports.Data[j]->Hash) * 1099511628211ULL;
+        }
+        for (uint64_t j = 0; j < section->Emitter.Macros.Length; j++) {
+            Macro macro = section->Emitter.Macros.Data[j];
+            String name = Token_GetString(macro.Name);
+            MacroArray_Push(&macros, macro);
+            MacroDependencyArray_Push(&definitions,
+                                      (MacroDependency){
+                                          .NameHash = String_Hash(name),
+                                          .Hash     = definitionHash,
+                                      });
+        }
+    }
+
+    for (uint64_t i = 0; i < old.Length; i++) {
+        if (!old.Data[i].Reused) {
+            AssemblerSection_Destroy(&old.Data[i]);
+        }
+    }
+    AssemblerSectionArray_Destroy(&old);
+    assembler->Sections = sections;
+
+    // The macros are owned by the sections that define them
+    MacroArray_Destroy(&macros);
+    MacroDependencyArray_Destroy(&definitions);
+    IndexTable_Destroy(&cache);
+    SourceSpanArray_Destroy(&spans);
+    Lexer_Destroy(&file);
+
+    if (wasError) {
+        return false;
+    }
+    return Assembler_Link(assembler);
+}
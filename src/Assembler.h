@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Emitter.h"
+
+typedef struct MacroDependency {
+    uint64_t NameHash;
+    uint64_t Hash;
+} MacroDependency;
+
+ARRAY_DECL(MacroDependency, MacroDependency);
+
+// A piece of the file that starts at a label or is a single macro definition
+typedef struct AssemblerSection {
+    // Hash of the source text of the section
+    uint64_t Hash;
+    bool IsMacro;
+    // Owns the source text and holds the code, labels and label references relative to the start of the section
+    Emitter Emitter;
+    // The external macros the code expanded and the hash of their definition when it was emitted
+    MacroDependencyArray Dependencies;
+    bool Reused;
+} AssemblerSection;
+
+ARRAY_DECL(AssemblerSection, AssemblerSection);
+
+// Keeps the emitted code of every section of a file between updates
+// An update only lexes and emits the sections whose text or macros changed, then links all of them again
+typedef struct Assembler {
+    String FilePath;
+    AssemblerSectionArray Sections;
+    // The linked and optimized code from the last successful update
+    ByteArray Code;
+    // How many sections the last update emitted and how many it took from the cache
+    uint64_t EmittedSectionCount;
+    uint64_t ReusedSectionCount;
+} Assembler;
+
+bool Assembler_Create(Assembler* assembler, String filepath);
+void Assembler_Destroy(Assembler* assembler);
+// Reads the file again, on errors the code from the last successful update is kept
+bool Assembler_Update(Assembler* assembler);
@@ -0,0 +1,138 @@
+#include "Binary.h"
+#include "VM.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+
+#if defined(_WIN32)
+    #include <Windows.h>
+#else
+    #error Unsupported platform
+#endif
+
+bool Binary_Write(const char* path, const uint8_t* code, uint64_t codeSize, bool isStackBounded, uint64_t stackSize) {
+    uint8_t* copy = malloc(codeSize);
+    if (!copy && codeSize != 0) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to allocate a copy of the code\n");
+        return false;
+    }
+    memcpy(copy, code, codeSize);
+
+    // Bound externs hold pointers into this process
+    for (uint64_t offset = 0; offset < codeSize;) {
+        uint64_t length = VM_GetInstructionLength(&copy[offset]);
+        if (length == 0 || length > codeSize - offset) {
+            fflush(stdout);
+            fprintf(stderr, "Invalid instruction at %llu\n", offset);
+            free(copy);
+            return false;
+        }
+        if (copy[offset] == Op_Extern) {
+            memset(&copy[offset + 1], 0, sizeof(uint64_t));
+        }
+        offset += length;
+    }
+
+    BinaryHeader header = (BinaryHeader){
+        .Magic          = BINARY_MAGIC,
+        .Version        = BINARY_VERSION,
+        .CodeSize       = codeSize,
+        .IsStackBounded = isStackBounded,
+        .StackSize      = stackSize,
+    };
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to open file '%s'\n", path);
+        free(copy);
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(copy, 1, codeSize, file) == codeSize;
+    written      = fclose(file) == 0 && written;
+    free(copy);
+    if (!written) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to write file '%s'\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool Binary_Map(Binary* binary, const char* path) {
+    *binary = (Binary){};
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to open file '%s'\n", path);
+        return false;
+    }
+    binary->File = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || (uint64_t)fileSize.QuadPart < sizeof(BinaryHeader)) {
+        fflush(stdout);
+        fprintf(stderr, "The file '%s' is not a binary\n", path);
+        Binary_Unmap(binary);
+        return false;
+    }
+
+    binary->Mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (!binary->Mapping) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to map file '%s'\n", path);
+        Binary_Unmap(binary);
+        return false;
+    }
+
+    binary->View = MapViewOfFile(binary->Mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (!binary->View) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to map file '%s'\n", path);
+        Binary_Unmap(binary);
+        return false;
+    }
+#else
+    #error Unsupported platform
+#endif
+
+    memcpy(&binary->Header, binary->View, sizeof(BinaryHeader));
+    if (memcmp(binary->Header.Magic, BINARY_MAGIC, sizeof(binary->Header.Magic)) != 0 ||
+        binary->Header.CodeSize != (uint64_t)fileSize.QuadPart - sizeof(BinaryHeader)) {
+        fflush(stdout);
+        fprintf(stderr, "The file '%s' is not a binary\n", path);
+        Binary_Unmap(binary);
+        return false;
+    }
+    if (binary->Header.Version != BINARY_VERSION) {
+        fflush(stdout);
+        fprintf(stderr, "The binary '%s' has version %u, expected version %u\n", path, binary->Header.Version, BINARY_VERSION);
+        Binary_Unmap(binary);
+        return false;
+    }
+
+    binary->Code = (uint8_t*)binary->View + sizeof(BinaryHeader);
+    return true;
+}
+
+void Binary_Unmap(Binary* binary) {
+#if defined(_WIN32)
+    if (binary->View) {
+        UnmapViewOfFile(binary->View);
+    }
+    if (binary->Mapping) {
+        CloseHandle(binary->Mapping);
+    }
+    if (binary->File) {
+        CloseHandle(binary->File);
+    }
+#else
+    #error Unsupported platform
+#endif
+    *binary = (Binary){};
+}
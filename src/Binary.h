@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BINARY_MAGIC   "VMB"
+#define BINARY_VERSION 1
+
+// A binary file is this header followed by the code
+typedef struct BinaryHeader {
+    char Magic[4];
+    uint32_t Version;
+    uint64_t CodeSize;
+    // From the stack analysis of the code when it was written
+    uint64_t IsStackBounded;
+    uint64_t StackSize;
+} BinaryHeader;
+
+// Assembled and optimized code loaded from a binary file, so it runs without assembling it again
+// The code is a copy-on-write view of the file, data in the code is never copied and binding externs only copies their pages
+typedef struct Binary {
+    BinaryHeader Header;
+    uint8_t* Code;
+    void* File;
+    void* Mapping;
+    void* View;
+} Binary;
+
+// The functions of externs are not written, so the file can be bound again by any host
+bool Binary_Write(const char* path, const uint8_t* code, uint64_t codeSize, bool isStackBounded, uint64_t stackSize);
+bool Binary_Map(Binary* binary, const char* path);
+void Binary_Unmap(Binary* binary);
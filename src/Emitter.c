@@ -1,99 +1,205 @@
 #include "Emitter.h"
+#include "Module.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <memory.h>
+#include <stdarg.h>
 
 ARRAY_IMPL(Token, Token);
-ARRAY_IMPL(uint8_t, Byte);
 ARRAY_IMPL(Label, Label);
 ARRAY_IMPL(UnknownLabel, UnknownLabel);
+ARRAY_IMPL(LabelReference, LabelReference);
 ARRAY_IMPL(Macro, Macro);
+ARRAY_IMPL(Module*, ModulePointer);
+
+static void Emitter_Error(Emitter* emitter, Token token, const char* format, ...) {
+    emitter->WasError = true;
+    if (emitter->SuppressErrors) {
+        return;
+    }
+
+    SourceLocation location = Token_GetLocation(token);
+    fflush(stdout);
+    fprintf(stderr, "%.*s:%llu:%llu: ", String_Fmt(location.FilePath), location.Line, location.Column);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+// Emits a float literal of 4 or 8 bytes
+static void Emitter_EmitFloat(Emitter* emitter, Token token, uint64_t size) {
+    double value;
+    if (!Token_GetFloat(token, &value)) {
+        Emitter_Error(emitter, token, "Invalid float literal '%.*s'\n", String_Fmt(Token_GetString(token)));
+    } else if (size == sizeof(float)) {
+        float single = (float)value;
+        Emitter_EmitBytes(emitter, (uint8_t*)&single, size);
+    } else if (size == sizeof(double)) {
+        Emitter_EmitBytes(emitter, (uint8_t*)&value, size);
+    } else {
+        Emitter_Error(emitter, token, "Float literals must be 4 or 8 bytes\n");
+    }
+}
+
+static void Emitter_AssembleMacro(Emitter* emitter, Macro* macro) {
+    // Bodies that define labels or macros only make sense where they are expanded
+    // Nested expansions are left alone when the caller tracks which external macros were used
+    for (uint64_t i = 0; i < macro->Tokens.Kinds.Length; i++) {
+        TokenKind kind = macro->Tokens.Kinds.Data[i];
+        if (kind == TokenKind_Colon || kind == TokenKind_Macro || kind == TokenKind_Import || kind == TokenKind_Extern || kind == TokenKind_Data ||
+            (kind == TokenKind_Bang && emitter->ExternalMacros)) {
+            return;
+        }
+    }
+
+    // Only the macros defined before this one, so a body that expands itself is left to fail where it is used
+    MacroArray previous = emitter->Macros;
+    previous.Length--;
+
+    Allocator* allocator = &emitter->Lexer.Arena->Allocator;
+
+    Emitter fragment            = {};
+    fragment.Lexer              = emitter->Lexer;
+    fragment.Code               = ByteArray_CreateWithAllocator(allocator);
+    fragment.NextTokens         = TokenArray_CreateWithAllocator(allocator);
+    fragment.IsPreLexed         = true;
+    fragment.PreLexedTokens     = TokenBuffer_Create(allocator);
+    fragment.Labels             = LabelArray_CreateWithAllocator(allocator);
+    fragment.UnknownLabels      = UnknownLabelArray_CreateWithAllocator(allocator);
+    fragment.References         = LabelReferenceArray_CreateWithAllocator(allocator);
+    fragment.Macros             = MacroArray_CreateWithAllocator(allocator);
+    fragment.ExternalMacros     = &previous;
+    fragment.DeferUnknownLabels = true;
+    fragment.SuppressErrors     = true;
+
+    fragment.ExpandedExternalMacros = TokenArray_CreateWithAllocator(allocator);
+    fragment.Imports                = ModulePointerArray_CreateWithAllocator(allocator);
+
+    // The body is followed by an end of file so the fragment never reads past it
+    Token* tokens = TokenArray_Emplace(&fragment.NextTokens, macro->Tokens.Kinds.Length + 1);
+    for (uint64_t i = 0; i < macro->Tokens.Kinds.Length; i++) {
+        tokens[i] = TokenBuffer_Get(&macro->Tokens, i);
+    }
+    tokens[macro->Tokens.Kinds.Length] = (Token){
+        .Kind   = TokenKind_EndOfFile,
+        .File   = macro->Name.File,
+        .Offset = macro->Name.Offset,
+        .Length = 0,
+    };
+    Emitter_NextToken(&fragment);
+    Emitter_Emit(&fragment);
+
+    // A body that does not assemble on its own may still be valid together with the tokens around the expansion
+    if (fragment.WasError) {
+        return;
+    }
+
+    macro->IsAssembled = true;
+    macro->Code        = fragment.Code;
+    macro->References  = fragment.References;
+}
 
 bool Emitter_Create(Emitter* emitter, Lexer lexer) {
+    Allocator* allocator   = &lexer.Arena->Allocator;
     *emitter               = (Emitter){};
     emitter->Lexer         = lexer;
-    emitter->Code          = ByteArray_Create();
+    emitter->Code          = ByteArray_CreateWithAllocator(allocator);
     emitter->Current       = Lexer_NextToken(&emitter->Lexer);
-    emitter->NextTokens    = TokenArray_Create();
-    emitter->Labels        = LabelArray_Create();
-    emitter->UnknownLabels = UnknownLabelArray_Create();
-    emitter->Macros        = MacroArray_Create();
+    emitter->NextTokens    = TokenArray_CreateWithAllocator(allocator);
+    emitter->Labels        = LabelArray_CreateWithAllocator(allocator);
+    emitter->UnknownLabels = UnknownLabelArray_CreateWithAllocator(allocator);
+    emitter->References    = LabelReferenceArray_CreateWithAllocator(allocator);
+    emitter->Macros        = MacroArray_CreateWithAllocator(allocator);
+
+    emitter->ExpandedExternalMacros = TokenArray_CreateWithAllocator(allocator);
+    emitter->Imports                = ModulePointerArray_CreateWithAllocator(allocator);
     return true;
 }
 
-void Emitter_Destroy(Emitter* emitter) {
-    ByteArray_Destroy(&emitter->Code);
-    LabelArray_Destroy(&emitter->Labels);
-    TokenArray_Destroy(&emitter->NextTokens);
-    UnknownLabelArray_Destroy(&emitter->UnknownLabels);
-    for (uint64_t i = 0; i < emitter->Macros.Length; i++) {
-        TokenArray_Destroy(&emitter->Macros.Data[i].Tokens);
+bool Emitter_CreatePreLexed(Emitter* emitter, Lexer lexer, uint64_t threadCount) {
+    TokenBuffer tokens = TokenBuffer_Create(&lexer.Arena->Allocator);
+    Lexer_LexAll(&lexer, &tokens, threadCount);
+
+    if (!Emitter_Create(emitter, lexer)) {
+        return false;
     }
-    MacroArray_Destroy(&emitter->Macros);
+
+    emitter->IsPreLexed     = true;
+    emitter->PreLexedTokens = tokens;
+    emitter->PreLexedIndex  = 0;
+    emitter->Current        = TokenBuffer_Get(&emitter->PreLexedTokens, emitter->PreLexedIndex++);
+    return true;
+}
+
+void Emitter_Destroy(Emitter* emitter) {
+    // Everything the emitter allocated lives in the arena of the lexer
     Lexer_Destroy(&emitter->Lexer);
+    *emitter = (Emitter){};
 }
 
 void Emitter_Emit(Emitter* emitter) {
     while (true) {
         switch (emitter->Current.Kind) {
             case TokenKind_EndOfFile: {
+                // The labels are resolved by whoever links the code
+                if (emitter->DeferUnknownLabels) {
+                    return;
+                }
+                for (uint64_t i = 0; i < emitter->Imports.Length; i++) {
+                    Emitter_AppendModule(emitter, emitter->Imports.Data[i]);
+                }
                 while (emitter->UnknownLabels.Length > 0) {
                     UnknownLabel unknown = UnknownLabelArray_Pop(&emitter->UnknownLabels);
-                    emitter->WasError    = true;
-                    fflush(stdout);
-                    fprintf(stderr,
-                            "%.*s:%llu:%llu: Unknown label '%.*s'\n",
-                            String_Fmt(unknown.Token.FilePath),
-                            unknown.Token.Line,
-                            unknown.Token.Column,
-                            String_Fmt(unknown.Token.StringValue));
+                    Emitter_Error(emitter, unknown.Token, "Unknown label '%.*s'\n", String_Fmt(Token_GetString(unknown.Token)));
                 }
                 return;
             } break;
 
             case TokenKind_Colon: {
                 Emitter_NextToken(emitter);
-                Token name        = Emitter_ExpectToken(emitter, TokenKind_Name);
-                uint64_t location = emitter->Code.Length;
-                // TODO: Duplicate labels
-                LabelArray_Push(&emitter->Labels,
-                                (Label){
-                                    .Token    = name,
-                                    .Location = location,
-                                });
-                for (int64_t i = (int64_t)emitter->UnknownLabels.Length - 1; i >= 0; i--) {
-                    if (String_Equal(emitter->UnknownLabels.Data[i].Token.StringValue, name.StringValue)) {
-                        UnknownLabel unknown = UnknownLabelArray_Remove(&emitter->UnknownLabels, i);
-                        *(uint64_t*)&emitter->Code.Data[unknown.IndexForAddress] = location;
-                    }
-                }
+                Token name = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_DefineLabel(emitter, name, emitter->Code.Length);
             } break;
 
             case TokenKind_Bang: {
                 Emitter_NextToken(emitter);
-                Token name = Emitter_ExpectToken(emitter, TokenKind_Name);
-                bool found = false;
+                Token name        = Emitter_ExpectToken(emitter, TokenKind_Name);
+                String nameString = Token_GetString(name);
+                Macro* macro      = NULL;
                 for (uint64_t i = 0; i < emitter->Macros.Length; i++) {
-                    if (String_Equal(emitter->Macros.Data[i].Name.StringValue, name.StringValue)) {
-                        for (uint64_t j = 0; j < emitter->Macros.Data[i].Tokens.Length; j++) {
-                            TokenArray_Push(&emitter->NextTokens, emitter->Macros.Data[i].Tokens.Data[j]);
-                        }
-                        TokenArray_Push(&emitter->NextTokens, emitter->Current);
-                        emitter->Current = TokenArray_Remove(&emitter->NextTokens, 0);
-                        found            = true;
+                    if (String_Equal(Token_GetString(emitter->Macros.Data[i].Name), nameString)) {
+                        macro = &emitter->Macros.Data[i];
                         break;
                     }
                 }
-                if (!found) {
-                    fflush(stdout);
-                    fprintf(stderr,
-                            "%.*s:%llu:%llu: Unknown macro name '%.*s'\n",
-                            String_Fmt(name.FilePath),
-                            name.Line,
-                            name.Column,
-                            String_Fmt(name.StringValue));
-                    emitter->WasError = true;
+                if (!macro && emitter->ExternalMacros) {
+                    for (uint64_t i = 0; i < emitter->ExternalMacros->Length; i++) {
+                        if (String_Equal(Token_GetString(emitter->ExternalMacros->Data[i].Name), nameString)) {
+                            macro = &emitter->ExternalMacros->Data[i];
+                            TokenArray_Push(&emitter->ExpandedExternalMacros, macro->Name);
+                            break;
+                        }
+                    }
+                }
+                if (macro && macro->IsAssembled) {
+                    // The labels are resolved here, so the body behaves as if its tokens were written in place
+                    uint64_t base = emitter->Code.Length;
+                    ByteArray_Append(&emitter->Code, macro->Code.Data, macro->Code.Length);
+                    for (uint64_t i = 0; i < macro->References.Length; i++) {
+                        LabelReference reference = macro->References.Data[i];
+                        Emitter_ReferenceLabel(emitter, reference.Token, base + reference.IndexForAddress);
+                    }
+                } else if (macro) {
+                    Token* tokens = TokenArray_Emplace(&emitter->NextTokens, macro->Tokens.Kinds.Length);
+                    for (uint64_t i = 0; i < macro->Tokens.Kinds.Length; i++) {
+                        tokens[i] = TokenBuffer_Get(&macro->Tokens, i);
+                    }
+                    TokenArray_Push(&emitter->NextTokens, emitter->Current);
+                    emitter->Current = TokenArray_Remove(&emitter->NextTokens, 0);
+                } else {
+                    Emitter_Error(emitter, name, "Unknown macro name '%.*s'\n", String_Fmt(nameString));
                 }
             } break;
 
@@ -104,12 +210,122 @@ void Emitter_Emit(Emitter* emitter) {
                 Macro* macro = MacroArray_Push(&emitter->Macros,
                                                (Macro){
                                                    .Name   = name,
-                                                   .Tokens = TokenArray_Create(),
+                                                   .Tokens = TokenBuffer_Create(&emitter->Lexer.Arena->Allocator),
                                                });
                 while (emitter->Current.Kind != TokenKind_CloseParenthesis && emitter->Current.Kind != TokenKind_EndOfFile) {
-                    TokenArray_Push(&macro->Tokens, Emitter_NextToken(emitter));
+                    TokenBuffer_Push(&macro->Tokens, Emitter_NextToken(emitter));
                 }
                 Emitter_ExpectToken(emitter, TokenKind_CloseParenthesis);
+                Emitter_AssembleMacro(emitter, macro);
+            } break;
+
+            case TokenKind_Import: {
+                Emitter_NextToken(emitter);
+                Token path = Emitter_ExpectToken(emitter, TokenKind_String);
+                if (path.Length == 0) {
+                    break;
+                }
+
+                // The path is relative to the importing file and has no escapes, so only the quotes are removed
+                String pathString = Token_GetString(path);
+                pathString.Data++;
+                pathString.Length -= 2;
+                Module* module = Module_Import(emitter->Lexer.FilePath, pathString);
+                if (!module) {
+                    Emitter_Error(emitter, path, "Failed to import '%.*s'\n", String_Fmt(pathString));
+                    break;
+                }
+
+                // The modules the module imports come first, so every module is only appended once
+                for (uint64_t i = 0; i <= module->Emitter.Imports.Length; i++) {
+                    Module* imported = i < module->Emitter.Imports.Length ? module->Emitter.Imports.Data[i] : module;
+                    bool isImported  = false;
+                    for (uint64_t j = 0; j < emitter->Imports.Length; j++) {
+                        if (emitter->Imports.Data[j] == imported) {
+                            isImported = true;
+                            break;
+                        }
+                    }
+                    if (!isImported) {
+                        ModulePointerArray_Push(&emitter->Imports, imported);
+                    }
+                }
+                MacroArray_Append(&emitter->Macros, module->Emitter.Macros.Data, module->Emitter.Macros.Length);
+            } break;
+
+            case TokenKind_Extern: {
+                Emitter_NextToken(emitter);
+                Token name = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_ExpectToken(emitter, TokenKind_OpenParenthesis);
+                uint64_t argSizes[VM_MAX_EXTERN_ARGS];
+                uint64_t argCount = 0;
+                while (emitter->Current.Kind == TokenKind_Integer) {
+                    Token size     = Emitter_NextToken(emitter);
+                    uint64_t value = Token_GetInt(size);
+                    if (value == 0 || value > sizeof(uint64_t)) {
+                        Emitter_Error(emitter, size, "Extern arguments must be between 1 and 8 bytes\n");
+                    } else if (argCount == VM_MAX_EXTERN_ARGS) {
+                        Emitter_Error(emitter, size, "Externs can take at most %d arguments\n", VM_MAX_EXTERN_ARGS);
+                    } else {
+                        argSizes[argCount++] = value;
+                    }
+                }
+                Emitter_ExpectToken(emitter, TokenKind_CloseParenthesis);
+                Token retSize = Emitter_ExpectToken(emitter, TokenKind_Integer);
+                if (Token_GetInt(retSize) > sizeof(uint64_t)) {
+                    Emitter_Error(emitter, retSize, "Externs can return at most 8 bytes\n");
+                }
+                if (name.Length == 0) {
+                    break;
+                }
+
+                // The name is defined like a label, so call sites are linked and moved around like any other label use
+                String nameString = Token_GetString(name);
+                Emitter_DefineLabel(emitter, name, emitter->Code.Length);
+                Emitter_EmitOp(emitter, Op_Extern);
+                Emitter_Emit64(emitter, 0);
+                Emitter_Emit64(emitter, argCount);
+                for (uint64_t i = 0; i < argCount; i++) {
+                    Emitter_Emit64(emitter, argSizes[i]);
+                }
+                Emitter_Emit64(emitter, Token_GetInt(retSize));
+                Emitter_Emit64(emitter, nameString.Length);
+                Emitter_EmitBytes(emitter, nameString.Data, nameString.Length);
+                Emitter_EmitBytes(emitter, &(uint8_t){0}, 1);
+            } break;
+
+            case TokenKind_Data: {
+                Emitter_NextToken(emitter);
+                Token name = Emitter_ExpectToken(emitter, TokenKind_Name);
+                // The name is defined like a label, push-data then finds the bytes wherever the code ends up
+                Emitter_DefineLabel(emitter, name, emitter->Code.Length);
+                Emitter_EmitOp(emitter, Op_Data);
+                uint64_t sizeIndex = emitter->Code.Length;
+                Emitter_Emit64(emitter, 0);
+
+                if (emitter->Current.Kind == TokenKind_String) {
+                    // Strings have no escapes and no terminator, only the quotes are removed
+                    String text = Token_GetString(Emitter_ExpectToken(emitter, TokenKind_String));
+                    Emitter_EmitBytes(emitter, text.Data + 1, text.Length - 2);
+                } else {
+                    Token sizeToken = Emitter_ExpectToken(emitter, TokenKind_Integer);
+                    uint64_t size   = Token_GetInt(sizeToken);
+                    if (size != 1 && size != 2 && size != 4 && size != 8) {
+                        Emitter_Error(emitter, sizeToken, "Data elements must be 1, 2, 4 or 8 bytes\n");
+                    }
+                    Emitter_ExpectToken(emitter, TokenKind_OpenParenthesis);
+                    while (emitter->Current.Kind == TokenKind_Integer || emitter->Current.Kind == TokenKind_Float) {
+                        Token token = Emitter_NextToken(emitter);
+                        if (token.Kind == TokenKind_Integer) {
+                            uint64_t value = Token_GetInt(token);
+                            Emitter_EmitBytes(emitter, (uint8_t*)&value, size > sizeof(value) ? 0 : size);
+                        } else {
+                            Emitter_EmitFloat(emitter, token, size);
+                        }
+                    }
+                    Emitter_ExpectToken(emitter, TokenKind_CloseParenthesis);
+                }
+                *(uint64_t*)&emitter->Code.Data[sizeIndex] = emitter->Code.Length - sizeIndex - sizeof(uint64_t);
             } break;
 
             case TokenKind_Exit: {
@@ -120,99 +336,73 @@ void Emitter_Emit(Emitter* emitter) {
             case TokenKind_Push: {
                 Emitter_NextToken(emitter);
                 if (emitter->Current.Kind == TokenKind_Name) {
-                    Token name        = Emitter_ExpectToken(emitter, TokenKind_Name);
-                    bool found        = false;
-                    uint64_t location = 0;
-                    for (uint64_t i = 0; i < emitter->Labels.Length; i++) {
-                        if (String_Equal(emitter->Labels.Data[i].Token.StringValue, name.StringValue)) {
-                            found    = true;
-                            location = emitter->Labels.Data[i].Location;
-                            break;
-                        }
-                    }
+                    Token name = Emitter_ExpectToken(emitter, TokenKind_Name);
                     Emitter_EmitOp(emitter, Op_Push);
                     Emitter_Emit64(emitter, sizeof(uint64_t));
-                    if (!found) {
-                        UnknownLabelArray_Push(&emitter->UnknownLabels,
-                                               (UnknownLabel){
-                                                   .Token           = name,
-                                                   .IndexForAddress = emitter->Code.Length,
-                                               });
-                    }
-                    Emitter_Emit64(emitter, location);
+                    Emitter_EmitLabel(emitter, name);
                 } else {
-                    uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
-                    // TODO: Support strings or maybe lists of numbers?
-                    uint64_t value = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
-                    Emitter_EmitOp(emitter, Op_Push);
-                    Emitter_Emit64(emitter, size);
-                    Emitter_EmitBytes(emitter, (uint8_t*)&value, size);
+                    uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                    if (emitter->Current.Kind == TokenKind_Float) {
+                        Token token = Emitter_ExpectToken(emitter, TokenKind_Float);
+                        Emitter_EmitOp(emitter, Op_Push);
+                        Emitter_Emit64(emitter, size);
+                        Emitter_EmitFloat(emitter, token, size);
+                    } else {
+                        uint64_t value = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                        Emitter_EmitOp(emitter, Op_Push);
+                        Emitter_Emit64(emitter, size);
+                        Emitter_EmitBytes(emitter, (uint8_t*)&value, size);
+                    }
                 }
             } break;
 
             case TokenKind_AllocStack: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_AllocStack);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_Pop: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_Pop);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_Dup: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_Dup);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_Add: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_Add);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_Sub: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_Sub);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_Print: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_Print);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_Jump: {
                 Emitter_NextToken(emitter);
-                Token name        = Emitter_ExpectToken(emitter, TokenKind_Name);
-                bool found        = false;
-                uint64_t location = 0;
-                for (uint64_t i = 0; i < emitter->Labels.Length; i++) {
-                    if (String_Equal(emitter->Labels.Data[i].Token.StringValue, name.StringValue)) {
-                        found    = true;
-                        location = emitter->Labels.Data[i].Location;
-                        break;
-                    }
-                }
+                Token name = Emitter_ExpectToken(emitter, TokenKind_Name);
                 Emitter_EmitOp(emitter, Op_Jump);
-                if (!found) {
-                    UnknownLabelArray_Push(&emitter->UnknownLabels,
-                                           (UnknownLabel){
-                                               .Token           = name,
-                                               .IndexForAddress = emitter->Code.Length,
-                                           });
-                }
-                Emitter_Emit64(emitter, location);
+                Emitter_EmitLabel(emitter, name);
             } break;
 
             case TokenKind_JumpDyn: {
@@ -222,52 +412,41 @@ void Emitter_Emit(Emitter* emitter) {
 
             case TokenKind_JumpZero: {
                 Emitter_NextToken(emitter);
-                uint64_t size     = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
-                Token name        = Emitter_ExpectToken(emitter, TokenKind_Name);
-                bool found        = false;
-                uint64_t location = 0;
-                for (uint64_t i = 0; i < emitter->Labels.Length; i++) {
-                    if (String_Equal(emitter->Labels.Data[i].Token.StringValue, name.StringValue)) {
-                        found    = true;
-                        location = emitter->Labels.Data[i].Location;
-                        break;
-                    }
-                }
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Token name    = Emitter_ExpectToken(emitter, TokenKind_Name);
                 Emitter_EmitOp(emitter, Op_JumpZero);
                 Emitter_Emit64(emitter, size);
-                if (!found) {
-                    UnknownLabelArray_Push(&emitter->UnknownLabels,
-                                           (UnknownLabel){
-                                               .Token           = name,
-                                               .IndexForAddress = emitter->Code.Length,
-                                           });
-                }
-                Emitter_Emit64(emitter, location);
+                Emitter_EmitLabel(emitter, name);
             } break;
 
             case TokenKind_JumpNonZero: {
                 Emitter_NextToken(emitter);
-                uint64_t size     = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
-                Token name        = Emitter_ExpectToken(emitter, TokenKind_Name);
-                bool found        = false;
-                uint64_t location = 0;
-                for (uint64_t i = 0; i < emitter->Labels.Length; i++) {
-                    if (String_Equal(emitter->Labels.Data[i].Token.StringValue, name.StringValue)) {
-                        found    = true;
-                        location = emitter->Labels.Data[i].Location;
-                        break;
-                    }
-                }
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Token name    = Emitter_ExpectToken(emitter, TokenKind_Name);
                 Emitter_EmitOp(emitter, Op_JumpNonZero);
                 Emitter_Emit64(emitter, size);
-                if (!found) {
-                    UnknownLabelArray_Push(&emitter->UnknownLabels,
-                                           (UnknownLabel){
-                                               .Token           = name,
-                                               .IndexForAddress = emitter->Code.Length,
-                                           });
+                Emitter_EmitLabel(emitter, name);
+            } break;
+
+            case TokenKind_JumpTable: {
+                Emitter_NextToken(emitter);
+                Emitter_ExpectToken(emitter, TokenKind_OpenParenthesis);
+                Emitter_EmitOp(emitter, Op_JumpTable);
+                uint64_t countIndex = emitter->Code.Length;
+                Emitter_Emit64(emitter, 0);
+                uint64_t count = 0;
+                while (emitter->Current.Kind != TokenKind_CloseParenthesis && emitter->Current.Kind != TokenKind_EndOfFile) {
+                    // A failed expect does not consume the token, so stop instead of looping on it forever
+                    if (emitter->Current.Kind != TokenKind_Name) {
+                        Emitter_ExpectToken(emitter, TokenKind_Name);
+                        break;
+                    }
+                    Token name = Emitter_ExpectToken(emitter, TokenKind_Name);
+                    Emitter_EmitLabel(emitter, name);
+                    count++;
                 }
-                Emitter_Emit64(emitter, location);
+                Emitter_ExpectToken(emitter, TokenKind_CloseParenthesis);
+                *(uint64_t*)&emitter->Code.Data[countIndex] = count;
             } break;
 
             case TokenKind_GetStackTop: {
@@ -282,55 +461,479 @@ void Emitter_Emit(Emitter* emitter) {
 
             case TokenKind_Load: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_Load);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_Store: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_Store);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_Call: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_Call);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_Ret: {
                 Emitter_NextToken(emitter);
-                uint64_t size = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_Ret);
                 Emitter_Emit64(emitter, size);
             } break;
 
             case TokenKind_CallCFunc: {
                 Emitter_NextToken(emitter);
-                uint64_t argCount = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t argCount = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_EmitOp(emitter, Op_CallCFunc);
                 Emitter_Emit64(emitter, argCount);
                 for (uint64_t i = 0; i < argCount; i++) {
-                    uint64_t argSize = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                    uint64_t argSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                     Emitter_Emit64(emitter, argSize);
                 }
-                uint64_t retSize = Emitter_ExpectToken(emitter, TokenKind_Integer).IntValue;
+                uint64_t retSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
                 Emitter_Emit64(emitter, retSize);
             } break;
 
+            case TokenKind_CallExtern: {
+                Emitter_NextToken(emitter);
+                Token name = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_EmitOp(emitter, Op_CallExtern);
+                Emitter_EmitLabel(emitter, name);
+            } break;
+
+            case TokenKind_MemCopy: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_MemCopy);
+            } break;
+
+            case TokenKind_MemMove: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_MemMove);
+            } break;
+
+            case TokenKind_MemSet: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_MemSet);
+            } break;
+
+            case TokenKind_VecAdd: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                uint64_t size     = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecAdd);
+                Emitter_Emit64(emitter, laneSize);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_VecSub: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                uint64_t size     = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecSub);
+                Emitter_Emit64(emitter, laneSize);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_VecMin: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                uint64_t size     = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecMin);
+                Emitter_Emit64(emitter, laneSize);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_VecMax: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                uint64_t size     = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecMax);
+                Emitter_Emit64(emitter, laneSize);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_VecEqual: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                uint64_t size     = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecEqual);
+                Emitter_Emit64(emitter, laneSize);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_VecLess: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                uint64_t size     = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecLess);
+                Emitter_Emit64(emitter, laneSize);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_VecAddBuffer: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecAddBuffer);
+                Emitter_Emit64(emitter, laneSize);
+            } break;
+
+            case TokenKind_VecSubBuffer: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecSubBuffer);
+                Emitter_Emit64(emitter, laneSize);
+            } break;
+
+            case TokenKind_VecMinBuffer: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecMinBuffer);
+                Emitter_Emit64(emitter, laneSize);
+            } break;
+
+            case TokenKind_VecMaxBuffer: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecMaxBuffer);
+                Emitter_Emit64(emitter, laneSize);
+            } break;
+
+            case TokenKind_VecEqualBuffer: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecEqualBuffer);
+                Emitter_Emit64(emitter, laneSize);
+            } break;
+
+            case TokenKind_VecLessBuffer: {
+                Emitter_NextToken(emitter);
+                uint64_t laneSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_VecLessBuffer);
+                Emitter_Emit64(emitter, laneSize);
+            } break;
+
+            case TokenKind_Mul: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_Mul);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_DivSigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_DivSigned);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_DivUnsigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_DivUnsigned);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_ModSigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_ModSigned);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_ModUnsigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_ModUnsigned);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_And: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_And);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_Or: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_Or);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_Xor: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_Xor);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_Not: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_Not);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_ShiftLeft: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_ShiftLeft);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_ShiftRight: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_ShiftRight);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_ShiftRightArith: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_ShiftRightArith);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_Equal: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_Equal);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_LessSigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_LessSigned);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_LessUnsigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_LessUnsigned);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_LessEqualSigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_LessEqualSigned);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_LessEqualUnsigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_LessEqualUnsigned);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_JumpEqual: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Token name    = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_EmitOp(emitter, Op_JumpEqual);
+                Emitter_Emit64(emitter, size);
+                Emitter_EmitLabel(emitter, name);
+            } break;
+
+            case TokenKind_JumpNotEqual: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Token name    = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_EmitOp(emitter, Op_JumpNotEqual);
+                Emitter_Emit64(emitter, size);
+                Emitter_EmitLabel(emitter, name);
+            } break;
+
+            case TokenKind_JumpLessSigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Token name    = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_EmitOp(emitter, Op_JumpLessSigned);
+                Emitter_Emit64(emitter, size);
+                Emitter_EmitLabel(emitter, name);
+            } break;
+
+            case TokenKind_JumpLessUnsigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Token name    = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_EmitOp(emitter, Op_JumpLessUnsigned);
+                Emitter_Emit64(emitter, size);
+                Emitter_EmitLabel(emitter, name);
+            } break;
+
+            case TokenKind_JumpLessEqualSigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Token name    = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_EmitOp(emitter, Op_JumpLessEqualSigned);
+                Emitter_Emit64(emitter, size);
+                Emitter_EmitLabel(emitter, name);
+            } break;
+
+            case TokenKind_JumpLessEqualUnsigned: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Token name    = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_EmitOp(emitter, Op_JumpLessEqualUnsigned);
+                Emitter_Emit64(emitter, size);
+                Emitter_EmitLabel(emitter, name);
+            } break;
+
+            case TokenKind_FloatAdd: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_FloatAdd);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_FloatSub: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_FloatSub);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_FloatMul: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_FloatMul);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_FloatDiv: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_FloatDiv);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_FloatEqual: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_FloatEqual);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_FloatLess: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_FloatLess);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_FloatLessEqual: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_FloatLessEqual);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_FloatSqrt: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_FloatSqrt);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_IntToFloat: {
+                Emitter_NextToken(emitter);
+                uint64_t intSize   = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                uint64_t floatSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_IntToFloat);
+                Emitter_Emit64(emitter, intSize);
+                Emitter_Emit64(emitter, floatSize);
+            } break;
+
+            case TokenKind_FloatToInt: {
+                Emitter_NextToken(emitter);
+                uint64_t floatSize = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                uint64_t intSize   = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_FloatToInt);
+                Emitter_Emit64(emitter, floatSize);
+                Emitter_Emit64(emitter, intSize);
+            } break;
+
+            case TokenKind_PrintFloat: {
+                Emitter_NextToken(emitter);
+                uint64_t size = Token_GetInt(Emitter_ExpectToken(emitter, TokenKind_Integer));
+                Emitter_EmitOp(emitter, Op_PrintFloat);
+                Emitter_Emit64(emitter, size);
+            } break;
+
+            case TokenKind_HeapAlloc: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_HeapAlloc);
+            } break;
+
+            case TokenKind_HeapFree: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_HeapFree);
+            } break;
+
+            case TokenKind_HeapReset: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_HeapReset);
+            } break;
+
+            case TokenKind_Checkpoint: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_Checkpoint);
+            } break;
+
+            case TokenKind_PushData: {
+                Emitter_NextToken(emitter);
+                Token name = Emitter_ExpectToken(emitter, TokenKind_Name);
+                Emitter_EmitOp(emitter, Op_PushData);
+                Emitter_EmitLabel(emitter, name);
+            } break;
+
+            case TokenKind_TimerBegin:
+            case TokenKind_TimerEnd: {
+                Op op = emitter->Current.Kind == TokenKind_TimerBegin ? Op_TimerBegin : Op_TimerEnd;
+                Emitter_NextToken(emitter);
+                Token id = Emitter_ExpectToken(emitter, TokenKind_Integer);
+                if (Token_GetInt(id) >= VM_TIMER_COUNT) {
+                    Emitter_Error(emitter, id, "Timing region ids must be less than %d\n", VM_TIMER_COUNT);
+                }
+                Emitter_EmitOp(emitter, op);
+                Emitter_Emit64(emitter, Token_GetInt(id));
+            } break;
+
+            case TokenKind_IoOpen: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_IoOpen);
+            } break;
+
+            case TokenKind_IoRead: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_IoRead);
+            } break;
+
+            case TokenKind_IoWrite: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_IoWrite);
+            } break;
+
+            case TokenKind_IoClose: {
+                Emitter_NextToken(emitter);
+                Emitter_EmitOp(emitter, Op_IoClose);
+            } break;
+
             default: {
                 String name = GetTokenKindName(emitter->Current.Kind);
-                fflush(stdout);
-                fprintf(stderr,
-                        "%.*s:%llu:%llu: Unexpected token '%.*s'\n",
-                        String_Fmt(emitter->Current.FilePath),
-                        emitter->Current.Line,
-                        emitter->Current.Column,
-                        String_Fmt(name));
-                emitter->WasError = true;
+                Emitter_Error(emitter, emitter->Current, "Unexpected token '%.*s'\n", String_Fmt(name));
                 Emitter_NextToken(emitter);
             } break;
         }
@@ -341,6 +944,11 @@ Token Emitter_NextToken(Emitter* emitter) {
     Token current = emitter->Current;
     if (emitter->NextTokens.Length > 0) {
         emitter->Current = TokenArray_Remove(&emitter->NextTokens, 0);
+    } else if (emitter->IsPreLexed) {
+        // The last token is the end of file, which is never consumed
+        if (emitter->PreLexedIndex < emitter->PreLexedTokens.Kinds.Length) {
+            emitter->Current = TokenBuffer_Get(&emitter->PreLexedTokens, emitter->PreLexedIndex++);
+        }
     } else {
         emitter->Current = Lexer_NextToken(&emitter->Lexer);
     }
@@ -352,26 +960,16 @@ Token Emitter_ExpectToken(Emitter* emitter, TokenKind kind) {
         return Emitter_NextToken(emitter);
     }
 
-    emitter->WasError = true;
-
     String expected = GetTokenKindName(kind);
     String got      = GetTokenKindName(emitter->Current.Kind);
-    fprintf(stderr,
-            "%.*s:%llu:%llu: Expected token '%.*s', got token '%.*s'\n",
-            String_Fmt(emitter->Current.FilePath),
-            emitter->Current.Line,
-            emitter->Current.Column,
-            String_Fmt(expected),
-            String_Fmt(got));
+    Emitter_Error(emitter, emitter->Current, "Expected token '%.*s', got token '%.*s'\n", String_Fmt(expected), String_Fmt(got));
 
+    // The token has no text, so it reads as an empty name or a zero
     return (Token){
-        .Kind     = kind,
-        .FilePath = emitter->Current.FilePath,
-        .Source   = emitter->Current.Source,
-        .Position = emitter->Current.Position,
-        .Line     = emitter->Current.Line,
-        .Column   = emitter->Current.Column,
-        .Length   = emitter->Current.Length,
+        .Kind   = kind,
+        .File   = emitter->Current.File,
+        .Offset = emitter->Current.Offset,
+        .Length = 0,
     };
 }
 
@@ -383,8 +981,81 @@ void Emitter_Emit64(Emitter* emitter, uint64_t value) {
     Emitter_EmitBytes(emitter, (uint8_t*)&value, sizeof(uint64_t));
 }
 
-void Emitter_EmitBytes(Emitter* emitter, uint8_t* bytes, uint64_t count) {
-    for (uint64_t i = 0; i < count; i++) {
-        ByteArray_Push(&emitter->Code, bytes[i]);
+void Emitter_EmitLabel(Emitter* emitter, Token name) {
+    uint64_t index = emitter->Code.Length;
+    Emitter_Emit64(emitter, 0);
+    Emitter_ReferenceLabel(emitter, name, index);
+}
+
+void Emitter_DefineLabel(Emitter* emitter, Token name, uint64_t location) {
+    String nameString = Token_GetString(name);
+    // TODO: Duplicate labels
+    LabelArray_Push(&emitter->Labels,
+                    (Label){
+                        .Token    = name,
+                        .Location = location,
+                    });
+    for (int64_t i = (int64_t)emitter->UnknownLabels.Length - 1; i >= 0; i--) {
+        if (String_Equal(Token_GetString(emitter->UnknownLabels.Data[i].Token), nameString)) {
+            UnknownLabel unknown = UnknownLabelArray_Remove(&emitter->UnknownLabels, i);
+            *(uint64_t*)&emitter->Code.Data[unknown.IndexForAddress] = location;
+        }
+    }
+}
+
+// Fills in the location of the label at index, or records it to be patched once the label is defined
+static void Emitter_LinkLabel(Emitter* emitter, Token name, uint64_t index) {
+    String nameString = Token_GetString(name);
+    for (uint64_t i = 0; i < emitter->Labels.Length; i++) {
+        if (String_Equal(Token_GetString(emitter->Labels.Data[i].Token), nameString)) {
+            *(uint64_t*)&emitter->Code.Data[index] = emitter->Labels.Data[i].Location;
+            return;
+        }
+    }
+
+    *(uint64_t*)&emitter->Code.Data[index] = 0;
+    UnknownLabelArray_Push(&emitter->UnknownLabels,
+                           (UnknownLabel){
+                               .Token           = name,
+                               .IndexForAddress = index,
+                           });
+}
+
+void Emitter_AppendModule(Emitter* emitter, Module* module) {
+    Emitter* source = &module->Emitter;
+    uint64_t base   = emitter->Code.Length;
+    ByteArray_Append(&emitter->Code, source->Code.Data, source->Code.Length);
+    for (uint64_t i = 0; i < source->Labels.Length; i++) {
+        Emitter_DefineLabel(emitter, source->Labels.Data[i].Token, base + source->Labels.Data[i].Location);
+    }
+
+    // The references the module resolved itself only move with its code, looking them up by name again could find a label
+    // of the same name outside of the module
+    for (uint64_t i = 0; i < source->References.Length; i++) {
+        uint64_t index = base + source->References.Data[i].IndexForAddress;
+        LabelReferenceArray_Push(&emitter->References,
+                                 (LabelReference){
+                                     .Token           = source->References.Data[i].Token,
+                                     .IndexForAddress = index,
+                                 });
+        *(uint64_t*)&emitter->Code.Data[index] += base;
+    }
+    // Only the labels the module left unknown come from outside of it
+    for (uint64_t i = 0; i < source->UnknownLabels.Length; i++) {
+        UnknownLabel unknown = source->UnknownLabels.Data[i];
+        Emitter_LinkLabel(emitter, unknown.Token, base + unknown.IndexForAddress);
     }
 }
+
+void Emitter_ReferenceLabel(Emitter* emitter, Token name, uint64_t index) {
+    LabelReferenceArray_Push(&emitter->References,
+                             (LabelReference){
+                                 .Token           = name,
+                                 .IndexForAddress = index,
+                             });
+    Emitter_LinkLabel(emitter, name, index);
+}
+
+void Emitter_EmitBytes(Emitter* emitter, uint8_t* bytes, uint64_t count) {
+    ByteArray_Append(&emitter->Code, bytes, count);
+}
@@ -14,34 +14,79 @@ typedef struct UnknownLabel {
     uint64_t IndexForAddress;
 } UnknownLabel;
 
+typedef struct LabelReference {
+    Token Token;
+    uint64_t IndexForAddress;
+} LabelReference;
+
 ARRAY_DECL(Token, Token);
 
+ARRAY_DECL(Label, Label);
+ARRAY_DECL(UnknownLabel, UnknownLabel);
+ARRAY_DECL(LabelReference, LabelReference);
+
 typedef struct Macro {
     Token Name;
-    TokenArray Tokens;
+    TokenBuffer Tokens;
+    // Set when the body assembled on its own, expanding the macro then copies Code instead of replaying Tokens
+    bool IsAssembled;
+    ByteArray Code;
+    // The label uses in Code, relative to the start of the body, they are resolved where the macro is expanded
+    LabelReferenceArray References;
 } Macro;
 
-ARRAY_DECL(uint8_t, Byte);
-ARRAY_DECL(Label, Label);
-ARRAY_DECL(UnknownLabel, UnknownLabel);
 ARRAY_DECL(Macro, Macro);
 
+typedef struct Module Module;
+
+ARRAY_DECL(Module*, ModulePointer);
+
+// All of the arrays are allocated from the arena of the lexer
 typedef struct Emitter {
     Lexer Lexer;
     ByteArray Code;
     Token Current;
     TokenArray NextTokens;
+    // Set when the whole source was lexed up front, the tokens are read from here instead of the lexer
+    bool IsPreLexed;
+    TokenBuffer PreLexedTokens;
+    uint64_t PreLexedIndex;
     LabelArray Labels;
     UnknownLabelArray UnknownLabels;
+    // Every place in the code that holds a label location, so the code can be moved around after it is emitted
+    LabelReferenceArray References;
     MacroArray Macros;
     bool WasError;
+
+    // Searched after the emitter's own macros, owned by the caller
+    const MacroArray* ExternalMacros;
+    // The name of every external macro that was expanded, so the caller knows what the code depends on
+    TokenArray ExpandedExternalMacros;
+    // Leaves labels that are not defined in this code in UnknownLabels instead of reporting them
+    // The imported modules are not appended either, so code that is linked later can share them
+    bool DeferUnknownLabels;
+    // Every module this code imports, directly or through other modules, in the order their code is appended
+    ModulePointerArray Imports;
+    // Errors still set WasError but are not printed, used when trying to assemble a macro body on its own
+    bool SuppressErrors;
 } Emitter;
 
 bool Emitter_Create(Emitter* emitter, Lexer lexer);
+// Lexes the whole source first, on multiple threads when it is large enough, see Lexer_LexAll
+bool Emitter_CreatePreLexed(Emitter* emitter, Lexer lexer, uint64_t threadCount);
 void Emitter_Destroy(Emitter* emitter);
 void Emitter_Emit(Emitter* emitter);
 Token Emitter_NextToken(Emitter* emitter);
 Token Emitter_ExpectToken(Emitter* emitter, TokenKind kind);
 void Emitter_EmitOp(Emitter* emitter, Op op);
 void Emitter_Emit64(Emitter* emitter, uint64_t value);
+// Emits the location of the label, or records it to be patched once the label is defined
+void Emitter_EmitLabel(Emitter* emitter, Token name);
+// Records that the 8 bytes at index hold the location of the label and fills them in if the label is already defined
+void Emitter_ReferenceLabel(Emitter* emitter, Token name, uint64_t index);
 void Emitter_EmitBytes(Emitter* emitter, uint8_t* bytes, uint64_t count);
+// Defines the label at location and fills in the uses of it that were emitted before
+void Emitter_DefineLabel(Emitter* emitter, Token name, uint64_t location);
+// Appends the code of the module and links its labels with the labels of this code
+// Called for every import at the end of the code, unless DeferUnknownLabels is set, then it is up to the caller
+void Emitter_AppendModule(Emitter* emitter, Module* module);
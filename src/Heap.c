@@ -0,0 +1,139 @@
+#include "Heap.h"
+
+#include <stdlib.h>
+
+#define HEAP_BLOCK_SIZE (1024 * 1024)
+#define HEAP_ALIGNMENT  16
+
+// Marks an allocation that did not come from a size class
+#define HEAP_LARGE_CLASS UINT64_MAX
+
+struct HeapBlock {
+    HeapBlock* Next;
+    uint64_t Size;
+    _Alignas(HEAP_ALIGNMENT) uint8_t Data[];
+};
+
+// Sits right before every allocation, the size is 16 so the data stays aligned
+typedef struct HeapHeader {
+    uint64_t Class;
+    uint64_t Size;
+} HeapHeader;
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void* Heap_Bump(Heap* heap, uint64_t size) {
+    size = AlignUp(size, HEAP_ALIGNMENT);
+
+    while (heap->CurrentBlock) {
+        if (heap->Offset + size <= heap->CurrentBlock->Size) {
+            void* ptr = &heap->CurrentBlock->Data[heap->Offset];
+            heap->Offset += size;
+            return ptr;
+        }
+
+        if (!heap->CurrentBlock->Next) {
+            break;
+        }
+
+        // Blocks after the current one are left over from before a reset
+        heap->CurrentBlock = heap->CurrentBlock->Next;
+        heap->Offset       = 0;
+    }
+
+    uint64_t blockSize = size > HEAP_BLOCK_SIZE ? size : HEAP_BLOCK_SIZE;
+    HeapBlock* block   = malloc(sizeof(HeapBlock) + blockSize);
+    if (!block) {
+        return NULL;
+    }
+
+    block->Next = NULL;
+    block->Size = blockSize;
+    if (heap->CurrentBlock) {
+        heap->CurrentBlock->Next = block;
+    } else {
+        heap->FirstBlock = block;
+    }
+    heap->CurrentBlock = block;
+    heap->Offset       = size;
+    heap->Stats.BytesReserved += blockSize;
+    return block->Data;
+}
+
+void Heap_Init(Heap* heap) {
+    *heap = (Heap){};
+}
+
+void Heap_Destroy(Heap* heap) {
+    HeapBlock* block = heap->FirstBlock;
+    while (block) {
+        HeapBlock* next = block->Next;
+        free(block);
+        block = next;
+    }
+    *heap = (Heap){};
+}
+
+void* Heap_Allocate(Heap* heap, uint64_t size) {
+    uint64_t class     = HEAP_LARGE_CLASS;
+    uint64_t classSize = size;
+    if (size <= HEAP_MAX_CLASS_SIZE) {
+        class     = 0;
+        classSize = HEAP_MIN_CLASS_SIZE;
+        while (classSize < size) {
+            classSize <<= 1;
+            class++;
+        }
+    }
+
+    HeapHeader* header;
+    if (class != HEAP_LARGE_CLASS && heap->FreeLists[class]) {
+        header                 = (HeapHeader*)heap->FreeLists[class] - 1;
+        heap->FreeLists[class] = *(void**)heap->FreeLists[class];
+    } else {
+        header = Heap_Bump(heap, sizeof(HeapHeader) + classSize);
+        if (!header) {
+            return NULL;
+        }
+    }
+
+    header->Class = class;
+    header->Size  = classSize;
+
+    heap->Stats.AllocationCount++;
+    heap->Stats.BytesInUse += classSize;
+    if (heap->Stats.BytesInUse > heap->Stats.PeakBytesInUse) {
+        heap->Stats.PeakBytesInUse = heap->Stats.BytesInUse;
+    }
+    return header + 1;
+}
+
+void Heap_Free(Heap* heap, void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    HeapHeader* header = (HeapHeader*)ptr - 1;
+    heap->Stats.FreeCount++;
+    heap->Stats.BytesInUse -= header->Size;
+    if (header->Class != HEAP_LARGE_CLASS) {
+        *(void**)ptr                   = heap->FreeLists[header->Class];
+        heap->FreeLists[header->Class] = ptr;
+    }
+}
+
+void Heap_Reset(Heap* heap) {
+    heap->CurrentBlock = heap->FirstBlock;
+    heap->Offset       = 0;
+    for (uint64_t i = 0; i < HEAP_SIZE_CLASS_COUNT; i++) {
+        heap->FreeLists[i] = NULL;
+    }
+    heap->Stats.BytesInUse = 0;
+    heap->Stats.ResetCount++;
+}
+
+HeapStats Heap_GetStats(Heap* heap) {
+    return heap->Stats;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Small allocations are served from free lists of power of 2 sizes starting at 16 bytes
+#define HEAP_SIZE_CLASS_COUNT 8
+#define HEAP_MIN_CLASS_SIZE   16
+#define HEAP_MAX_CLASS_SIZE   (HEAP_MIN_CLASS_SIZE << (HEAP_SIZE_CLASS_COUNT - 1))
+
+typedef struct HeapBlock HeapBlock;
+
+typedef struct HeapStats {
+    uint64_t BytesInUse;
+    uint64_t PeakBytesInUse;
+    uint64_t BytesReserved;
+    uint64_t AllocationCount;
+    uint64_t FreeCount;
+    uint64_t ResetCount;
+} HeapStats;
+
+// A bump arena made of a chain of blocks, with size class free lists carved out of it
+// Allocations larger than the biggest size class are only reclaimed by Heap_Reset
+typedef struct Heap {
+    HeapBlock* FirstBlock;
+    HeapBlock* CurrentBlock;
+    uint64_t Offset;
+    void* FreeLists[HEAP_SIZE_CLASS_COUNT];
+    HeapStats Stats;
+} Heap;
+
+void Heap_Init(Heap* heap);
+void Heap_Destroy(Heap* heap);
+void* Heap_Allocate(Heap* heap, uint64_t size);
+void Heap_Free(Heap* heap, void* ptr);
+// Releases every allocation at once, the blocks are kept around to be reused
+void Heap_Reset(Heap* heap);
+HeapStats Heap_GetStats(Heap* heap);
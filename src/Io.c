@@ -0,0 +1,174 @@
+#include "Io.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+
+#if defined(_WIN32)
+    #include <Windows.h>
+#else
+    #error Unsupported platform
+#endif
+
+struct IoRequest {
+    // First, so the OVERLAPPED a completion hands back is the request
+    OVERLAPPED Overlapped;
+    VM* VM;
+};
+
+bool IoQueue_Create(IoQueue* queue) {
+    *queue = (IoQueue){};
+#if defined(_WIN32)
+    queue->Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (!queue->Port) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to create an I/O completion port\n");
+        return false;
+    }
+    return true;
+#else
+    #error Unsupported platform
+#endif
+}
+
+void IoQueue_Destroy(IoQueue* queue) {
+#if defined(_WIN32)
+    if (queue->Port) {
+        CloseHandle(queue->Port);
+    }
+#else
+    #error Unsupported platform
+#endif
+    *queue = (IoQueue){};
+}
+
+bool IoQueue_AddHandle(IoQueue* queue, uint64_t handle) {
+#if defined(_WIN32)
+    return CreateIoCompletionPort((HANDLE)handle, queue->Port, 0, 0) != NULL;
+#else
+    #error Unsupported platform
+#endif
+}
+
+VM* IoQueue_Wait(IoQueue* queue) {
+    if (queue->WaitingCount == 0) {
+        return NULL;
+    }
+
+#if defined(_WIN32)
+    DWORD transferred      = 0;
+    ULONG_PTR key          = 0;
+    OVERLAPPED* overlapped = NULL;
+    BOOL succeeded         = GetQueuedCompletionStatus(queue->Port, &transferred, &key, &overlapped, INFINITE);
+    if (!overlapped) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to wait for I/O to complete\n");
+        return NULL;
+    }
+
+    uint64_t count = transferred;
+    if (!succeeded) {
+        count = GetLastError() == ERROR_HANDLE_EOF ? 0 : IO_FAILED;
+    }
+#else
+    #error Unsupported platform
+#endif
+
+    VM* vm = ((IoRequest*)overlapped)->VM;
+    memcpy(vm->Sp, &count, sizeof(count));
+    vm->Sp += sizeof(count);
+    queue->WaitingCount--;
+    return vm;
+}
+
+uint64_t Io_Open(IoQueue* queue, const uint8_t* path, uint64_t pathLength, uint64_t mode) {
+#if defined(_WIN32)
+    char terminatedPath[MAX_PATH];
+    if (pathLength >= MAX_PATH || mode > IoMode_ReadWrite) {
+        return IO_FAILED;
+    }
+    memcpy(terminatedPath, path, pathLength);
+    terminatedPath[pathLength] = '\0';
+
+    static const DWORD access[]       = {GENERIC_READ, GENERIC_WRITE, GENERIC_READ | GENERIC_WRITE};
+    static const DWORD dispositions[] = {OPEN_EXISTING, CREATE_ALWAYS, OPEN_ALWAYS};
+
+    // Always overlapped, so the handle can be waited on through a queue or in place
+    HANDLE file = CreateFileA(terminatedPath,
+                              access[mode],
+                              FILE_SHARE_READ,
+                              NULL,
+                              dispositions[mode],
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+                              NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return IO_FAILED;
+    }
+    if (queue && !IoQueue_AddHandle(queue, (uint64_t)file)) {
+        CloseHandle(file);
+        return IO_FAILED;
+    }
+    return (uint64_t)file;
+#else
+    #error Unsupported platform
+#endif
+}
+
+void Io_Close(uint64_t handle) {
+    if (handle == IO_FAILED) {
+        return;
+    }
+#if defined(_WIN32)
+    CloseHandle((HANDLE)handle);
+#else
+    #error Unsupported platform
+#endif
+}
+
+bool Io_Transfer(VM* vm, bool isWrite, uint64_t handle, uint8_t* buffer, uint64_t size, uint64_t offset, uint64_t* count) {
+    *count = IO_FAILED;
+    if (!vm->IoRequest) {
+        vm->IoRequest = malloc(sizeof(IoRequest));
+        if (!vm->IoRequest) {
+            return true;
+        }
+    }
+
+#if defined(_WIN32)
+    if (size > UINT32_MAX) {
+        size = UINT32_MAX;
+    }
+
+    IoRequest* request             = vm->IoRequest;
+    request->Overlapped            = (OVERLAPPED){};
+    request->Overlapped.Offset     = (DWORD)offset;
+    request->Overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    request->VM                    = vm;
+
+    BOOL started = isWrite ? WriteFile((HANDLE)handle, buffer, (DWORD)size, NULL, &request->Overlapped)
+                           : ReadFile((HANDLE)handle, buffer, (DWORD)size, NULL, &request->Overlapped);
+    if (!started) {
+        DWORD error = GetLastError();
+        if (error != ERROR_IO_PENDING) {
+            *count = error == ERROR_HANDLE_EOF ? 0 : IO_FAILED;
+            return true;
+        }
+    }
+
+    // The completion is queued even when the transfer finished right away
+    if (vm->Io) {
+        vm->Io->WaitingCount++;
+        return false;
+    }
+
+    DWORD transferred = 0;
+    if (!GetOverlappedResult((HANDLE)handle, &request->Overlapped, &transferred, TRUE)) {
+        *count = GetLastError() == ERROR_HANDLE_EOF ? 0 : IO_FAILED;
+        return true;
+    }
+    *count = transferred;
+    return true;
+#else
+    #error Unsupported platform
+#endif
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "VM.h"
+
+// The mode operand of io-open
+typedef enum IoMode {
+    // Opens an existing file for reading
+    IoMode_Read,
+    // Creates the file or truncates it, and opens it for writing
+    IoMode_Write,
+    // Opens the file for reading and writing, creating it if it does not exist
+    IoMode_ReadWrite,
+} IoMode;
+
+// Handed to the program in place of a handle or a byte count when the operation failed
+#define IO_FAILED UINT64_MAX
+
+// A completion port shared by many VMs, so one thread can run whichever VM has its I/O done
+// VMs without a queue block in every read and write instead
+// A handle must only be used by VMs that share the queue it was opened with
+typedef struct IoQueue {
+    void* Port;
+    // VMs that returned VMResult_Waiting and were not handed back by IoQueue_Wait yet
+    uint64_t WaitingCount;
+} IoQueue;
+
+bool IoQueue_Create(IoQueue* queue);
+// Every VM that uses the queue must be done waiting
+void IoQueue_Destroy(IoQueue* queue);
+// Handles that were not opened by io-open, like sockets, must be opened for overlapped I/O and added before they are used
+bool IoQueue_AddHandle(IoQueue* queue, uint64_t handle);
+// Blocks until the I/O of one of the waiting VMs completes, pushes the byte count onto its stack and returns the VM
+// VM_Run then continues it after the io-read or io-write, NULL is returned when no VM is waiting
+VM* IoQueue_Wait(IoQueue* queue);
+
+// The io ops of VM_Run, their operands were already popped
+uint64_t Io_Open(IoQueue* queue, const uint8_t* path, uint64_t pathLength, uint64_t mode);
+void Io_Close(uint64_t handle);
+// Returns true when the transfer is done and count holds the number of bytes transferred, or IO_FAILED
+// Returns false when the VM has to wait for it in the queue
+// Transfers of more than 4GB are cut short, like any partial read or write
+bool Io_Transfer(VM* vm, bool isWrite, uint64_t handle, uint8_t* buffer, uint64_t size, uint64_t offset, uint64_t* count);
@@ -24,10 +24,20 @@ String GetTokenKindName(TokenKind kind) {
             return String_FromLiteral(")");
         case TokenKind_Integer:
             return String_FromLiteral("Integer");
+        case TokenKind_Float:
+            return String_FromLiteral("Float");
+        case TokenKind_String:
+            return String_FromLiteral("String");
         case TokenKind_Name:
             return String_FromLiteral("Name");
         case TokenKind_Macro:
             return String_FromLiteral("macro");
+        case TokenKind_Import:
+            return String_FromLiteral("import");
+        case TokenKind_Extern:
+            return String_FromLiteral("extern");
+        case TokenKind_Data:
+            return String_FromLiteral("data");
         case TokenKind_Exit:
             return String_FromLiteral("exit");
         case TokenKind_Push:
@@ -66,6 +76,130 @@ String GetTokenKindName(TokenKind kind) {
             return String_FromLiteral("ret");
         case TokenKind_CallCFunc:
             return String_FromLiteral("call-c-func");
+        case TokenKind_CallExtern:
+            return String_FromLiteral("call-extern");
+        case TokenKind_MemCopy:
+            return String_FromLiteral("mem-copy");
+        case TokenKind_MemMove:
+            return String_FromLiteral("mem-move");
+        case TokenKind_MemSet:
+            return String_FromLiteral("mem-set");
+        case TokenKind_VecAdd:
+            return String_FromLiteral("vec-add");
+        case TokenKind_VecSub:
+            return String_FromLiteral("vec-sub");
+        case TokenKind_VecMin:
+            return String_FromLiteral("vec-min");
+        case TokenKind_VecMax:
+            return String_FromLiteral("vec-max");
+        case TokenKind_VecEqual:
+            return String_FromLiteral("vec-equal");
+        case TokenKind_VecLess:
+            return String_FromLiteral("vec-less");
+        case TokenKind_VecAddBuffer:
+            return String_FromLiteral("vec-add-buffer");
+        case TokenKind_VecSubBuffer:
+            return String_FromLiteral("vec-sub-buffer");
+        case TokenKind_VecMinBuffer:
+            return String_FromLiteral("vec-min-buffer");
+        case TokenKind_VecMaxBuffer:
+            return String_FromLiteral("vec-max-buffer");
+        case TokenKind_VecEqualBuffer:
+            return String_FromLiteral("vec-equal-buffer");
+        case TokenKind_VecLessBuffer:
+            return String_FromLiteral("vec-less-buffer");
+        case TokenKind_Mul:
+            return String_FromLiteral("mul");
+        case TokenKind_DivSigned:
+            return String_FromLiteral("div-signed");
+        case TokenKind_DivUnsigned:
+            return String_FromLiteral("div-unsigned");
+        case TokenKind_ModSigned:
+            return String_FromLiteral("mod-signed");
+        case TokenKind_ModUnsigned:
+            return String_FromLiteral("mod-unsigned");
+        case TokenKind_And:
+            return String_FromLiteral("and");
+        case TokenKind_Or:
+            return String_FromLiteral("or");
+        case TokenKind_Xor:
+            return String_FromLiteral("xor");
+        case TokenKind_Not:
+            return String_FromLiteral("not");
+        case TokenKind_ShiftLeft:
+            return String_FromLiteral("shift-left");
+        case TokenKind_ShiftRight:
+            return String_FromLiteral("shift-right");
+        case TokenKind_ShiftRightArith:
+            return String_FromLiteral("shift-right-arith");
+        case TokenKind_Equal:
+            return String_FromLiteral("equal");
+        case TokenKind_LessSigned:
+            return String_FromLiteral("less-signed");
+        case TokenKind_LessUnsigned:
+            return String_FromLiteral("less-unsigned");
+        case TokenKind_LessEqualSigned:
+            return String_FromLiteral("less-equal-signed");
+        case TokenKind_LessEqualUnsigned:
+            return String_FromLiteral("less-equal-unsigned");
+        case TokenKind_JumpEqual:
+            return String_FromLiteral("jump-equal");
+        case TokenKind_JumpNotEqual:
+            return String_FromLiteral("jump-not-equal");
+        case TokenKind_JumpLessSigned:
+            return String_FromLiteral("jump-less-signed");
+        case TokenKind_JumpLessUnsigned:
+            return String_FromLiteral("jump-less-unsigned");
+        case TokenKind_JumpLessEqualSigned:
+            return String_FromLiteral("jump-less-equal-signed");
+        case TokenKind_JumpLessEqualUnsigned:
+            return String_FromLiteral("jump-less-equal-unsigned");
+        case TokenKind_FloatAdd:
+            return String_FromLiteral("float-add");
+        case TokenKind_FloatSub:
+            return String_FromLiteral("float-sub");
+        case TokenKind_FloatMul:
+            return String_FromLiteral("float-mul");
+        case TokenKind_FloatDiv:
+            return String_FromLiteral("float-div");
+        case TokenKind_FloatEqual:
+            return String_FromLiteral("float-equal");
+        case TokenKind_FloatLess:
+            return String_FromLiteral("float-less");
+        case TokenKind_FloatLessEqual:
+            return String_FromLiteral("float-less-equal");
+        case TokenKind_FloatSqrt:
+            return String_FromLiteral("float-sqrt");
+        case TokenKind_IntToFloat:
+            return String_FromLiteral("int-to-float");
+        case TokenKind_FloatToInt:
+            return String_FromLiteral("float-to-int");
+        case TokenKind_PrintFloat:
+            return String_FromLiteral("print-float");
+        case TokenKind_HeapAlloc:
+            return String_FromLiteral("heap-alloc");
+        case TokenKind_HeapFree:
+            return String_FromLiteral("heap-free");
+        case TokenKind_HeapReset:
+            return String_FromLiteral("heap-reset");
+        case TokenKind_JumpTable:
+            return String_FromLiteral("jump-table");
+        case TokenKind_Checkpoint:
+            return String_FromLiteral("checkpoint");
+        case TokenKind_IoOpen:
+            return String_FromLiteral("io-open");
+        case TokenKind_IoRead:
+            return String_FromLiteral("io-read");
+        case TokenKind_IoWrite:
+            return String_FromLiteral("io-write");
+        case TokenKind_IoClose:
+            return String_FromLiteral("io-close");
+        case TokenKind_PushData:
+            return String_FromLiteral("push-data");
+        case TokenKind_TimerBegin:
+            return String_FromLiteral("timer-begin");
+        case TokenKind_TimerEnd:
+            return String_FromLiteral("timer-end");
     }
     return String_FromLiteral("UNREACHABLE");
 }
@@ -78,6 +212,18 @@ struct {
         .Name = String_FromLiteral("macro"),
         .Kind = TokenKind_Macro,
     },
+    {
+        .Name = String_FromLiteral("import"),
+        .Kind = TokenKind_Import,
+    },
+    {
+        .Name = String_FromLiteral("extern"),
+        .Kind = TokenKind_Extern,
+    },
+    {
+        .Name = String_FromLiteral("data"),
+        .Kind = TokenKind_Data,
+    },
     {
         .Name = String_FromLiteral("exit"),
         .Kind = TokenKind_Exit,
@@ -154,8 +300,480 @@ struct {
         .Name = String_FromLiteral("call-c-func"),
         .Kind = TokenKind_CallCFunc,
     },
+    {
+        .Name = String_FromLiteral("call-extern"),
+        .Kind = TokenKind_CallExtern,
+    },
+    {
+        .Name = String_FromLiteral("mem-copy"),
+        .Kind = TokenKind_MemCopy,
+    },
+    {
+        .Name = String_FromLiteral("mem-move"),
+        .Kind = TokenKind_MemMove,
+    },
+    {
+        .Name = String_FromLiteral("mem-set"),
+        .Kind = TokenKind_MemSet,
+    },
+    {
+        .Name = String_FromLiteral("vec-add"),
+        .Kind = TokenKind_VecAdd,
+    },
+    {
+        .Name = String_FromLiteral("vec-sub"),
+        .Kind = TokenKind_VecSub,
+    },
+    {
+        .Name = String_FromLiteral("vec-min"),
+        .Kind = TokenKind_VecMin,
+    },
+    {
+        .Name = String_FromLiteral("vec-max"),
+        .Kind = TokenKind_VecMax,
+    },
+    {
+        .Name = String_FromLiteral("vec-equal"),
+        .Kind = TokenKind_VecEqual,
+    },
+    {
+        .Name = String_FromLiteral("vec-less"),
+        .Kind = TokenKind_VecLess,
+    },
+    {
+        .Name = String_FromLiteral("vec-add-buffer"),
+        .Kind = TokenKind_VecAddBuffer,
+    },
+    {
+        .Name = String_FromLiteral("vec-sub-buffer"),
+        .Kind = TokenKind_VecSubBuffer,
+    },
+    {
+        .Name = String_FromLiteral("vec-min-buffer"),
+        .Kind = TokenKind_VecMinBuffer,
+    },
+    {
+        .Name = String_FromLiteral("vec-max-buffer"),
+        .Kind = TokenKind_VecMaxBuffer,
+    },
+    {
+        .Name = String_FromLiteral("vec-equal-buffer"),
+        .Kind = TokenKind_VecEqualBuffer,
+    },
+    {
+        .Name = String_FromLiteral("vec-less-buffer"),
+        .Kind = TokenKind_VecLessBuffer,
+    },
+    {
+        .Name = String_FromLiteral("mul"),
+        .Kind = TokenKind_Mul,
+    },
+    {
+        .Name = String_FromLiteral("div-signed"),
+        .Kind = TokenKind_DivSigned,
+    },
+    {
+        .Name = String_FromLiteral("div-unsigned"),
+        .Kind = TokenKind_DivUnsigned,
+    },
+    {
+        .Name = String_FromLiteral("mod-signed"),
+        .Kind = TokenKind_ModSigned,
+    },
+    {
+        .Name = String_FromLiteral("mod-unsigned"),
+        .Kind = TokenKind_ModUnsigned,
+    },
+    {
+        .Name = String_FromLiteral("and"),
+        .Kind = TokenKind_And,
+    },
+    {
+        .Name = String_FromLiteral("or"),
+        .Kind = TokenKind_Or,
+    },
+    {
+        .Name = String_FromLiteral("xor"),
+        .Kind = TokenKind_Xor,
+    },
+    {
+        .Name = String_FromLiteral("not"),
+        .Kind = TokenKind_Not,
+    },
+    {
+        .Name = String_FromLiteral("shift-left"),
+        .Kind = TokenKind_ShiftLeft,
+    },
+    {
+        .Name = String_FromLiteral("shift-right"),
+        .Kind = TokenKind_ShiftRight,
+    },
+    {
+        .Name = String_FromLiteral("shift-right-arith"),
+        .Kind = TokenKind_ShiftRightArith,
+    },
+    {
+        .Name = String_FromLiteral("equal"),
+        .Kind = TokenKind_Equal,
+    },
+    {
+        .Name = String_FromLiteral("less-signed"),
+        .Kind = TokenKind_LessSigned,
+    },
+    {
+        .Name = String_FromLiteral("less-unsigned"),
+        .Kind = TokenKind_LessUnsigned,
+    },
+    {
+        .Name = String_FromLiteral("less-equal-signed"),
+        .Kind = TokenKind_LessEqualSigned,
+    },
+    {
+        .Name = String_FromLiteral("less-equal-unsigned"),
+        .Kind = TokenKind_LessEqualUnsigned,
+    },
+    {
+        .Name = String_FromLiteral("jump-equal"),
+        .Kind = TokenKind_JumpEqual,
+    },
+    {
+        .Name = String_FromLiteral("jump-not-equal"),
+        .Kind = TokenKind_JumpNotEqual,
+    },
+    {
+        .Name = String_FromLiteral("jump-less-signed"),
+        .Kind = TokenKind_JumpLessSigned,
+    },
+    {
+        .Name = String_FromLiteral("jump-less-unsigned"),
+        .Kind = TokenKind_JumpLessUnsigned,
+    },
+    {
+        .Name = String_FromLiteral("jump-less-equal-signed"),
+        .Kind = TokenKind_JumpLessEqualSigned,
+    },
+    {
+        .Name = String_FromLiteral("jump-less-equal-unsigned"),
+        .Kind = TokenKind_JumpLessEqualUnsigned,
+    },
+    {
+        .Name = String_FromLiteral("float-add"),
+        .Kind = TokenKind_FloatAdd,
+    },
+    {
+        .Name = String_FromLiteral("float-sub"),
+        .Kind = TokenKind_FloatSub,
+    },
+    {
+        .Name = String_FromLiteral("float-mul"),
+        .Kind = TokenKind_FloatMul,
+    },
+    {
+        .Name = String_FromLiteral("float-div"),
+        .Kind = TokenKind_FloatDiv,
+    },
+    {
+        .Name = String_FromLiteral("float-equal"),
+        .Kind = TokenKind_FloatEqual,
+    },
+    {
+        .Name = String_FromLiteral("float-less"),
+        .Kind = TokenKind_FloatLess,
+    },
+    {
+        .Name = String_FromLiteral("float-less-equal"),
+        .Kind = TokenKind_FloatLessEqual,
+    },
+    {
+        .Name = String_FromLiteral("float-sqrt"),
+        .Kind = TokenKind_FloatSqrt,
+    },
+    {
+        .Name = String_FromLiteral("int-to-float"),
+        .Kind = TokenKind_IntToFloat,
+    },
+    {
+        .Name = String_FromLiteral("float-to-int"),
+        .Kind = TokenKind_FloatToInt,
+    },
+    {
+        .Name = String_FromLiteral("print-float"),
+        .Kind = TokenKind_PrintFloat,
+    },
+    {
+        .Name = String_FromLiteral("heap-alloc"),
+        .Kind = TokenKind_HeapAlloc,
+    },
+    {
+        .Name = String_FromLiteral("heap-free"),
+        .Kind = TokenKind_HeapFree,
+    },
+    {
+        .Name = String_FromLiteral("heap-reset"),
+        .Kind = TokenKind_HeapReset,
+    },
+    {
+        .Name = String_FromLiteral("jump-table"),
+        .Kind = TokenKind_JumpTable,
+    },
+    {
+        .Name = String_FromLiteral("checkpoint"),
+        .Kind = TokenKind_Checkpoint,
+    },
+    {
+        .Name = String_FromLiteral("io-open"),
+        .Kind = TokenKind_IoOpen,
+    },
+    {
+        .Name = String_FromLiteral("io-read"),
+        .Kind = TokenKind_IoRead,
+    },
+    {
+        .Name = String_FromLiteral("io-write"),
+        .Kind = TokenKind_IoWrite,
+    },
+    {
+        .Name = String_FromLiteral("io-close"),
+        .Kind = TokenKind_IoClose,
+    },
+    {
+        .Name = String_FromLiteral("push-data"),
+        .Kind = TokenKind_PushData,
+    },
+    {
+        .Name = String_FromLiteral("timer-begin"),
+        .Kind = TokenKind_TimerBegin,
+    },
+    {
+        .Name = String_FromLiteral("timer-end"),
+        .Kind = TokenKind_TimerEnd,
+    },
 };
 
+ARRAY_IMPL(uint8_t, Byte);
+ARRAY_IMPL(uint32_t, UInt32);
+
+TokenBuffer TokenBuffer_Create(Allocator* allocator) {
+    return (TokenBuffer){
+        .Kinds   = ByteArray_CreateWithAllocator(allocator),
+        .Files   = UInt32Array_CreateWithAllocator(allocator),
+        .Offsets = UInt32Array_CreateWithAllocator(allocator),
+        .Lengths = UInt32Array_CreateWithAllocator(allocator),
+    };
+}
+
+void TokenBuffer_Destroy(TokenBuffer* buffer) {
+    ByteArray_Destroy(&buffer->Kinds);
+    UInt32Array_Destroy(&buffer->Files);
+    UInt32Array_Destroy(&buffer->Offsets);
+    UInt32Array_Destroy(&buffer->Lengths);
+}
+
+void TokenBuffer_Push(TokenBuffer* buffer, Token token) {
+    ByteArray_Push(&buffer->Kinds, (uint8_t)token.Kind);
+    UInt32Array_Push(&buffer->Files, token.File);
+    UInt32Array_Push(&buffer->Offsets, token.Offset);
+    UInt32Array_Push(&buffer->Lengths, token.Length);
+}
+
+void TokenBuffer_Append(TokenBuffer* buffer, TokenBuffer* other) {
+    ByteArray_Append(&buffer->Kinds, other->Kinds.Data, other->Kinds.Length);
+    UInt32Array_Append(&buffer->Files, other->Files.Data, other->Files.Length);
+    UInt32Array_Append(&buffer->Offsets, other->Offsets.Data, other->Offsets.Length);
+    UInt32Array_Append(&buffer->Lengths, other->Lengths.Data, other->Lengths.Length);
+}
+
+Token TokenBuffer_Get(TokenBuffer* buffer, uint64_t index) {
+    return (Token){
+        .Kind   = (TokenKind)buffer->Kinds.Data[index],
+        .File   = buffer->Files.Data[index],
+        .Offset = buffer->Offsets.Data[index],
+        .Length = buffer->Lengths.Data[index],
+    };
+}
+
+// Every source a lexer is using, tokens refer to them by index
+typedef struct SourceFile {
+    String FilePath;
+    String Source;
+    uint64_t FirstLine;
+    uint64_t FirstColumn;
+    // The offset where every line starts, built the first time a location is asked for
+    uint32_t* LineStarts;
+    uint64_t LineCount;
+    // The next free slot when this one is free
+    int64_t NextFree;
+    bool InUse;
+} SourceFile;
+
+// The table grows by whole chunks that never move, so tokens can read their source without taking the lock
+#define SOURCE_FILE_CHUNK_SIZE 1024
+#define SOURCE_FILE_MAX_CHUNKS 4096
+
+static SourceFile* SourceFileChunks[SOURCE_FILE_MAX_CHUNKS] = {};
+static uint64_t SourceFileCount                             = 0;
+static int64_t FirstFreeSourceFile                          = -1;
+// Taken to register and unregister sources and to build their line tables, lexers are created on many threads
+static SRWLOCK SourceFileLock = SRWLOCK_INIT;
+
+static SourceFile* SourceFile_Get(uint32_t index) {
+    return &SourceFileChunks[index / SOURCE_FILE_CHUNK_SIZE][index % SOURCE_FILE_CHUNK_SIZE];
+}
+
+// Returns false when the table could not grow, the error is reported
+static bool SourceFile_Register(String filepath, String source, uint64_t line, uint64_t column, uint32_t* index) {
+    AcquireSRWLockExclusive(&SourceFileLock);
+    if (FirstFreeSourceFile >= 0) {
+        *index              = (uint32_t)FirstFreeSourceFile;
+        FirstFreeSourceFile = SourceFile_Get(*index)->NextFree;
+    } else {
+        uint64_t chunk = SourceFileCount / SOURCE_FILE_CHUNK_SIZE;
+        if (chunk >= SOURCE_FILE_MAX_CHUNKS) {
+            ReleaseSRWLockExclusive(&SourceFileLock);
+            fflush(stdout);
+            fprintf(stderr, "Too many sources are open at once for '%.*s'\n", String_Fmt(filepath));
+            return false;
+        }
+        if (!SourceFileChunks[chunk]) {
+            SourceFileChunks[chunk] = malloc(SOURCE_FILE_CHUNK_SIZE * sizeof(SourceFile));
+            if (!SourceFileChunks[chunk]) {
+                ReleaseSRWLockExclusive(&SourceFileLock);
+                fflush(stdout);
+                fprintf(stderr, "Failed to allocate the source table for '%.*s'\n", String_Fmt(filepath));
+                return false;
+            }
+        }
+        *index = (uint32_t)SourceFileCount++;
+    }
+
+    *SourceFile_Get(*index) = (SourceFile){
+        .FilePath    = filepath,
+        .Source      = source,
+        .FirstLine   = line,
+        .FirstColumn = column,
+        .NextFree    = -1,
+        .InUse       = true,
+    };
+    ReleaseSRWLockExclusive(&SourceFileLock);
+    return true;
+}
+
+static void SourceFile_Unregister(uint32_t index) {
+    AcquireSRWLockExclusive(&SourceFileLock);
+    SourceFile* file = SourceFile_Get(index);
+    free(file->LineStarts);
+    *file = (SourceFile){
+        .NextFree = FirstFreeSourceFile,
+        .InUse    = false,
+    };
+    FirstFreeSourceFile = index;
+    ReleaseSRWLockExclusive(&SourceFileLock);
+}
+
+static SourceLocation SourceFile_GetLocation(uint32_t index, uint64_t offset) {
+    AcquireSRWLockExclusive(&SourceFileLock);
+    SourceFile* file = SourceFile_Get(index);
+    if (!file->LineStarts) {
+        uint64_t lineCount = 1;
+        for (uint64_t i = 0; i < file->Source.Length; i++) {
+            lineCount += file->Source.Data[i] == '\n';
+        }
+
+        file->LineStarts = malloc(lineCount * sizeof(uint32_t));
+        if (!file->LineStarts) {
+            // Still points at the right file and offset, just without lines
+            ReleaseSRWLockExclusive(&SourceFileLock);
+            return (SourceLocation){
+                .FilePath = file->FilePath,
+                .Line     = file->FirstLine,
+                .Column   = file->FirstColumn + offset,
+            };
+        }
+
+        file->LineCount                     = 0;
+        file->LineStarts[file->LineCount++] = 0;
+        for (uint64_t i = 0; i < file->Source.Length; i++) {
+            if (file->Source.Data[i] == '\n') {
+                file->LineStarts[file->LineCount++] = (uint32_t)(i + 1);
+            }
+        }
+    }
+
+    // The last line that starts at or before the offset
+    uint64_t low  = 0;
+    uint64_t high = file->LineCount;
+    while (high - low > 1) {
+        uint64_t middle = low + (high - low) / 2;
+        if (file->LineStarts[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    SourceLocation location = (SourceLocation){
+        .FilePath = file->FilePath,
+        .Line     = file->FirstLine + low,
+        .Column   = (low == 0 ? file->FirstColumn : 1) + offset - file->LineStarts[low],
+    };
+    ReleaseSRWLockExclusive(&SourceFileLock);
+    return location;
+}
+
+String Token_GetString(Token token) {
+    return (String){
+        .Data   = &SourceFile_Get(token.File)->Source.Data[token.Offset],
+        .Length = token.Length,
+    };
+}
+
+uint64_t Token_GetInt(Token token) {
+    String text    = Token_GetString(token);
+    uint64_t value = 0;
+    for (uint64_t i = 0; i < text.Length; i++) {
+        if (text.Data[i] == '_') {
+            continue;
+        }
+        if (text.Data[i] < '0' || text.Data[i] > '9') {
+            break;
+        }
+        value *= 10;
+        value += text.Data[i] - '0';
+    }
+    return value;
+}
+
+bool Token_GetFloat(Token token, double* value) {
+    // The digits are collected without the '_' separators so strtod gets correct rounding
+    String text = Token_GetString(token);
+    char smallBuffer[128];
+    char* buffer = text.Length < sizeof(smallBuffer) ? smallBuffer : malloc(text.Length + 1);
+    if (!buffer) {
+        return false;
+    }
+
+    uint64_t length = 0;
+    for (uint64_t i = 0; i < text.Length; i++) {
+        if (text.Data[i] != '_') {
+            buffer[length++] = (char)text.Data[i];
+        }
+    }
+    buffer[length] = '\0';
+
+    // The lexer takes any run of digits, '.', 'e' and signs, so text like 1.2.3 or 1.5e only shows up here
+    char* end   = NULL;
+    *value      = strtod(buffer, &end);
+    bool isFull = length > 0 && end == &buffer[length];
+    if (buffer != smallBuffer) {
+        free(buffer);
+    }
+    return isFull;
+}
+
+SourceLocation Token_GetLocation(Token token) {
+    return SourceFile_GetLocation(token.File, token.Offset);
+}
+
 bool Lexer_Create(Lexer* lexer, String filepath) {
     *lexer = (Lexer){};
 
@@ -169,12 +787,14 @@ bool Lexer_Create(Lexer* lexer, String filepath) {
     memcpy(path, filepath.Data, filepath.Length);
     path[filepath.Length] = '\0';
 
+    String fullPath;
 #if defined(_WIN32)
     {
         uint64_t length = GetFullPathNameA(path, 0, NULL, NULL);
         if (length == 0) {
             fflush(stdout);
             fprintf(stderr, "Failed to get full path to file\n");
+            free(path);
             return false;
         }
 
@@ -182,16 +802,19 @@ bool Lexer_Create(Lexer* lexer, String filepath) {
         if (!buffer) {
             fflush(stdout);
             fprintf(stderr, "Failed to allocate file path\n");
+            free(path);
             return false;
         }
 
         if (GetFullPathNameA(path, length, buffer, NULL) == 0) {
             fflush(stdout);
             fprintf(stderr, "Failed to get full path to file\n");
+            free(buffer);
+            free(path);
             return false;
         }
 
-        lexer->FilePath = (String){
+        fullPath = (String){
             .Data   = (uint8_t*)buffer,
             .Length = length,
         };
@@ -201,80 +824,170 @@ bool Lexer_Create(Lexer* lexer, String filepath) {
 #endif
 
     FILE* file = fopen(path, "rb");
+    free(path);
     if (!file) {
         fflush(stdout);
-        fprintf(stderr, "Failed to open file '%.*s'\n", String_Fmt(lexer->FilePath));
+        fprintf(stderr, "Failed to open file '%.*s'\n", String_Fmt(fullPath));
+        free(fullPath.Data);
         return false;
     }
 
     fseek(file, 0, SEEK_END);
-    lexer->Source.Length = ftell(file);
+    uint64_t sourceLength = ftell(file);
     fseek(file, 0, SEEK_SET);
 
-    lexer->Source.Data = malloc(lexer->Source.Length);
-    if (!lexer->Source.Data) {
+    if (sourceLength > UINT32_MAX) {
+        fflush(stdout);
+        fprintf(stderr, "The file '%.*s' is too big, sources are limited to 4GB\n", String_Fmt(fullPath));
+        free(fullPath.Data);
+        fclose(file);
+        return false;
+    }
+
+    // The emitted code and everything else the emitter keeps is usually smaller than the source
+    lexer->Arena = Arena_Create(fullPath.Length + sourceLength * 2);
+    if (!lexer->Arena) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to create the arena for '%.*s'\n", String_Fmt(fullPath));
+        free(fullPath.Data);
+        fclose(file);
+        return false;
+    }
+
+    lexer->FilePath.Data   = Arena_Allocate(lexer->Arena, fullPath.Length);
+    lexer->FilePath.Length = fullPath.Length;
+    lexer->Source.Data     = Arena_Allocate(lexer->Arena, sourceLength);
+    lexer->Source.Length   = sourceLength;
+    if (lexer->FilePath.Data) {
+        memcpy(lexer->FilePath.Data, fullPath.Data, fullPath.Length);
+    }
+    free(fullPath.Data);
+
+    if (!lexer->FilePath.Data || !lexer->Source.Data) {
         fflush(stdout);
-        fprintf(stderr, "Failed allocate buffer for source '%.*s'\n", String_Fmt(lexer->FilePath));
+        fprintf(stderr, "Failed allocate buffer for source '%.*s'\n", String_Fmt(filepath));
+        fclose(file);
+        Lexer_Destroy(lexer);
         return false;
     }
 
     if (fread(lexer->Source.Data, 1, lexer->Source.Length, file) != lexer->Source.Length) {
         fflush(stdout);
         fprintf(stderr, "Failed to read file '%.*s'\n", String_Fmt(lexer->FilePath));
+        fclose(file);
+        Lexer_Destroy(lexer);
         return false;
     }
 
-    lexer->Position = 0;
-    lexer->Line     = 1;
-    lexer->Column   = 1;
-    lexer->Current  = lexer->Position < lexer->Source.Length ? lexer->Source.Data[lexer->Position] : '\0';
-
     fclose(file);
-    free(path);
+    if (!SourceFile_Register(lexer->FilePath, lexer->Source, 1, 1, &lexer->File)) {
+        Lexer_Destroy(lexer);
+        return false;
+    }
+    lexer->IsRegistered = true;
+    lexer->Position     = 0;
+    lexer->Current      = lexer->Position < lexer->Source.Length ? lexer->Source.Data[lexer->Position] : '\0';
+    return true;
+}
+
+bool Lexer_CreateFromSource(Lexer* lexer, String filepath, String source, uint64_t line, uint64_t column) {
+    *lexer = (Lexer){};
+
+    if (source.Length > UINT32_MAX) {
+        fflush(stdout);
+        fprintf(stderr, "The source of '%.*s' is too big, sources are limited to 4GB\n", String_Fmt(filepath));
+        return false;
+    }
+
+    lexer->Arena = Arena_Create(filepath.Length + source.Length * 2);
+    if (!lexer->Arena) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to create the arena for '%.*s'\n", String_Fmt(filepath));
+        return false;
+    }
+
+    lexer->FilePath.Data   = Arena_Allocate(lexer->Arena, filepath.Length);
+    lexer->FilePath.Length = filepath.Length;
+    lexer->Source.Data     = Arena_Allocate(lexer->Arena, source.Length);
+    lexer->Source.Length   = source.Length;
+    if (!lexer->FilePath.Data || !lexer->Source.Data) {
+        fflush(stdout);
+        fprintf(stderr, "Failed allocate buffer for source '%.*s'\n", String_Fmt(filepath));
+        Lexer_Destroy(lexer);
+        return false;
+    }
+
+    memcpy(lexer->FilePath.Data, filepath.Data, filepath.Length);
+    memcpy(lexer->Source.Data, source.Data, source.Length);
+
+    if (!SourceFile_Register(lexer->FilePath, lexer->Source, line, column, &lexer->File)) {
+        Lexer_Destroy(lexer);
+        return false;
+    }
+    lexer->IsRegistered = true;
+    lexer->Position     = 0;
+    lexer->Current      = lexer->Position < lexer->Source.Length ? lexer->Source.Data[lexer->Position] : '\0';
     return true;
 }
 
 void Lexer_Destroy(Lexer* lexer) {
-    free(lexer->FilePath.Data);
-    free(lexer->Source.Data);
+    if (lexer->IsRegistered) {
+        SourceFile_Unregister(lexer->File);
+    }
+    Arena_Destroy(lexer->Arena);
+    *lexer = (Lexer){};
+}
+
+static void Lexer_ReportUnexpectedCharacter(Lexer* lexer, uint64_t position, uint8_t chr) {
+    if (lexer->UnexpectedCharacters) {
+        UInt32Array_Push(lexer->UnexpectedCharacters, (uint32_t)position);
+        return;
+    }
+
+    SourceLocation location = SourceFile_GetLocation(lexer->File, position);
+    fflush(stdout);
+    fprintf(stderr,
+            "%.*s:%llu:%llu: Unexpected character '%c'\n",
+            String_Fmt(location.FilePath),
+            location.Line,
+            location.Column,
+            chr);
 }
 
 Token Lexer_NextToken(Lexer* lexer) {
 Start:
     uint64_t startPosition = lexer->Position;
-    uint64_t startLine     = lexer->Line;
-    uint64_t startColumn   = lexer->Column;
 
     if (lexer->Current == '\0') {
         return (Token){
-            .Kind     = TokenKind_EndOfFile,
-            .FilePath = lexer->FilePath,
-            .Source   = lexer->Source,
-            .Position = startPosition,
-            .Line     = startLine,
-            .Column   = startColumn,
-            .Length   = 0,
+            .Kind   = TokenKind_EndOfFile,
+            .File   = lexer->File,
+            .Offset = (uint32_t)startPosition,
+            .Length = 0,
         };
     } else if (lexer->Current >= '0' && lexer->Current <= '9') {
-        uint64_t base     = 10;
-        uint64_t intValue = 0;
         while ((lexer->Current >= '0' && lexer->Current <= '9') || lexer->Current == '_') {
-            if (lexer->Current == '_') {
+            Lexer_NextChar(lexer);
+        }
+        if (lexer->Current == '.') {
+            while ((lexer->Current >= '0' && lexer->Current <= '9') || lexer->Current == '_' || lexer->Current == '.' ||
+                   lexer->Current == 'e' || lexer->Current == 'E' ||
+                   ((lexer->Current == '-' || lexer->Current == '+') &&
+                    (lexer->Source.Data[lexer->Position - 1] == 'e' || lexer->Source.Data[lexer->Position - 1] == 'E'))) {
                 Lexer_NextChar(lexer);
-                continue;
             }
-            intValue *= base;
-            intValue += Lexer_NextChar(lexer) - '0';
+            return (Token){
+                .Kind   = TokenKind_Float,
+                .File   = lexer->File,
+                .Offset = (uint32_t)startPosition,
+                .Length = (uint32_t)(lexer->Position - startPosition),
+            };
         }
         return (Token){
-            .Kind     = TokenKind_Integer,
-            .FilePath = lexer->FilePath,
-            .Source   = lexer->Source,
-            .Position = startPosition,
-            .Line     = startLine,
-            .Column   = startColumn,
-            .Length   = lexer->Position - startPosition,
-            .IntValue = intValue,
+            .Kind   = TokenKind_Integer,
+            .File   = lexer->File,
+            .Offset = (uint32_t)startPosition,
+            .Length = (uint32_t)(lexer->Position - startPosition),
         };
     } else if ((lexer->Current >= 'A' && lexer->Current <= 'Z') || (lexer->Current >= 'a' && lexer->Current <= 'z') ||
                lexer->Current == '_') {
@@ -295,14 +1008,10 @@ Start:
             }
         }
         return (Token){
-            .Kind        = kind,
-            .FilePath    = lexer->FilePath,
-            .Source      = lexer->Source,
-            .Position    = startPosition,
-            .Line        = startLine,
-            .Column      = startColumn,
-            .Length      = name.Length,
-            .StringValue = name,
+            .Kind   = kind,
+            .File   = lexer->File,
+            .Offset = (uint32_t)startPosition,
+            .Length = (uint32_t)name.Length,
         };
     } else {
         switch (lexer->Current) {
@@ -317,52 +1026,59 @@ Start:
             case ':': {
                 Lexer_NextChar(lexer);
                 return (Token){
-                    .Kind     = TokenKind_Colon,
-                    .FilePath = lexer->FilePath,
-                    .Source   = lexer->Source,
-                    .Position = startPosition,
-                    .Line     = startLine,
-                    .Column   = startColumn,
-                    .Length   = 1,
+                    .Kind   = TokenKind_Colon,
+                    .File   = lexer->File,
+                    .Offset = (uint32_t)startPosition,
+                    .Length = 1,
                 };
             } break;
 
             case '!': {
                 Lexer_NextChar(lexer);
                 return (Token){
-                    .Kind     = TokenKind_Bang,
-                    .FilePath = lexer->FilePath,
-                    .Source   = lexer->Source,
-                    .Position = startPosition,
-                    .Line     = startLine,
-                    .Column   = startColumn,
-                    .Length   = 1,
+                    .Kind   = TokenKind_Bang,
+                    .File   = lexer->File,
+                    .Offset = (uint32_t)startPosition,
+                    .Length = 1,
                 };
             } break;
 
             case '(': {
                 Lexer_NextChar(lexer);
                 return (Token){
-                    .Kind     = TokenKind_OpenParenthesis,
-                    .FilePath = lexer->FilePath,
-                    .Source   = lexer->Source,
-                    .Position = startPosition,
-                    .Line     = startLine,
-                    .Column   = startColumn,
-                    .Length   = 1,
+                    .Kind   = TokenKind_OpenParenthesis,
+                    .File   = lexer->File,
+                    .Offset = (uint32_t)startPosition,
+                    .Length = 1,
                 };
             } break;
 
             case ')': {
                 Lexer_NextChar(lexer);
                 return (Token){
-                    .Kind     = TokenKind_CloseParenthesis,
-                    .FilePath = lexer->FilePath,
-                    .Source   = lexer->Source,
-                    .Position = startPosition,
-                    .Line     = startLine,
-                    .Column   = startColumn,
-                    .Length   = 1,
+                    .Kind   = TokenKind_CloseParenthesis,
+                    .File   = lexer->File,
+                    .Offset = (uint32_t)startPosition,
+                    .Length = 1,
+                };
+            } break;
+
+            case '"': {
+                uint8_t chr = lexer->Current;
+                Lexer_NextChar(lexer);
+                while (lexer->Current != '"' && lexer->Current != '\n' && lexer->Current != '\0') {
+                    Lexer_NextChar(lexer);
+                }
+                if (lexer->Current != '"') {
+                    Lexer_ReportUnexpectedCharacter(lexer, startPosition, chr);
+                    goto Start;
+                }
+                Lexer_NextChar(lexer);
+                return (Token){
+                    .Kind   = TokenKind_String,
+                    .File   = lexer->File,
+                    .Offset = (uint32_t)startPosition,
+                    .Length = (uint32_t)(lexer->Position - startPosition),
                 };
             } break;
 
@@ -370,13 +1086,7 @@ Start:
                 uint8_t chr = lexer->Current;
                 Lexer_NextChar(lexer);
                 if (lexer->Current != '/') {
-                    fflush(stdout);
-                    fprintf(stderr,
-                            "%.*s:%llu:%llu: Unexpected character '%c'\n",
-                            String_Fmt(lexer->FilePath),
-                            startLine,
-                            startColumn,
-                            chr);
+                    Lexer_ReportUnexpectedCharacter(lexer, startPosition, chr);
                     goto Start;
                 }
                 Lexer_NextChar(lexer);
@@ -389,13 +1099,7 @@ Start:
             default: {
                 uint8_t chr = lexer->Current;
                 Lexer_NextChar(lexer);
-                fflush(stdout);
-                fprintf(stderr,
-                        "%.*s:%llu:%llu: Unexpected character '%c'\n",
-                        String_Fmt(lexer->FilePath),
-                        startLine,
-                        startColumn,
-                        chr);
+                Lexer_ReportUnexpectedCharacter(lexer, startPosition, chr);
                 goto Start;
             } break;
         }
@@ -405,11 +1109,138 @@ Start:
 uint8_t Lexer_NextChar(Lexer* lexer) {
     uint8_t current = lexer->Current;
     lexer->Position++;
-    lexer->Column++;
-    if (current == '\n') {
-        lexer->Line++;
-        lexer->Column = 1;
-    }
     lexer->Current = lexer->Position < lexer->Source.Length ? lexer->Source.Data[lexer->Position] : '\0';
     return current;
 }
+
+// Chunks smaller than this are not worth starting a thread for
+#define LEXER_MIN_CHUNK_SIZE (1024 * 1024)
+
+typedef struct LexerChunk {
+    Lexer Lexer;
+    TokenBuffer Tokens;
+    UInt32Array UnexpectedCharacters;
+    bool IsLast;
+} LexerChunk;
+
+static void LexerChunk_Lex(LexerChunk* chunk) {
+    while (true) {
+        Token token = Lexer_NextToken(&chunk->Lexer);
+        if (token.Kind == TokenKind_EndOfFile && !chunk->IsLast) {
+            break;
+        }
+        TokenBuffer_Push(&chunk->Tokens, token);
+        if (token.Kind == TokenKind_EndOfFile) {
+            break;
+        }
+    }
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI LexerChunk_ThreadProc(LPVOID parameter) {
+    LexerChunk_Lex(parameter);
+    return 0;
+}
+#endif
+
+void Lexer_LexAll(Lexer* lexer, TokenBuffer* tokens, uint64_t threadCount) {
+    if (threadCount == 0) {
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        threadCount = info.dwNumberOfProcessors;
+#else
+    #error "Unsupported platform"
+#endif
+    }
+
+    uint64_t remaining  = lexer->Source.Length - lexer->Position;
+    uint64_t chunkCount = remaining / LEXER_MIN_CHUNK_SIZE;
+    if (chunkCount > threadCount) {
+        chunkCount = threadCount;
+    }
+    if (chunkCount == 0) {
+        chunkCount = 1;
+    }
+
+    // Without memory for the chunks the whole source is lexed as one chunk on this thread
+    LexerChunk single  = {};
+    LexerChunk* chunks = calloc(chunkCount, sizeof(LexerChunk));
+    if (!chunks) {
+        chunkCount = 1;
+        chunks     = &single;
+    }
+    uint64_t start = lexer->Position;
+    for (uint64_t i = 0; i < chunkCount; i++) {
+        // Tokens never span lines and comments end at the end of the line, so any newline is a safe place to split
+        uint64_t end = i == chunkCount - 1 ? lexer->Source.Length : lexer->Position + remaining * (i + 1) / chunkCount;
+        if (end < start) {
+            end = start;
+        }
+        while (end < lexer->Source.Length && lexer->Source.Data[end - 1] != '\n') {
+            end++;
+        }
+
+        // The chunk lexer sees the end of the chunk as the end of the source, the offsets stay relative to the whole source
+        LexerChunk* chunk                 = &chunks[i];
+        chunk->Lexer                      = *lexer;
+        chunk->Lexer.Source.Length        = end;
+        chunk->Lexer.Position             = start;
+        chunk->Lexer.Current              = start < end ? lexer->Source.Data[start] : '\0';
+        chunk->Lexer.UnexpectedCharacters = &chunk->UnexpectedCharacters;
+        chunk->Tokens                     = TokenBuffer_Create(NULL);
+        chunk->UnexpectedCharacters       = UInt32Array_Create();
+        chunk->IsLast                     = i == chunkCount - 1;
+        start                             = end;
+    }
+
+#if defined(_WIN32)
+    // Chunks without a thread, because it or the memory for the handles could not be created, are lexed on this thread
+    HANDLE* threads = calloc(chunkCount, sizeof(HANDLE));
+    for (uint64_t i = 1; i < chunkCount; i++) {
+        HANDLE thread = threads ? CreateThread(NULL, 0, LexerChunk_ThreadProc, &chunks[i], 0, NULL) : NULL;
+        if (threads) {
+            threads[i] = thread;
+        }
+        if (!thread) {
+            LexerChunk_Lex(&chunks[i]);
+        }
+    }
+    LexerChunk_Lex(&chunks[0]);
+    for (uint64_t i = 1; i < chunkCount; i++) {
+        if (threads && threads[i]) {
+            WaitForSingleObject(threads[i], INFINITE);
+            CloseHandle(threads[i]);
+        }
+    }
+    free(threads);
+#else
+    #error "Unsupported platform"
+#endif
+
+    uint64_t tokenCount = 0;
+    for (uint64_t i = 0; i < chunkCount; i++) {
+        tokenCount += chunks[i].Tokens.Kinds.Length;
+    }
+    ByteArray_Reserve(&tokens->Kinds, tokens->Kinds.Length + tokenCount);
+    UInt32Array_Reserve(&tokens->Files, tokens->Files.Length + tokenCount);
+    UInt32Array_Reserve(&tokens->Offsets, tokens->Offsets.Length + tokenCount);
+    UInt32Array_Reserve(&tokens->Lengths, tokens->Lengths.Length + tokenCount);
+
+    // Errors are reported after the threads are done, so they come out in order
+    for (uint64_t i = 0; i < chunkCount; i++) {
+        TokenBuffer_Append(tokens, &chunks[i].Tokens);
+        for (uint64_t j = 0; j < chunks[i].UnexpectedCharacters.Length; j++) {
+            uint64_t position = chunks[i].UnexpectedCharacters.Data[j];
+            Lexer_ReportUnexpectedCharacter(lexer, position, lexer->Source.Data[position]);
+        }
+        TokenBuffer_Destroy(&chunks[i].Tokens);
+        UInt32Array_Destroy(&chunks[i].UnexpectedCharacters);
+    }
+    if (chunks != &single) {
+        free(chunks);
+    }
+
+    lexer->Position = lexer->Source.Length;
+    lexer->Current  = '\0';
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Strings.h"
+#include "Arena.h"
 
 #include <stdint.h>
 #include <stdbool.h>
@@ -13,8 +14,14 @@ typedef enum TokenKind {
     TokenKind_OpenParenthesis,
     TokenKind_CloseParenthesis,
     TokenKind_Integer,
+    TokenKind_Float,
+    // Text between double quotes on one line, the token includes the quotes
+    TokenKind_String,
     TokenKind_Name,
     TokenKind_Macro,
+    TokenKind_Import,
+    TokenKind_Extern,
+    TokenKind_Data,
     TokenKind_Exit,
     TokenKind_Push,
     TokenKind_Pop,
@@ -34,34 +41,137 @@ typedef enum TokenKind {
     TokenKind_Call,
     TokenKind_Ret,
     TokenKind_CallCFunc,
+    TokenKind_CallExtern,
+    TokenKind_MemCopy,
+    TokenKind_MemMove,
+    TokenKind_MemSet,
+    TokenKind_VecAdd,
+    TokenKind_VecSub,
+    TokenKind_VecMin,
+    TokenKind_VecMax,
+    TokenKind_VecEqual,
+    TokenKind_VecLess,
+    TokenKind_VecAddBuffer,
+    TokenKind_VecSubBuffer,
+    TokenKind_VecMinBuffer,
+    TokenKind_VecMaxBuffer,
+    TokenKind_VecEqualBuffer,
+    TokenKind_VecLessBuffer,
+    TokenKind_Mul,
+    TokenKind_DivSigned,
+    TokenKind_DivUnsigned,
+    TokenKind_ModSigned,
+    TokenKind_ModUnsigned,
+    TokenKind_And,
+    TokenKind_Or,
+    TokenKind_Xor,
+    TokenKind_Not,
+    TokenKind_ShiftLeft,
+    TokenKind_ShiftRight,
+    TokenKind_ShiftRightArith,
+    TokenKind_Equal,
+    TokenKind_LessSigned,
+    TokenKind_LessUnsigned,
+    TokenKind_LessEqualSigned,
+    TokenKind_LessEqualUnsigned,
+    TokenKind_JumpEqual,
+    TokenKind_JumpNotEqual,
+    TokenKind_JumpLessSigned,
+    TokenKind_JumpLessUnsigned,
+    TokenKind_JumpLessEqualSigned,
+    TokenKind_JumpLessEqualUnsigned,
+    TokenKind_FloatAdd,
+    TokenKind_FloatSub,
+    TokenKind_FloatMul,
+    TokenKind_FloatDiv,
+    TokenKind_FloatEqual,
+    TokenKind_FloatLess,
+    TokenKind_FloatLessEqual,
+    TokenKind_FloatSqrt,
+    TokenKind_IntToFloat,
+    TokenKind_FloatToInt,
+    TokenKind_PrintFloat,
+    TokenKind_HeapAlloc,
+    TokenKind_HeapFree,
+    TokenKind_HeapReset,
+    TokenKind_JumpTable,
+    TokenKind_Checkpoint,
+    TokenKind_IoOpen,
+    TokenKind_IoRead,
+    TokenKind_IoWrite,
+    TokenKind_IoClose,
+    TokenKind_PushData,
+    TokenKind_TimerBegin,
+    TokenKind_TimerEnd,
 } TokenKind;
 
 String GetTokenKindName(TokenKind kind);
 
+// Tokens only point into the source, their text, value and location are derived when they are needed
 typedef struct Token {
     TokenKind Kind;
+    // Index into the table of sources that lexers register
+    uint32_t File;
+    uint32_t Offset;
+    uint32_t Length;
+} Token;
+
+_Static_assert(sizeof(Token) == 16, "Tokens should stay small");
+
+ARRAY_DECL(uint8_t, Byte);
+ARRAY_DECL(uint32_t, UInt32);
+
+// Stores tokens as separate arrays for each field, so a stored token takes 13 bytes
+typedef struct TokenBuffer {
+    ByteArray Kinds;
+    UInt32Array Files;
+    UInt32Array Offsets;
+    UInt32Array Lengths;
+} TokenBuffer;
+
+TokenBuffer TokenBuffer_Create(Allocator* allocator);
+void TokenBuffer_Destroy(TokenBuffer* buffer);
+void TokenBuffer_Push(TokenBuffer* buffer, Token token);
+// Copies all of the tokens of other to the end of the buffer
+void TokenBuffer_Append(TokenBuffer* buffer, TokenBuffer* other);
+Token TokenBuffer_Get(TokenBuffer* buffer, uint64_t index);
+
+typedef struct SourceLocation {
     String FilePath;
-    String Source;
-    uint64_t Position;
     uint64_t Line;
     uint64_t Column;
-    uint64_t Length;
-    union {
-        String StringValue;
-        uint64_t IntValue;
-    };
-} Token;
+} SourceLocation;
+
+String Token_GetString(Token token);
+uint64_t Token_GetInt(Token token);
+// Returns false when the text of the token is not a whole float literal
+bool Token_GetFloat(Token token, double* value);
+// The line table of the source is built the first time a location is asked for
+SourceLocation Token_GetLocation(Token token);
 
 typedef struct Lexer {
+    // Holds the source and everything that lives as long as it, destroying the lexer frees all of it at once
+    Arena* Arena;
+    uint32_t File;
+    // Set once the source is in the global table of sources, so destroying a half created lexer leaves the table alone
+    bool IsRegistered;
     String FilePath;
     String Source;
     uint64_t Position;
-    uint64_t Line;
-    uint64_t Column;
     uint8_t Current;
+    // When set, the offsets of unexpected characters are collected here instead of being reported
+    UInt32Array* UnexpectedCharacters;
 } Lexer;
 
+// The source is registered in a global table that is locked, so lexers can be created and destroyed on any thread
+// Tokens read their source from the table, they must not outlive the lexer that made them
 bool Lexer_Create(Lexer* lexer, String filepath);
+// Lexes source that is already in memory, filepath is only used for error messages, both are copied
+// The line and column are where the source starts in the file
+bool Lexer_CreateFromSource(Lexer* lexer, String filepath, String source, uint64_t line, uint64_t column);
 void Lexer_Destroy(Lexer* lexer);
 Token Lexer_NextToken(Lexer* lexer);
+// Lexes the rest of the source at once, the tokens end with the end of file token
+// Large sources are split at newlines into chunks that are lexed in parallel, a thread count of 0 uses every processor
+void Lexer_LexAll(Lexer* lexer, TokenBuffer* tokens, uint64_t threadCount);
 uint8_t Lexer_NextChar(Lexer* lexer);
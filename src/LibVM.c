@@ -0,0 +1,309 @@
+#include "LibVM.h"
+#include "Lexer.h"
+#include "Emitter.h"
+#include "Optimizer.h"
+#include "VM.h"
+#include "Snapshot.h"
+#include "StackAnalysis.h"
+#include "Io.h"
+#include "Binary.h"
+#include "Timer.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+#include <stddef.h>
+
+struct VMProgram {
+    uint8_t* Code;
+    uint64_t CodeSize;
+    bool IsStackBounded;
+    uint64_t StackSize;
+    // Holds the code of programs loaded from a binary file, the code of assembled programs follows the program
+    Binary Binary;
+};
+
+struct VMContext {
+    VM VM;
+};
+
+struct VMSnapshot {
+    Snapshot Snapshot;
+};
+
+struct VMIoQueue {
+    IoQueue Queue;
+};
+
+static bool VMContext_RunToExit(VMContext* context) {
+    VMResult result;
+    do {
+        result = VM_Run(&context->VM);
+    } while (result == VMResult_Checkpoint);
+    return result == VMResult_Exit;
+}
+
+static VMProgram* VMProgram_Assemble(Lexer lexer) {
+    Emitter emitter;
+    if (!Emitter_CreatePreLexed(&emitter, lexer, 0)) {
+        Lexer_Destroy(&lexer);
+        return NULL;
+    }
+
+    Emitter_Emit(&emitter);
+    if (emitter.WasError) {
+        Emitter_Destroy(&emitter);
+        return NULL;
+    }
+
+    Optimizer_Optimize(&emitter);
+
+    // The code of the emitter is freed along with its arena
+    VMProgram* program = malloc(sizeof(VMProgram) + emitter.Code.Length);
+    if (!program) {
+        Emitter_Destroy(&emitter);
+        return NULL;
+    }
+
+    StackAnalysis analysis;
+    StackAnalysis_Analyze(&analysis, &emitter);
+    program->Binary         = (Binary){};
+    program->IsStackBounded = analysis.IsBounded;
+    program->StackSize      = analysis.IsBounded ? analysis.MaxDepth : VM_DEFAULT_STACK_SIZE;
+    StackAnalysis_Destroy(&analysis);
+
+    program->Code     = (uint8_t*)(program + 1);
+    program->CodeSize = emitter.Code.Length;
+    memcpy(program->Code, emitter.Code.Data, emitter.Code.Length);
+    Emitter_Destroy(&emitter);
+    return program;
+}
+
+VMProgram* VMProgram_AssembleFile(const char* path) {
+    Lexer lexer;
+    if (!Lexer_Create(&lexer, String_FromCString(path))) {
+        return NULL;
+    }
+    return VMProgram_Assemble(lexer);
+}
+
+VMProgram* VMProgram_AssembleSource(const char* name, const char* source, uint64_t length) {
+    Lexer lexer;
+    if (!Lexer_CreateFromSource(&lexer,
+                                String_FromCString(name),
+                                (String){
+                                    .Data   = (uint8_t*)source,
+                                    .Length = length,
+                                },
+                                1,
+                                1)) {
+        return NULL;
+    }
+    return VMProgram_Assemble(lexer);
+}
+
+bool VMProgram_GetStackSize(VMProgram* program, uint64_t* stackSize) {
+    *stackSize = program->StackSize;
+    return program->IsStackBounded;
+}
+
+bool VMProgram_BindExterns(VMProgram* program, VMHostFunctionResolver resolver, void* userData) {
+    return VM_BindExterns(program->Code, program->CodeSize, resolver, userData);
+}
+
+VMProgram* VMProgram_LoadBinary(const char* path) {
+    VMProgram* program = malloc(sizeof(VMProgram));
+    if (!program) {
+        return NULL;
+    }
+
+    if (!Binary_Map(&program->Binary, path)) {
+        free(program);
+        return NULL;
+    }
+    program->Code           = program->Binary.Code;
+    program->CodeSize       = program->Binary.Header.CodeSize;
+    program->IsStackBounded = program->Binary.Header.IsStackBounded;
+    program->StackSize      = program->Binary.Header.StackSize;
+    return program;
+}
+
+bool VMProgram_SaveBinary(VMProgram* program, const char* path) {
+    return Binary_Write(path, program->Code, program->CodeSize, program->IsStackBounded, program->StackSize);
+}
+
+void VMProgram_Destroy(VMProgram* program) {
+    if (!program) {
+        return;
+    }
+    if (program->Binary.View) {
+        Binary_Unmap(&program->Binary);
+    }
+    free(program);
+}
+
+VMContext* VMContext_Create(uint64_t stackSize) {
+    VMContext* context = malloc(sizeof(VMContext));
+    if (!context) {
+        return NULL;
+    }
+
+    if (!VM_Create(&context->VM, stackSize == 0 ? VM_DEFAULT_STACK_SIZE : stackSize)) {
+        free(context);
+        return NULL;
+    }
+    return context;
+}
+
+void VMContext_Destroy(VMContext* context) {
+    if (!context) {
+        return;
+    }
+    VM_Destroy(&context->VM);
+    free(context);
+}
+
+bool VMContext_Run(VMContext* context, VMProgram* program) {
+    VM_Load(&context->VM, program->Code, program->CodeSize);
+    return VMContext_RunToExit(context);
+}
+
+void VMContext_Start(VMContext* context, VMProgram* program) {
+    VM_Load(&context->VM, program->Code, program->CodeSize);
+}
+
+VMRunResult VMContext_RunSlice(VMContext* context, uint64_t fuel) {
+    context->VM.Fuel = fuel;
+    VMResult result;
+    do {
+        result = VM_Run(&context->VM);
+    } while (result == VMResult_Checkpoint);
+    // Full runs always start with unlimited fuel again
+    context->VM.Fuel = VM_UNLIMITED_FUEL;
+
+    switch (result) {
+        case VMResult_Exit:
+            return VMRunResult_Exit;
+        case VMResult_Yielded:
+            return VMRunResult_Yielded;
+        case VMResult_Waiting:
+            return VMRunResult_Waiting;
+        default:
+            return VMRunResult_Error;
+    }
+}
+
+HeapStats VMContext_GetHeapStats(VMContext* context) {
+    return Heap_GetStats(&context->VM.Heap);
+}
+
+bool VMContext_GetTimerStats(VMContext* context, uint64_t id, VMTimerStats* stats) {
+    if (id >= VM_TIMER_COUNT || context->VM.Timers[id].Count == 0) {
+        return false;
+    }
+    VMTimer* timer            = &context->VM.Timers[id];
+    stats->Count              = timer->Count;
+    stats->MinNanoseconds     = Timer_TicksToNanoseconds(timer->MinTicks);
+    stats->AverageNanoseconds = Timer_TicksToNanoseconds(timer->TotalTicks) / (double)timer->Count;
+    stats->MaxNanoseconds     = Timer_TicksToNanoseconds(timer->MaxTicks);
+    return true;
+}
+
+VMIoQueue* VMIoQueue_Create(void) {
+    VMIoQueue* queue = malloc(sizeof(VMIoQueue));
+    if (!queue) {
+        return NULL;
+    }
+
+    if (!IoQueue_Create(&queue->Queue)) {
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+void VMIoQueue_Destroy(VMIoQueue* queue) {
+    if (!queue) {
+        return;
+    }
+    IoQueue_Destroy(&queue->Queue);
+    free(queue);
+}
+
+void VMContext_SetIoQueue(VMContext* context, VMIoQueue* queue) {
+    context->VM.Io = queue ? &queue->Queue : NULL;
+}
+
+bool VMIoQueue_AddHandle(VMIoQueue* queue, uint64_t handle) {
+    return IoQueue_AddHandle(&queue->Queue, handle);
+}
+
+VMContext* VMIoQueue_Wait(VMIoQueue* queue) {
+    VM* vm = IoQueue_Wait(&queue->Queue);
+    if (!vm) {
+        return NULL;
+    }
+    // Every VM with a queue belongs to a context
+    return (VMContext*)((uint8_t*)vm - offsetof(VMContext, VM));
+}
+
+VMSnapshot* VMSnapshot_Create(VMProgram* program, uint64_t stackSize) {
+    VMSnapshot* snapshot = malloc(sizeof(VMSnapshot));
+    if (!snapshot) {
+        return NULL;
+    }
+
+    VM vm;
+    if (!VM_Create(&vm, stackSize == 0 ? VM_DEFAULT_STACK_SIZE : stackSize)) {
+        free(snapshot);
+        return NULL;
+    }
+
+    VM_Load(&vm, program->Code, program->CodeSize);
+    VMResult result = VM_Run(&vm);
+    if (result != VMResult_Checkpoint) {
+        if (result == VMResult_Exit) {
+            fflush(stdout);
+            fprintf(stderr, "The program exited before reaching a checkpoint\n");
+        }
+        VM_Destroy(&vm);
+        free(snapshot);
+        return NULL;
+    }
+
+    bool created = Snapshot_Create(&snapshot->Snapshot, &vm);
+    VM_Destroy(&vm);
+    if (!created) {
+        free(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+void VMSnapshot_Destroy(VMSnapshot* snapshot) {
+    if (!snapshot) {
+        return;
+    }
+    Snapshot_Destroy(&snapshot->Snapshot);
+    free(snapshot);
+}
+
+VMContext* VMContext_CreateFromSnapshot(VMSnapshot* snapshot) {
+    VMContext* context = malloc(sizeof(VMContext));
+    if (!context) {
+        return NULL;
+    }
+
+    if (!Snapshot_Clone(&snapshot->Snapshot, &context->VM)) {
+        free(context);
+        return NULL;
+    }
+    return context;
+}
+
+bool VMContext_RunFromSnapshot(VMContext* context, VMSnapshot* snapshot) {
+    if (!Snapshot_Restore(&snapshot->Snapshot, &context->VM)) {
+        return false;
+    }
+    return VMContext_RunToExit(context);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Heap.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Embedding API for hosts that link against the VM library
+// Programs are assembled once and can then be run any number of times in any context
+
+typedef struct VMProgram VMProgram;
+typedef struct VMContext VMContext;
+typedef struct VMSnapshot VMSnapshot;
+typedef struct VMIoQueue VMIoQueue;
+
+typedef enum VMRunResult {
+    VMRunResult_Error,
+    VMRunResult_Exit,
+    // The slice ran out of fuel, the context keeps its state and the next slice continues where it stopped
+    VMRunResult_Yielded,
+    // Started a read or write on the I/O queue of the context, VMIoQueue_Wait hands the context back once it is done
+    VMRunResult_Waiting,
+} VMRunResult;
+
+// Errors are reported on stderr and NULL is returned
+VMProgram* VMProgram_AssembleFile(const char* path);
+// name is only used for error messages
+VMProgram* VMProgram_AssembleSource(const char* name, const char* source, uint64_t length);
+// Maps a file written by VMProgram_SaveBinary or --compile, the code and its data are not copied
+VMProgram* VMProgram_LoadBinary(const char* path);
+// Externs are written unbound, so the program has to be bound again after it is loaded
+bool VMProgram_SaveBinary(VMProgram* program, const char* path);
+// The stack size the program needs, found by analyzing the code when it was assembled
+// Returns false when the analysis could not bound it, the stack size is then the default
+bool VMProgram_GetStackSize(VMProgram* program, uint64_t* stackSize);
+// Returns the host function for an extern the program declares, or NULL to look for it in the modules loaded into the process
+typedef void* (*VMHostFunctionResolver)(void* userData, const char* name);
+// Looks up every extern once, the program must be bound before it runs if it declares any
+// Binding again replaces the functions, contexts that are running the program must not be resumed in between
+// Returns false and reports the externs that could not be found
+bool VMProgram_BindExterns(VMProgram* program, VMHostFunctionResolver resolver, void* userData);
+void VMProgram_Destroy(VMProgram* program);
+
+// A stack size of 0 uses the default stack size
+VMContext* VMContext_Create(uint64_t stackSize);
+void VMContext_Destroy(VMContext* context);
+// Resets the context and runs the program until it exits, only the part of the stack the last run used is cleared
+// Checkpoints are ignored
+bool VMContext_Run(VMContext* context, VMProgram* program);
+// Resets the context and points it at the program without running it, the program then runs in slices
+void VMContext_Start(VMContext* context, VMProgram* program);
+// Runs the started program for at most fuel calls, rets and backward jumps, so a host can interleave many contexts on one thread
+// Checkpoints are ignored
+VMRunResult VMContext_RunSlice(VMContext* context, uint64_t fuel);
+HeapStats VMContext_GetHeapStats(VMContext* context);
+
+// The stats of a timing region of the last run, see timer-begin and timer-end
+typedef struct VMTimerStats {
+    uint64_t Count;
+    double MinNanoseconds;
+    double AverageNanoseconds;
+    double MaxNanoseconds;
+} VMTimerStats;
+
+// Returns false when the id is out of range or the region never ended since the context was last reset
+bool VMContext_GetTimerStats(VMContext* context, uint64_t id, VMTimerStats* stats);
+
+// Lets one thread drive many contexts that do I/O, instead of every io-read and io-write blocking the thread
+// Contexts with a queue must be run with VMContext_RunSlice, VMContext_Run fails when the program has to wait
+VMIoQueue* VMIoQueue_Create(void);
+// The contexts that use the queue must not be waiting anymore
+void VMIoQueue_Destroy(VMIoQueue* queue);
+// A NULL queue makes the I/O of the context block again, only handles the program opens afterwards use the new queue
+void VMContext_SetIoQueue(VMContext* context, VMIoQueue* queue);
+// For handles the host passes to programs, like sockets, they must be opened for overlapped I/O
+bool VMIoQueue_AddHandle(VMIoQueue* queue, uint64_t handle);
+// Blocks until the I/O of one of the waiting contexts completes and returns it, its next slice continues after the I/O
+// Returns NULL when no context is waiting
+VMContext* VMIoQueue_Wait(VMIoQueue* queue);
+
+// Runs the program up to its first checkpoint op and saves the stack, so later runs can skip the initialization before it
+// The program must outlive the snapshot, and the stack must not hold pointers into the stack or heap at the checkpoint
+VMSnapshot* VMSnapshot_Create(VMProgram* program, uint64_t stackSize);
+// Contexts created from the snapshot must be destroyed first
+void VMSnapshot_Destroy(VMSnapshot* snapshot);
+// The stack of the context is a copy-on-write view of the snapshot
+VMContext* VMContext_CreateFromSnapshot(VMSnapshot* snapshot);
+// Puts the context back into the saved state and runs the rest of the program until it exits
+bool VMContext_RunFromSnapshot(VMContext* context, VMSnapshot* snapshot);
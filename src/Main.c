@@ -1,26 +1,189 @@
 #include "VM.h"
 #include "Lexer.h"
 #include "Emitter.h"
+#include "Optimizer.h"
+#include "Assembler.h"
+#include "StackAnalysis.h"
+#include "Binary.h"
+#include "Translator.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
 
+#if defined(_WIN32)
+    #include <Windows.h>
+#else
+    #error Unsupported platform
+#endif
+
+static bool GetFileWriteTime(const char* path, uint64_t* writeTime) {
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)) {
+        return false;
+    }
+    *writeTime = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    return true;
+#else
+    #error Unsupported platform
+#endif
+}
+
+static volatile bool IsWatchStopped = false;
+
+#if defined(_WIN32)
+static BOOL WINAPI StopWatch(DWORD event) {
+    if (event != CTRL_C_EVENT && event != CTRL_BREAK_EVENT) {
+        return FALSE;
+    }
+    IsWatchStopped = true;
+    return TRUE;
+}
+#endif
+
+// Assembles and runs the file every time it is saved, only the sections that changed are emitted again.
+// Stops on Ctrl+C or once the file is deleted
+static int Watch(const char* path) {
+    Assembler assembler;
+    if (!Assembler_Create(&assembler, String_FromCString(path))) {
+        return EXIT_FAILURE;
+    }
+
+    VM vm;
+    if (!VM_Create(&vm, VM_DEFAULT_STACK_SIZE)) {
+        Assembler_Destroy(&assembler);
+        return EXIT_FAILURE;
+    }
+
+#if defined(_WIN32)
+    SetConsoleCtrlHandler(StopWatch, TRUE);
+#else
+    #error Unsupported platform
+#endif
+
+    uint64_t lastWriteTime = 0;
+    while (!IsWatchStopped) {
+        uint64_t writeTime;
+        if (!GetFileWriteTime(path, &writeTime)) {
+            // The file existed before, so it was deleted rather than not created yet
+            if (lastWriteTime != 0) {
+                break;
+            }
+            Sleep(100);
+            continue;
+        }
+        if (writeTime == lastWriteTime) {
+            Sleep(100);
+            continue;
+        }
+        lastWriteTime = writeTime;
+
+        if (!Assembler_Update(&assembler)) {
+            continue;
+        }
+
+        printf("Assembled '%s', emitted %llu sections and reused %llu\n",
+               path,
+               assembler.EmittedSectionCount,
+               assembler.ReusedSectionCount);
+
+        if (!VM_BindExterns(assembler.Code.Data, assembler.Code.Length, NULL, NULL)) {
+            continue;
+        }
+
+        VM_Load(&vm, assembler.Code.Data, assembler.Code.Length);
+        VMResult result;
+        do {
+            result = VM_Run(&vm);
+        } while (result == VMResult_Checkpoint);
+        if (result == VMResult_Exit) {
+            VM_PrintTimers(&vm);
+        }
+    }
+
+#if defined(_WIN32)
+    SetConsoleCtrlHandler(StopWatch, FALSE);
+#else
+    #error Unsupported platform
+#endif
+
+    VM_Destroy(&vm);
+    Assembler_Destroy(&assembler);
+    return EXIT_SUCCESS;
+}
+
+static int Run(uint8_t* code, uint64_t codeSize, uint64_t stackSize) {
+    if (!VM_BindExterns(code, codeSize, NULL, NULL)) {
+        return EXIT_FAILURE;
+    }
+
+    VM vm;
+    if (!VM_Create(&vm, stackSize)) {
+        return EXIT_FAILURE;
+    }
+
+    VM_Load(&vm, code, codeSize);
+
+    VMResult result;
+    do {
+        result = VM_Run(&vm);
+    } while (result == VMResult_Checkpoint);
+
+    if (result == VMResult_Error) {
+        VM_Destroy(&vm);
+        return EXIT_FAILURE;
+    }
+
+    VM_PrintTimers(&vm);
+    VM_Destroy(&vm);
+    return EXIT_SUCCESS;
+}
+
+static bool IsBinaryPath(const char* path) {
+    uint64_t length = strlen(path);
+    return length >= 4 && strcmp(path + length - 4, ".vmb") == 0;
+}
+
 int main(int argc, char** argv) {
-    if (argc != 2) {
+    if (argc == 3 && strcmp(argv[1], "--watch") == 0) {
+        return Watch(argv[2]);
+    }
+
+    // Prints how much stack every function needs instead of running the program
+    bool stackInfo = argc == 3 && strcmp(argv[1], "--stack-info") == 0;
+    // Writes the optimized code to a binary file that runs without assembling it again
+    bool compile = argc == 4 && strcmp(argv[1], "--compile") == 0;
+    // Writes the optimized code as C, so a C compiler can build the program into a native executable
+    bool translate = argc == 4 && strcmp(argv[1], "--to-c") == 0;
+    if (argc != 2 && !stackInfo && !compile && !translate) {
         fflush(stdout);
-        fprintf(stderr, "Usage: %s <file>", argv[0]);
+        fprintf(stderr, "Usage: %s [--watch | --stack-info] <file> | [--compile | --to-c] <file> <output>", argv[0]);
         return EXIT_FAILURE;
     }
 
+    if (argc == 2 && IsBinaryPath(argv[1])) {
+        Binary binary;
+        if (!Binary_Map(&binary, argv[1])) {
+            return EXIT_FAILURE;
+        }
+        // The stack size --compile found, a program that needs no stack still gets the default one
+        bool isBounded     = binary.Header.IsStackBounded && binary.Header.StackSize > 0;
+        uint64_t stackSize = isBounded ? binary.Header.StackSize : VM_DEFAULT_STACK_SIZE;
+        int exitCode       = Run(binary.Code, binary.Header.CodeSize, stackSize);
+        Binary_Unmap(&binary);
+        return exitCode;
+    }
+
     Lexer lexer;
-    if (!Lexer_Create(&lexer, String_FromCString(argv[1]))) {
+    if (!Lexer_Create(&lexer, String_FromCString(compile || translate ? argv[2] : argv[argc - 1]))) {
         return EXIT_FAILURE;
     }
 
     Emitter emitter;
-    if (!Emitter_Create(&emitter, lexer)) {
+    if (!Emitter_CreatePreLexed(&emitter, lexer, 0)) {
         return EXIT_FAILURE;
     }
 
@@ -29,27 +192,41 @@ int main(int argc, char** argv) {
         return EXIT_FAILURE;
     }
 
-    ByteArray code;
-    ByteArray_Clone(&code, emitter.Code);
+    Optimizer_Optimize(&emitter);
 
-    Emitter_Destroy(&emitter);
+    if (stackInfo) {
+        StackAnalysis analysis;
+        StackAnalysis_Analyze(&analysis, &emitter);
+        StackAnalysis_Print(&analysis);
+        StackAnalysis_Destroy(&analysis);
+        Emitter_Destroy(&emitter);
+        return EXIT_SUCCESS;
+    }
 
-    // VM is too big for the stack
-    VM* vm = malloc(sizeof(VM));
-    if (!vm) {
-        return EXIT_FAILURE;
+    if (compile || translate) {
+        StackAnalysis analysis;
+        StackAnalysis_Analyze(&analysis, &emitter);
+        uint64_t stackSize = analysis.IsBounded ? analysis.MaxDepth : VM_DEFAULT_STACK_SIZE;
+        bool written       = false;
+        if (compile) {
+            written = Binary_Write(argv[3], emitter.Code.Data, emitter.Code.Length, analysis.IsBounded, stackSize);
+        } else {
+            written = Translator_WriteC(&emitter, stackSize, argv[3]);
+        }
+        StackAnalysis_Destroy(&analysis);
+        Emitter_Destroy(&emitter);
+        return written ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    VM_Init(vm, code.Data, code.Length);
+    // The code of the emitter is freed along with its arena
+    ByteArray code = ByteArray_Create();
+    ByteArray_Append(&code, emitter.Code.Data, emitter.Code.Length);
 
-    if (!VM_Run(vm)) {
-        return EXIT_FAILURE;
-    }
+    Emitter_Destroy(&emitter);
 
-    free(vm);
+    int exitCode = Run(code.Data, code.Length, VM_DEFAULT_STACK_SIZE);
     ByteArray_Destroy(&code);
-
-    return EXIT_SUCCESS;
+    return exitCode;
 
 #if 0
     bool compiling = true;
@@ -0,0 +1,178 @@
+#include "Module.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+
+#if defined(_WIN32)
+    #include <Windows.h>
+#else
+    #error Unsupported platform
+#endif
+
+// Every module that was imported so far, shared by all emitters
+static ModulePointerArray Modules = {};
+// Held for a whole import, since emitting a module imports its own modules on the same thread
+// Another thread importing meanwhile waits, instead of seeing a module that is still being emitted as an import cycle
+static CRITICAL_SECTION ModulesLock;
+static INIT_ONCE ModulesLockOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK InitializeModulesLock(PINIT_ONCE once, PVOID parameter, PVOID* context) {
+    InitializeCriticalSection(&ModulesLock);
+    return TRUE;
+}
+
+static bool IsAbsolutePath(String path) {
+    return (path.Length >= 1 && (path.Data[0] == '/' || path.Data[0] == '\\')) || (path.Length >= 2 && path.Data[1] == ':');
+}
+
+// Whether the file of the module still holds the text the module was emitted from
+static bool Module_IsFileUnchanged(Module* module) {
+    String filePath = module->Emitter.Lexer.FilePath;
+    String source   = module->Emitter.Lexer.Source;
+
+    char* path = malloc(filePath.Length + 1);
+    if (!path) {
+        return false;
+    }
+    memcpy(path, filePath.Data, filePath.Length);
+    path[filePath.Length] = '\0';
+
+    FILE* file = fopen(path, "rb");
+    free(path);
+    if (!file) {
+        return false;
+    }
+
+    uint8_t  buffer[4096];
+    uint64_t offset = 0;
+    bool     isSame = true;
+    while (isSame) {
+        uint64_t readLength = fread(buffer, 1, sizeof(buffer), file);
+        if (readLength == 0) {
+            break;
+        }
+        isSame = offset + readLength <= source.Length && memcmp(buffer, &source.Data[offset], readLength) == 0;
+        offset += readLength;
+    }
+    isSame = isSame && offset == source.Length && !ferror(file);
+    fclose(file);
+    return isSame;
+}
+
+// The imports of a module hold every module it depends on, not only the ones it names itself
+static bool Module_AreImportsUnchanged(Module* module) {
+    for (uint64_t i = 0; i < module->Emitter.Imports.Length; i++) {
+        if (!Module_IsFileUnchanged(module->Emitter.Imports.Data[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static Module* Module_ImportLocked(String importingFilePath, String path) {
+    uint64_t directoryLength = 0;
+    if (!IsAbsolutePath(path)) {
+        for (uint64_t i = 0; i < importingFilePath.Length; i++) {
+            if (importingFilePath.Data[i] == '/' || importingFilePath.Data[i] == '\\') {
+                directoryLength = i + 1;
+            }
+        }
+    }
+
+    String fullPath = (String){
+        .Data   = malloc(directoryLength + path.Length),
+        .Length = directoryLength + path.Length,
+    };
+    if (!fullPath.Data) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to allocate file path\n");
+        return NULL;
+    }
+    memcpy(fullPath.Data, importingFilePath.Data, directoryLength);
+    memcpy(&fullPath.Data[directoryLength], path.Data, path.Length);
+
+    Lexer lexer;
+    bool loaded = Lexer_Create(&lexer, fullPath);
+    free(fullPath.Data);
+    if (!loaded) {
+        return NULL;
+    }
+
+    // The imports of a module are relative to its directory, so the same text elsewhere is a different module
+    // A module also goes stale when any file it imports, directly or not, changed since it was emitted
+    uint64_t hash = String_Hash(lexer.Source);
+    for (uint64_t i = 0; i < Modules.Length;) {
+        Module* cached = Modules.Data[i];
+        if (!String_Equal(cached->Emitter.Lexer.FilePath, lexer.FilePath)) {
+            i++;
+            continue;
+        }
+
+        if (cached->Hash == hash && String_Equal(cached->Emitter.Lexer.Source, lexer.Source)) {
+            if (cached->IsEmitting) {
+                fflush(stdout);
+                fprintf(stderr, "Import cycle through the module '%.*s'\n", String_Fmt(lexer.FilePath));
+                Lexer_Destroy(&lexer);
+                return NULL;
+            }
+            if (Module_AreImportsUnchanged(cached)) {
+                Lexer_Destroy(&lexer);
+                return cached;
+            }
+        }
+
+        // Stale, dropped from the cache but not freed since whoever imported it may still point to it
+        if (cached->IsEmitting) {
+            i++;
+        } else {
+            ModulePointerArray_Remove(&Modules, i);
+        }
+    }
+
+    Module* module = malloc(sizeof(Module));
+    if (!module) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to allocate the module for '%.*s'\n", String_Fmt(lexer.FilePath));
+        Lexer_Destroy(&lexer);
+        return NULL;
+    }
+
+    *module = (Module){
+        .Hash       = hash,
+        .IsEmitting = true,
+    };
+    if (!Emitter_CreatePreLexed(&module->Emitter, lexer, 0)) {
+        Lexer_Destroy(&lexer);
+        free(module);
+        return NULL;
+    }
+
+    // Pushed before emitting, so imports of the module can see that it is still being emitted
+    ModulePointerArray_Push(&Modules, module);
+    module->Emitter.DeferUnknownLabels = true;
+    Emitter_Emit(&module->Emitter);
+    module->IsEmitting = false;
+
+    if (module->Emitter.WasError) {
+        // Looked up again, imports of the module may have dropped stale modules before it
+        for (uint64_t i = 0; i < Modules.Length; i++) {
+            if (Modules.Data[i] == module) {
+                ModulePointerArray_Remove(&Modules, i);
+                break;
+            }
+        }
+        Emitter_Destroy(&module->Emitter);
+        free(module);
+        return NULL;
+    }
+    return module;
+}
+
+Module* Module_Import(String importingFilePath, String path) {
+    InitOnceExecuteOnce(&ModulesLockOnce, InitializeModulesLock, NULL, NULL);
+    EnterCriticalSection(&ModulesLock);
+    Module* module = Module_ImportLocked(importingFilePath, path);
+    LeaveCriticalSection(&ModulesLock);
+    return module;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Emitter.h"
+
+// A file that is assembled on its own so other files can import it
+typedef struct Module {
+    // Hash of the source text, every file that imports the same file shares the module while its text stays the same
+    uint64_t Hash;
+    // Holds the source and the code, labels, label references, macros and imports of the module
+    // The code does not contain the modules it imports, those are appended once by whoever imports it
+    Emitter Emitter;
+    // Set while the module is being emitted, to catch modules that import each other
+    bool IsEmitting;
+} Module;
+
+// Loads the file at path, relative to the directory of the importing file, and assembles it
+// When the file was imported before with the same text, and none of the files it imports changed since, the module from then
+// is returned without assembling it again
+// Stale modules are dropped from the cache but never freed, importers may still point to them
+// Modules live until the end of the process, errors are reported and return NULL
+// Imports on different threads are serialized, the modules are shared between them
+Module* Module_Import(String importingFilePath, String path);
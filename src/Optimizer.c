@@ -0,0 +1,390 @@
+#include "Optimizer.h"
+#include "StackAnalysis.h"
+
+#include <stdlib.h>
+#include <memory.h>
+
+// Marks the bytes of the code that hold label locations
+typedef enum ReferenceByte {
+    ReferenceByte_None,
+    ReferenceByte_Start,
+    ReferenceByte_Rest,
+} ReferenceByte;
+
+typedef struct Instruction {
+    uint64_t Offset;
+    uint64_t Length;
+    // A label points at this instruction so it can be entered from elsewhere
+    bool IsLabeled;
+    bool IsReachable;
+    // Folded into an earlier instruction
+    bool IsDead;
+    // Replaced by a push of Value
+    bool IsConstant;
+    uint64_t ConstantSize;
+    uint64_t ConstantValue;
+} Instruction;
+
+ARRAY_DECL(Instruction, Instruction);
+ARRAY_IMPL(Instruction, Instruction);
+
+static uint64_t SizeMask(uint64_t size) {
+    return size == sizeof(uint64_t) ? UINT64_MAX : ((uint64_t)1 << (size * 8)) - 1;
+}
+
+static int64_t SignExtend(uint64_t value, uint64_t size) {
+    uint64_t shift = 64 - size * 8;
+    return (int64_t)(value << shift) >> shift;
+}
+
+static bool IsTerminator(Op op) {
+    switch (op) {
+        case Op_Exit:
+        case Op_Jump:
+        case Op_JumpDyn:
+        case Op_Ret:
+        case Op_TailCall:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// Gets the value of a push that can be folded, label pushes are never constant because they get relocated
+static bool GetConstant(Emitter* emitter, Instruction* instruction, uint8_t* isReference, uint64_t* size, uint64_t* value) {
+    if (instruction->IsConstant) {
+        *size  = instruction->ConstantSize;
+        *value = instruction->ConstantValue;
+        return true;
+    }
+
+    uint8_t* ip = &emitter->Code.Data[instruction->Offset];
+    if (*ip != Op_Push) {
+        return false;
+    }
+
+    uint64_t pushSize = *(uint64_t*)(ip + 1);
+    if (pushSize != 1 && pushSize != 2 && pushSize != 4 && pushSize != 8) {
+        return false;
+    }
+
+    uint64_t dataOffset = instruction->Offset + 1 + sizeof(uint64_t);
+    for (uint64_t i = 0; i < pushSize; i++) {
+        if (isReference[dataOffset + i] != ReferenceByte_None) {
+            return false;
+        }
+    }
+
+    *size  = pushSize;
+    *value = 0;
+    memcpy(value, &emitter->Code.Data[dataOffset], pushSize);
+    return true;
+}
+
+// Computes a op b at the given size, the result size differs from the operand size for compares
+static bool FoldBinary(Op op, uint64_t size, uint64_t a, uint64_t b, uint64_t* resultSize, uint64_t* result) {
+    uint64_t mask = SizeMask(size);
+    uint64_t bits = size * 8;
+    *resultSize   = size;
+    switch (op) {
+        case Op_Add: {
+            *result = (a + b) & mask;
+        } break;
+
+        case Op_Sub: {
+            *result = (a - b) & mask;
+        } break;
+
+        case Op_Mul: {
+            *result = (a * b) & mask;
+        } break;
+
+        case Op_DivUnsigned: {
+            if (b == 0) {
+                return false;
+            }
+            *result = a / b;
+        } break;
+
+        case Op_ModUnsigned: {
+            if (b == 0) {
+                return false;
+            }
+            *result = a % b;
+        } break;
+
+        case Op_And: {
+            *result = a & b;
+        } break;
+
+        case Op_Or: {
+            *result = a | b;
+        } break;
+
+        case Op_Xor: {
+            *result = a ^ b;
+        } break;
+
+        case Op_ShiftLeft: {
+            *result = (a << (b & (bits - 1))) & mask;
+        } break;
+
+        case Op_ShiftRight: {
+            *result = a >> (b & (bits - 1));
+        } break;
+
+        case Op_Equal: {
+            *resultSize = 1;
+            *result     = a == b;
+        } break;
+
+        case Op_LessSigned: {
+            *resultSize = 1;
+            *result     = SignExtend(a, size) < SignExtend(b, size);
+        } break;
+
+        case Op_LessUnsigned: {
+            *resultSize = 1;
+            *result     = a < b;
+        } break;
+
+        case Op_LessEqualSigned: {
+            *resultSize = 1;
+            *result     = SignExtend(a, size) <= SignExtend(b, size);
+        } break;
+
+        case Op_LessEqualUnsigned: {
+            *resultSize = 1;
+            *result     = a <= b;
+        } break;
+
+        default: {
+            return false;
+        } break;
+    }
+    return true;
+}
+
+static int64_t PreviousLive(InstructionArray* instructions, int64_t index) {
+    for (index--; index >= 0; index--) {
+        if (!instructions->Data[index].IsDead) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+static void FoldConstants(Emitter* emitter, InstructionArray* instructions, uint8_t* isReference) {
+    for (uint64_t i = 0; i < instructions->Length; i++) {
+        Instruction* instruction = &instructions->Data[i];
+        if (!instruction->IsReachable || instruction->IsLabeled) {
+            continue;
+        }
+
+        uint8_t* ip = &emitter->Code.Data[instruction->Offset];
+        if (instruction->Length != 1 + sizeof(uint64_t)) {
+            continue;
+        }
+        uint64_t size = *(uint64_t*)(ip + 1);
+
+        int64_t bIndex = PreviousLive(instructions, (int64_t)i);
+        int64_t aIndex = bIndex >= 0 ? PreviousLive(instructions, bIndex) : -1;
+        if (aIndex < 0 || instructions->Data[bIndex].IsLabeled || !instructions->Data[aIndex].IsReachable) {
+            continue;
+        }
+
+        uint64_t aSize, aValue, bSize, bValue;
+        if (!GetConstant(emitter, &instructions->Data[aIndex], isReference, &aSize, &aValue) ||
+            !GetConstant(emitter, &instructions->Data[bIndex], isReference, &bSize, &bValue) || aSize != size ||
+            bSize != size) {
+            continue;
+        }
+
+        uint64_t resultSize, result;
+        if (!FoldBinary((Op)*ip, size, aValue, bValue, &resultSize, &result)) {
+            continue;
+        }
+
+        instructions->Data[aIndex].IsConstant    = true;
+        instructions->Data[aIndex].ConstantSize  = resultSize;
+        instructions->Data[aIndex].ConstantValue = result;
+        instructions->Data[bIndex].IsDead        = true;
+        instruction->IsDead                      = true;
+    }
+}
+
+// A call straight followed by a ret becomes a tail call, the callee then returns through the 8 bytes below the call location
+// That is only the same when the ret returns through those bytes as well, and returns exactly what the callee returned
+// The stack analysis proves both: the callee returns ret-size bytes through its own return location, so its return depth
+// is ret-size - arg-size - 8, and the ret then returns the same number of bytes
+// The ret is left in the code since a label may still point at it
+static void FuseTailCalls(Emitter* emitter) {
+    StackAnalysis analysis;
+    StackAnalysis_Analyze(&analysis, emitter);
+    for (uint64_t i = 0; i < analysis.CallSites.Length; i++) {
+        StackCallSite site    = analysis.CallSites.Data[i];
+        StackFunction* caller = &analysis.Functions.Data[site.Caller];
+        StackFunction* callee = &analysis.Functions.Data[site.Callee];
+        uint8_t* call         = &emitter->Code.Data[site.Offset];
+        uint64_t retOffset    = site.Offset + 1 + sizeof(uint64_t);
+        if (!caller->IsComplete || !callee->IsComplete || !callee->IsReturnSizeKnown ||
+            retOffset + 1 + sizeof(uint64_t) > emitter->Code.Length || emitter->Code.Data[retOffset] != Op_Ret) {
+            continue;
+        }
+
+        int64_t argSize = (int64_t)*(uint64_t*)(call + 1);
+        int64_t retSize = (int64_t)*(uint64_t*)&emitter->Code.Data[retOffset + 1];
+        if (retSize == (int64_t)callee->ReturnSize && retSize == callee->ReturnDepth + argSize + (int64_t)sizeof(uint64_t)) {
+            *call = Op_TailCall;
+        }
+    }
+    StackAnalysis_Destroy(&analysis);
+}
+
+void Optimizer_Optimize(Emitter* emitter) {
+    uint64_t codeLength = emitter->Code.Length;
+    if (codeLength == 0) {
+        return;
+    }
+
+    // Maps a code offset to the instruction starting there, or -1 for the middle of an instruction
+    int64_t* instructionAt = malloc((codeLength + 1) * sizeof(int64_t));
+    uint8_t* isReference   = calloc(codeLength, sizeof(uint8_t));
+    for (uint64_t i = 0; i <= codeLength; i++) {
+        instructionAt[i] = -1;
+    }
+
+    InstructionArray instructions = InstructionArray_Create();
+    for (uint64_t offset = 0; offset < codeLength;) {
+        uint64_t length = VM_GetInstructionLength(&emitter->Code.Data[offset]);
+        if (length == 0 || offset + length > codeLength) {
+            // Not something we understand, leave the code alone
+            InstructionArray_Destroy(&instructions);
+            free(isReference);
+            free(instructionAt);
+            return;
+        }
+        instructionAt[offset] = (int64_t)instructions.Length;
+        InstructionArray_Push(&instructions,
+                              (Instruction){
+                                  .Offset = offset,
+                                  .Length = length,
+                              });
+        offset += length;
+    }
+
+    for (uint64_t i = 0; i < emitter->References.Length; i++) {
+        uint64_t index = emitter->References.Data[i].IndexForAddress;
+        isReference[index] = ReferenceByte_Start;
+        for (uint64_t j = 1; j < sizeof(uint64_t); j++) {
+            isReference[index + j] = ReferenceByte_Rest;
+        }
+    }
+
+    for (uint64_t i = 0; i < emitter->Labels.Length; i++) {
+        int64_t index = instructionAt[emitter->Labels.Data[i].Location];
+        if (index >= 0) {
+            instructions.Data[index].IsLabeled = true;
+        }
+    }
+
+    // Every label referenced from reachable code is reachable, whether it is jumped to or pushed for a call or jump-dyn
+    uint64_t* worklist               = malloc(instructions.Length * sizeof(uint64_t));
+    uint64_t worklistSize            = 0;
+    worklist[worklistSize++]         = 0;
+    instructions.Data[0].IsReachable = true;
+    while (worklistSize > 0) {
+        Instruction* instruction = &instructions.Data[worklist[--worklistSize]];
+        for (uint64_t offset = instruction->Offset; offset < instruction->Offset + instruction->Length; offset++) {
+            if (isReference[offset] != ReferenceByte_Start) {
+                continue;
+            }
+            uint64_t target = *(uint64_t*)&emitter->Code.Data[offset];
+            int64_t index   = target < codeLength ? instructionAt[target] : -1;
+            if (index >= 0 && !instructions.Data[index].IsReachable) {
+                instructions.Data[index].IsReachable = true;
+                worklist[worklistSize++]             = index;
+            }
+        }
+
+        uint64_t next = instruction - instructions.Data + 1;
+        if (!IsTerminator((Op)emitter->Code.Data[instruction->Offset]) && next < instructions.Length &&
+            !instructions.Data[next].IsReachable) {
+            instructions.Data[next].IsReachable = true;
+            worklist[worklistSize++]            = next;
+        }
+    }
+    free(worklist);
+
+    FoldConstants(emitter, &instructions, isReference);
+
+    // Removed instructions map to the next instruction that is kept
+    uint64_t* newLocation = malloc((codeLength + 1) * sizeof(uint64_t));
+    ByteArray code        = ByteArray_CreateWithAllocator(emitter->Code.Allocator);
+    // Nothing the optimizer does makes the code longer
+    ByteArray_Reserve(&code, codeLength);
+    for (uint64_t i = 0; i < instructions.Length; i++) {
+        Instruction* instruction = &instructions.Data[i];
+        if (!instruction->IsReachable || instruction->IsDead) {
+            continue;
+        }
+
+        newLocation[instruction->Offset] = code.Length;
+        if (instruction->IsConstant) {
+            ByteArray_Push(&code, Op_Push);
+            ByteArray_Append(&code, (uint8_t*)&instruction->ConstantSize, sizeof(uint64_t));
+            ByteArray_Append(&code, (uint8_t*)&instruction->ConstantValue, instruction->ConstantSize);
+        } else {
+            ByteArray_Append(&code, &emitter->Code.Data[instruction->Offset], instruction->Length);
+        }
+    }
+
+    uint64_t following      = code.Length;
+    newLocation[codeLength] = following;
+    for (int64_t i = (int64_t)instructions.Length - 1; i >= 0; i--) {
+        Instruction* instruction = &instructions.Data[i];
+        if (instruction->IsReachable && !instruction->IsDead) {
+            following = newLocation[instruction->Offset];
+        } else {
+            newLocation[instruction->Offset] = following;
+        }
+    }
+
+    // References inside removed code are dropped, the rest are moved along with their instruction and patched
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < emitter->References.Length; i++) {
+        LabelReference reference = emitter->References.Data[i];
+        uint64_t offset          = reference.IndexForAddress;
+        while (instructionAt[offset] < 0) {
+            offset--;
+        }
+        Instruction* instruction = &instructions.Data[instructionAt[offset]];
+        if (!instruction->IsReachable || instruction->IsDead) {
+            continue;
+        }
+
+        uint64_t target           = *(uint64_t*)&emitter->Code.Data[reference.IndexForAddress];
+        reference.IndexForAddress = newLocation[offset] + (reference.IndexForAddress - offset);
+        if (target == codeLength || (target < codeLength && instructionAt[target] >= 0)) {
+            *(uint64_t*)&code.Data[reference.IndexForAddress] = newLocation[target];
+        }
+        emitter->References.Data[kept++] = reference;
+    }
+    emitter->References.Length = kept;
+
+    for (uint64_t i = 0; i < emitter->Labels.Length; i++) {
+        emitter->Labels.Data[i].Location = newLocation[emitter->Labels.Data[i].Location];
+    }
+
+    ByteArray_Destroy(&emitter->Code);
+    emitter->Code = code;
+
+    free(newLocation);
+    InstructionArray_Destroy(&instructions);
+    free(isReference);
+    free(instructionAt);
+
+    // The analysis needs the relocated code
+    FuseTailCalls(emitter);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Emitter.h"
+
+// Runs over the code of an emitter that finished without errors
+// Folds constant arithmetic and removes code that can never run, then relocates the labels and label references
+// Last, turns call followed by ret into a tail call where the stack analysis proves the callee returns the same bytes
+// Code locations are only followed through labels, so jump-dyn and call targets must come from pushed labels
+void Optimizer_Optimize(Emitter* emitter);
@@ -0,0 +1,266 @@
+#include "Simd.h"
+
+#include <memory.h>
+
+#if defined(_WIN32)
+    #include <Windows.h>
+#else
+    #error Unsupported platform
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define SIMD_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        // MSVC compiles AVX2 intrinsics in any function, the cpu is checked before they are called
+        #define SIMD_TARGET_AVX2
+    #else
+        #define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+    #endif
+#else
+    #define SIMD_X86 0
+#endif
+
+// Processes size bytes, size is always a multiple of the lane size
+typedef void (*VecKernel)(uint8_t* dst, const uint8_t* a, const uint8_t* b, uint64_t size);
+
+#define SCALAR_KERNEL(name, bits, expr)                                                    \
+    static void name(uint8_t* dst, const uint8_t* a, const uint8_t* b, uint64_t size) {    \
+        for (uint64_t i = 0; i < size; i += sizeof(uint##bits##_t)) {                      \
+            uint##bits##_t ux, uy;                                                         \
+            memcpy(&ux, &a[i], sizeof(ux));                                                \
+            memcpy(&uy, &b[i], sizeof(uy));                                                \
+            int##bits##_t x  = (int##bits##_t)ux;                                          \
+            int##bits##_t y  = (int##bits##_t)uy;                                          \
+            (void)x;                                                                       \
+            (void)y;                                                                       \
+            uint##bits##_t r = (uint##bits##_t)(expr);                                     \
+            memcpy(&dst[i], &r, sizeof(r));                                                \
+        }                                                                                  \
+    }
+
+#define SCALAR_KERNELS(bits)                                                          \
+    SCALAR_KERNEL(Scalar_Add##bits, bits, ux + uy)                                    \
+    SCALAR_KERNEL(Scalar_Sub##bits, bits, ux - uy)                                    \
+    SCALAR_KERNEL(Scalar_Min##bits, bits, x < y ? x : y)                              \
+    SCALAR_KERNEL(Scalar_Max##bits, bits, x > y ? x : y)                              \
+    SCALAR_KERNEL(Scalar_Equal##bits, bits, x == y ? (uint##bits##_t)-1 : 0)          \
+    SCALAR_KERNEL(Scalar_Less##bits, bits, x < y ? (uint##bits##_t)-1 : 0)
+
+SCALAR_KERNELS(8)
+SCALAR_KERNELS(16)
+SCALAR_KERNELS(32)
+SCALAR_KERNELS(64)
+
+#if SIMD_X86
+
+// The vector loop handles whole registers and the scalar kernel handles whatever is left over
+    #define SSE2_KERNEL(name, expr, scalar)                                                \
+        static void name(uint8_t* dst, const uint8_t* a, const uint8_t* b, uint64_t size) { \
+            uint64_t i = 0;                                                                \
+            for (; i + 16 <= size; i += 16) {                                              \
+                __m128i x = _mm_loadu_si128((const __m128i*)&a[i]);                        \
+                __m128i y = _mm_loadu_si128((const __m128i*)&b[i]);                        \
+                _mm_storeu_si128((__m128i*)&dst[i], (expr));                               \
+            }                                                                              \
+            scalar(&dst[i], &a[i], &b[i], size - i);                                       \
+        }
+
+    #define AVX2_KERNEL(name, expr, scalar)                                                \
+        SIMD_TARGET_AVX2 static void name(uint8_t* dst,                                    \
+                                          const uint8_t* a,                                \
+                                          const uint8_t* b,                                \
+                                          uint64_t size) {                                 \
+            uint64_t i = 0;                                                                \
+            for (; i + 32 <= size; i += 32) {                                              \
+                __m256i x = _mm256_loadu_si256((const __m256i*)&a[i]);                     \
+                __m256i y = _mm256_loadu_si256((const __m256i*)&b[i]);                     \
+                _mm256_storeu_si256((__m256i*)&dst[i], (expr));                            \
+            }                                                                              \
+            scalar(&dst[i], &a[i], &b[i], size - i);                                       \
+        }
+
+static inline __m128i Sse2_Select(__m128i mask, __m128i ifTrue, __m128i ifFalse) {
+    return _mm_or_si128(_mm_and_si128(mask, ifTrue), _mm_andnot_si128(mask, ifFalse));
+}
+
+// SSE2 has no 64 bit compare, a 64 bit lane is equal when both of its 32 bit halves are
+static inline __m128i Sse2_CompareEqual64(__m128i x, __m128i y) {
+    __m128i halves = _mm_cmpeq_epi32(x, y);
+    return _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+SSE2_KERNEL(Sse2_Add8, _mm_add_epi8(x, y), Scalar_Add8)
+SSE2_KERNEL(Sse2_Add16, _mm_add_epi16(x, y), Scalar_Add16)
+SSE2_KERNEL(Sse2_Add32, _mm_add_epi32(x, y), Scalar_Add32)
+SSE2_KERNEL(Sse2_Add64, _mm_add_epi64(x, y), Scalar_Add64)
+SSE2_KERNEL(Sse2_Sub8, _mm_sub_epi8(x, y), Scalar_Sub8)
+SSE2_KERNEL(Sse2_Sub16, _mm_sub_epi16(x, y), Scalar_Sub16)
+SSE2_KERNEL(Sse2_Sub32, _mm_sub_epi32(x, y), Scalar_Sub32)
+SSE2_KERNEL(Sse2_Sub64, _mm_sub_epi64(x, y), Scalar_Sub64)
+SSE2_KERNEL(Sse2_Min8, Sse2_Select(_mm_cmpgt_epi8(x, y), y, x), Scalar_Min8)
+SSE2_KERNEL(Sse2_Min16, _mm_min_epi16(x, y), Scalar_Min16)
+SSE2_KERNEL(Sse2_Min32, Sse2_Select(_mm_cmpgt_epi32(x, y), y, x), Scalar_Min32)
+SSE2_KERNEL(Sse2_Max8, Sse2_Select(_mm_cmpgt_epi8(x, y), x, y), Scalar_Max8)
+SSE2_KERNEL(Sse2_Max16, _mm_max_epi16(x, y), Scalar_Max16)
+SSE2_KERNEL(Sse2_Max32, Sse2_Select(_mm_cmpgt_epi32(x, y), x, y), Scalar_Max32)
+SSE2_KERNEL(Sse2_Equal8, _mm_cmpeq_epi8(x, y), Scalar_Equal8)
+SSE2_KERNEL(Sse2_Equal16, _mm_cmpeq_epi16(x, y), Scalar_Equal16)
+SSE2_KERNEL(Sse2_Equal32, _mm_cmpeq_epi32(x, y), Scalar_Equal32)
+SSE2_KERNEL(Sse2_Equal64, Sse2_CompareEqual64(x, y), Scalar_Equal64)
+SSE2_KERNEL(Sse2_Less8, _mm_cmplt_epi8(x, y), Scalar_Less8)
+SSE2_KERNEL(Sse2_Less16, _mm_cmplt_epi16(x, y), Scalar_Less16)
+SSE2_KERNEL(Sse2_Less32, _mm_cmplt_epi32(x, y), Scalar_Less32)
+
+AVX2_KERNEL(Avx2_Add8, _mm256_add_epi8(x, y), Scalar_Add8)
+AVX2_KERNEL(Avx2_Add16, _mm256_add_epi16(x, y), Scalar_Add16)
+AVX2_KERNEL(Avx2_Add32, _mm256_add_epi32(x, y), Scalar_Add32)
+AVX2_KERNEL(Avx2_Add64, _mm256_add_epi64(x, y), Scalar_Add64)
+AVX2_KERNEL(Avx2_Sub8, _mm256_sub_epi8(x, y), Scalar_Sub8)
+AVX2_KERNEL(Avx2_Sub16, _mm256_sub_epi16(x, y), Scalar_Sub16)
+AVX2_KERNEL(Avx2_Sub32, _mm256_sub_epi32(x, y), Scalar_Sub32)
+AVX2_KERNEL(Avx2_Sub64, _mm256_sub_epi64(x, y), Scalar_Sub64)
+AVX2_KERNEL(Avx2_Min8, _mm256_min_epi8(x, y), Scalar_Min8)
+AVX2_KERNEL(Avx2_Min16, _mm256_min_epi16(x, y), Scalar_Min16)
+AVX2_KERNEL(Avx2_Min32, _mm256_min_epi32(x, y), Scalar_Min32)
+AVX2_KERNEL(Avx2_Min64, _mm256_blendv_epi8(x, y, _mm256_cmpgt_epi64(x, y)), Scalar_Min64)
+AVX2_KERNEL(Avx2_Max8, _mm256_max_epi8(x, y), Scalar_Max8)
+AVX2_KERNEL(Avx2_Max16, _mm256_max_epi16(x, y), Scalar_Max16)
+AVX2_KERNEL(Avx2_Max32, _mm256_max_epi32(x, y), Scalar_Max32)
+AVX2_KERNEL(Avx2_Max64, _mm256_blendv_epi8(y, x, _mm256_cmpgt_epi64(x, y)), Scalar_Max64)
+AVX2_KERNEL(Avx2_Equal8, _mm256_cmpeq_epi8(x, y), Scalar_Equal8)
+AVX2_KERNEL(Avx2_Equal16, _mm256_cmpeq_epi16(x, y), Scalar_Equal16)
+AVX2_KERNEL(Avx2_Equal32, _mm256_cmpeq_epi32(x, y), Scalar_Equal32)
+AVX2_KERNEL(Avx2_Equal64, _mm256_cmpeq_epi64(x, y), Scalar_Equal64)
+AVX2_KERNEL(Avx2_Less8, _mm256_cmpgt_epi8(y, x), Scalar_Less8)
+AVX2_KERNEL(Avx2_Less16, _mm256_cmpgt_epi16(y, x), Scalar_Less16)
+AVX2_KERNEL(Avx2_Less32, _mm256_cmpgt_epi32(y, x), Scalar_Less32)
+AVX2_KERNEL(Avx2_Less64, _mm256_cmpgt_epi64(y, x), Scalar_Less64)
+
+#endif
+
+// Indexed by op and then by log2 of the lane size
+static VecKernel Kernels[VecOp_Count][4] = {
+    [VecOp_Add]   = { Scalar_Add8, Scalar_Add16, Scalar_Add32, Scalar_Add64 },
+    [VecOp_Sub]   = { Scalar_Sub8, Scalar_Sub16, Scalar_Sub32, Scalar_Sub64 },
+    [VecOp_Min]   = { Scalar_Min8, Scalar_Min16, Scalar_Min32, Scalar_Min64 },
+    [VecOp_Max]   = { Scalar_Max8, Scalar_Max16, Scalar_Max32, Scalar_Max64 },
+    [VecOp_Equal] = { Scalar_Equal8, Scalar_Equal16, Scalar_Equal32, Scalar_Equal64 },
+    [VecOp_Less]  = { Scalar_Less8, Scalar_Less16, Scalar_Less32, Scalar_Less64 },
+};
+
+static INIT_ONCE KernelsSelected = INIT_ONCE_STATIC_INIT;
+
+#if SIMD_X86
+// The cpu has to support AVX2 and the OS has to save the upper halves of the ymm registers on context switches
+static bool HasAvx2(void) {
+    #if defined(_MSC_VER)
+    int registers[4];
+    __cpuid(registers, 0);
+    if (registers[0] < 7) {
+        return false;
+    }
+    __cpuid(registers, 1);
+    bool hasOsxsave = (registers[2] & (1 << 27)) != 0;
+    bool hasAvx     = (registers[2] & (1 << 28)) != 0;
+    if (!hasOsxsave || !hasAvx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(registers, 7, 0);
+    return (registers[1] & (1 << 5)) != 0;
+    #else
+    return __builtin_cpu_supports("avx2");
+    #endif
+}
+#endif
+
+static BOOL CALLBACK SelectKernels(PINIT_ONCE once, PVOID parameter, PVOID* context) {
+#if SIMD_X86
+    // SSE2 is part of the x86-64 baseline, there is no 64 bit signed compare until SSE4.2 so those stay scalar
+    Kernels[VecOp_Add][0]   = Sse2_Add8;
+    Kernels[VecOp_Add][1]   = Sse2_Add16;
+    Kernels[VecOp_Add][2]   = Sse2_Add32;
+    Kernels[VecOp_Add][3]   = Sse2_Add64;
+    Kernels[VecOp_Sub][0]   = Sse2_Sub8;
+    Kernels[VecOp_Sub][1]   = Sse2_Sub16;
+    Kernels[VecOp_Sub][2]   = Sse2_Sub32;
+    Kernels[VecOp_Sub][3]   = Sse2_Sub64;
+    Kernels[VecOp_Min][0]   = Sse2_Min8;
+    Kernels[VecOp_Min][1]   = Sse2_Min16;
+    Kernels[VecOp_Min][2]   = Sse2_Min32;
+    Kernels[VecOp_Max][0]   = Sse2_Max8;
+    Kernels[VecOp_Max][1]   = Sse2_Max16;
+    Kernels[VecOp_Max][2]   = Sse2_Max32;
+    Kernels[VecOp_Equal][0] = Sse2_Equal8;
+    Kernels[VecOp_Equal][1] = Sse2_Equal16;
+    Kernels[VecOp_Equal][2] = Sse2_Equal32;
+    Kernels[VecOp_Equal][3] = Sse2_Equal64;
+    Kernels[VecOp_Less][0]  = Sse2_Less8;
+    Kernels[VecOp_Less][1]  = Sse2_Less16;
+    Kernels[VecOp_Less][2]  = Sse2_Less32;
+
+    if (HasAvx2()) {
+        Kernels[VecOp_Add][0]   = Avx2_Add8;
+        Kernels[VecOp_Add][1]   = Avx2_Add16;
+        Kernels[VecOp_Add][2]   = Avx2_Add32;
+        Kernels[VecOp_Add][3]   = Avx2_Add64;
+        Kernels[VecOp_Sub][0]   = Avx2_Sub8;
+        Kernels[VecOp_Sub][1]   = Avx2_Sub16;
+        Kernels[VecOp_Sub][2]   = Avx2_Sub32;
+        Kernels[VecOp_Sub][3]   = Avx2_Sub64;
+        Kernels[VecOp_Min][0]   = Avx2_Min8;
+        Kernels[VecOp_Min][1]   = Avx2_Min16;
+        Kernels[VecOp_Min][2]   = Avx2_Min32;
+        Kernels[VecOp_Min][3]   = Avx2_Min64;
+        Kernels[VecOp_Max][0]   = Avx2_Max8;
+        Kernels[VecOp_Max][1]   = Avx2_Max16;
+        Kernels[VecOp_Max][2]   = Avx2_Max32;
+        Kernels[VecOp_Max][3]   = Avx2_Max64;
+        Kernels[VecOp_Equal][0] = Avx2_Equal8;
+        Kernels[VecOp_Equal][1] = Avx2_Equal16;
+        Kernels[VecOp_Equal][2] = Avx2_Equal32;
+        Kernels[VecOp_Equal][3] = Avx2_Equal64;
+        Kernels[VecOp_Less][0]  = Avx2_Less8;
+        Kernels[VecOp_Less][1]  = Avx2_Less16;
+        Kernels[VecOp_Less][2]  = Avx2_Less32;
+        Kernels[VecOp_Less][3]  = Avx2_Less64;
+    }
+#endif
+    return TRUE;
+}
+
+bool Vec_Apply(VecOp op, uint64_t laneSize, uint8_t* dst, const uint8_t* a, const uint8_t* b, uint64_t size) {
+    // Only the first call selects, the others only check that it is done
+    InitOnceExecuteOnce(&KernelsSelected, SelectKernels, NULL, NULL);
+
+    uint64_t lane;
+    switch (laneSize) {
+        case 1: {
+            lane = 0;
+        } break;
+
+        case 2: {
+            lane = 1;
+        } break;
+
+        case 4: {
+            lane = 2;
+        } break;
+
+        case 8: {
+            lane = 3;
+        } break;
+
+        default: {
+            return false;
+        } break;
+    }
+
+    if (op >= VecOp_Count || size % laneSize != 0) {
+        return false;
+    }
+
+    Kernels[op][lane](dst, a, b, size);
+    return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum VecOp {
+    VecOp_Add,
+    VecOp_Sub,
+    // Signed minimum
+    VecOp_Min,
+    // Signed maximum
+    VecOp_Max,
+    // Lanes are set to all ones when equal and zero otherwise
+    VecOp_Equal,
+    // Lanes are set to all ones when a is less than b (signed) and zero otherwise
+    VecOp_Less,
+    VecOp_Count,
+} VecOp;
+
+// Applies op lane-wise to size bytes of a and b and writes the result to dst
+// dst may alias a or b, the lane size must be 1, 2, 4 or 8 and size must be a multiple of it
+// Uses AVX2 or SSE2 when the cpu supports it and falls back to scalar code otherwise, the first call picks the kernels
+bool Vec_Apply(VecOp op, uint64_t laneSize, uint8_t* dst, const uint8_t* a, const uint8_t* b, uint64_t size);
@@ -0,0 +1,141 @@
+#include "Snapshot.h"
+#include "Tier.h"
+
+#include <stdio.h>
+#include <memory.h>
+
+#if defined(_WIN32)
+    #include <Windows.h>
+#else
+    #error Unsupported platform
+#endif
+
+static uint8_t* Snapshot_MapStack(Snapshot* snapshot) {
+#if defined(_WIN32)
+    // Writes go to private pages of the clone and never reach the snapshot
+    return MapViewOfFile(snapshot->Mapping, FILE_MAP_COPY, 0, 0, snapshot->StackSize);
+#else
+    #error Unsupported platform
+#endif
+}
+
+bool Snapshot_Create(Snapshot* snapshot, VM* vm) {
+    *snapshot = (Snapshot){};
+
+    if (Heap_GetStats(&vm->Heap).BytesInUse != 0) {
+        fflush(stdout);
+        fprintf(stderr, "Cannot snapshot a VM with live heap allocations\n");
+        return false;
+    }
+
+#if defined(_WIN32)
+    // The mapping is backed by the page file, so it lives only as long as the snapshot
+    snapshot->Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE,
+                                           NULL,
+                                           PAGE_READWRITE,
+                                           (DWORD)(vm->StackSize >> 32),
+                                           (DWORD)(vm->StackSize & 0xFFFFFFFF),
+                                           NULL);
+    if (!snapshot->Mapping) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to create the snapshot mapping\n");
+        return false;
+    }
+
+    uint8_t* view = MapViewOfFile(snapshot->Mapping, FILE_MAP_WRITE, 0, 0, vm->StackSize);
+    if (!view) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to map the snapshot\n");
+        CloseHandle(snapshot->Mapping);
+        *snapshot = (Snapshot){};
+        return false;
+    }
+
+    // The rest of the mapping is already zero, just like an unused stack
+    memcpy(view, vm->Stack, vm->Sp - vm->Stack);
+    UnmapViewOfFile(view);
+#else
+    #error Unsupported platform
+#endif
+
+    snapshot->Code      = vm->Code;
+    snapshot->CodeSize  = vm->CodeSize;
+    snapshot->StackSize = vm->StackSize;
+    snapshot->SpOffset  = vm->Sp - vm->Stack;
+    snapshot->IpOffset  = vm->Ip - vm->Code;
+    return true;
+}
+
+void Snapshot_Destroy(Snapshot* snapshot) {
+#if defined(_WIN32)
+    if (snapshot->Mapping) {
+        CloseHandle(snapshot->Mapping);
+    }
+#else
+    #error Unsupported platform
+#endif
+    *snapshot = (Snapshot){};
+}
+
+bool Snapshot_Clone(Snapshot* snapshot, VM* vm) {
+    *vm       = (VM){};
+    vm->Stack = Snapshot_MapStack(snapshot);
+    if (!vm->Stack) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to map the snapshot stack\n");
+        return false;
+    }
+    vm->StackSize     = snapshot->StackSize;
+    vm->StackIsMapped = true;
+    vm->Fuel          = VM_UNLIMITED_FUEL;
+    Heap_Init(&vm->Heap);
+
+    vm->Code           = snapshot->Code;
+    vm->CodeSize       = snapshot->CodeSize;
+    vm->Ip             = vm->Code + snapshot->IpOffset;
+    vm->Sp             = vm->Stack + snapshot->SpOffset;
+    vm->StackHighWater = vm->Sp;
+    return true;
+}
+
+bool Snapshot_Restore(Snapshot* snapshot, VM* vm) {
+    if (!vm->StackIsMapped || vm->StackSize != snapshot->StackSize) {
+        fflush(stdout);
+        fprintf(stderr, "The VM was not cloned from this snapshot\n");
+        return false;
+    }
+
+    // Remapping drops the pages the clone wrote to, which is cheaper than copying the stack back
+    Snapshot_ReleaseStack(vm->Stack, vm->StackSize);
+    vm->Stack = Snapshot_MapStack(snapshot);
+    if (!vm->Stack) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to map the snapshot stack\n");
+        vm->StackIsMapped = false;
+        vm->StackSize     = 0;
+        return false;
+    }
+
+    // The loops compiled for other code are dropped like VM_Load does
+    if (vm->Code != snapshot->Code) {
+        Tier_Destroy(vm->Tier);
+        vm->Tier = NULL;
+    }
+    vm->Code           = snapshot->Code;
+    vm->CodeSize       = snapshot->CodeSize;
+    vm->Ip             = vm->Code + snapshot->IpOffset;
+    vm->Sp             = vm->Stack + snapshot->SpOffset;
+    vm->StackHighWater = vm->Sp;
+    vm->Fuel           = VM_UNLIMITED_FUEL;
+    Heap_Reset(&vm->Heap);
+    memset(vm->Timers, 0, sizeof(vm->Timers));
+    return true;
+}
+
+void Snapshot_ReleaseStack(uint8_t* stack, uint64_t stackSize) {
+#if defined(_WIN32)
+    UnmapViewOfFile(stack);
+#else
+    #error Unsupported platform
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "VM.h"
+
+// A frozen copy of a VM's stack, stack pointer and instruction pointer
+// Clones map the stack copy-on-write, so they start in the saved state without copying it
+// The heap is not part of the snapshot, and the stack is mapped at a new address in every clone
+// so it must not hold pointers into the stack or the heap when the snapshot is taken
+typedef struct Snapshot {
+    void* Mapping;
+    uint8_t* Code;
+    uint64_t CodeSize;
+    uint64_t StackSize;
+    uint64_t SpOffset;
+    uint64_t IpOffset;
+} Snapshot;
+
+// Usually called after VM_Run returned VMResult_Checkpoint, fails if the heap has live allocations
+bool Snapshot_Create(Snapshot* snapshot, VM* vm);
+// Clones must be destroyed before the snapshot
+void Snapshot_Destroy(Snapshot* snapshot);
+// Creates a VM in the saved state, VM_Run continues from where the snapshot was taken
+bool Snapshot_Clone(Snapshot* snapshot, VM* vm);
+// Puts a clone back into the saved state by throwing away its private pages
+bool Snapshot_Restore(Snapshot* snapshot, VM* vm);
+// Used by VM_Destroy for stacks created by Snapshot_Clone
+void Snapshot_ReleaseStack(uint8_t* stack, uint64_t stackSize);
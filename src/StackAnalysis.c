@@ -0,0 +1,747 @@
+#include "StackAnalysis.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+
+ARRAY_IMPL(StackFunction, StackFunction);
+ARRAY_IMPL(StackCallSite, StackCallSite);
+
+// Sizes above this are not analyzed so the depths can never overflow
+#define STACK_ANALYSIS_MAX_SIZE ((uint64_t)1 << 40)
+
+// Only the most recently pushed code locations are remembered, a call location is usually pushed just before its arguments
+#define STACK_STATE_MAX_LOCATIONS 8
+
+typedef struct StackLocation {
+    // Where the 8 bytes of the location start on the stack, relative to the entry of the function
+    int64_t Depth;
+    uint64_t Location;
+} StackLocation;
+
+typedef struct StackState {
+    // Relative to the stack pointer the function was entered with, it is negative once the arguments are popped
+    int64_t Depth;
+    uint64_t LocationCount;
+    StackLocation Locations[STACK_STATE_MAX_LOCATIONS];
+} StackState;
+
+ARRAY_DECL(StackState, StackState);
+ARRAY_IMPL(StackState, StackState);
+ARRAY_DECL(uint64_t, CodeOffset);
+ARRAY_IMPL(uint64_t, CodeOffset);
+
+// Open addressing table from a code offset to an index into some other array
+typedef struct OffsetTable {
+    uint64_t* Offsets;
+    // Index + 1, so 0 is an empty slot
+    uint64_t* Indices;
+    uint64_t Count;
+    uint64_t Mask;
+} OffsetTable;
+
+static void OffsetTable_Create(OffsetTable* table, uint64_t capacity) {
+    table->Offsets = calloc(capacity, sizeof(uint64_t));
+    table->Indices = calloc(capacity, sizeof(uint64_t));
+    table->Count   = 0;
+    table->Mask    = capacity - 1;
+}
+
+static void OffsetTable_Destroy(OffsetTable* table) {
+    free(table->Offsets);
+    free(table->Indices);
+    *table = (OffsetTable){};
+}
+
+static uint64_t OffsetTable_Slot(OffsetTable* table, uint64_t offset) {
+    uint64_t hash = offset * 11400714819323198485ULL;
+    return (hash ^ (hash >> 32)) & table->Mask;
+}
+
+static bool OffsetTable_Find(OffsetTable* table, uint64_t offset, uint64_t* index) {
+    for (uint64_t slot = OffsetTable_Slot(table, offset); table->Indices[slot] != 0; slot = (slot + 1) & table->Mask) {
+        if (table->Offsets[slot] == offset) {
+            *index = table->Indices[slot] - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void OffsetTable_Insert(OffsetTable* table, uint64_t offset, uint64_t index) {
+    if ((table->Count + 1) * 2 > table->Mask + 1) {
+        OffsetTable old = *table;
+        OffsetTable_Create(table, (old.Mask + 1) * 2);
+        for (uint64_t i = 0; i <= old.Mask; i++) {
+            if (old.Indices[i] != 0) {
+                OffsetTable_Insert(table, old.Offsets[i], old.Indices[i] - 1);
+            }
+        }
+        OffsetTable_Destroy(&old);
+    }
+
+    uint64_t slot = OffsetTable_Slot(table, offset);
+    while (table->Indices[slot] != 0) {
+        slot = (slot + 1) & table->Mask;
+    }
+    table->Offsets[slot] = offset;
+    table->Indices[slot] = index + 1;
+    table->Count++;
+}
+
+static void StackState_Push(StackState* state, uint64_t size) {
+    state->Depth += (int64_t)size;
+}
+
+// Forgets the code locations that were popped
+static void StackState_Pop(StackState* state, uint64_t size) {
+    state->Depth -= (int64_t)size;
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < state->LocationCount; i++) {
+        if (state->Locations[i].Depth + (int64_t)sizeof(uint64_t) <= state->Depth) {
+            state->Locations[count++] = state->Locations[i];
+        }
+    }
+    state->LocationCount = count;
+}
+
+static void StackState_AddLocation(StackState* state, int64_t depth, uint64_t location) {
+    if (state->LocationCount == STACK_STATE_MAX_LOCATIONS) {
+        memmove(&state->Locations[0], &state->Locations[1], (STACK_STATE_MAX_LOCATIONS - 1) * sizeof(StackLocation));
+        state->LocationCount--;
+    }
+    state->Locations[state->LocationCount++] = (StackLocation){
+        .Depth    = depth,
+        .Location = location,
+    };
+}
+
+static bool StackState_GetLocation(StackState* state, int64_t depth, uint64_t* location) {
+    for (uint64_t i = 0; i < state->LocationCount; i++) {
+        if (state->Locations[i].Depth == depth) {
+            *location = state->Locations[i].Location;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Keeps only the code locations both states agree on, returns true if the state changed
+static bool StackState_Intersect(StackState* state, StackState* other) {
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < state->LocationCount; i++) {
+        uint64_t location;
+        if (StackState_GetLocation(other, state->Locations[i].Depth, &location) && location == state->Locations[i].Location) {
+            state->Locations[count++] = state->Locations[i];
+        }
+    }
+    bool changed         = count != state->LocationCount;
+    state->LocationCount = count;
+    return changed;
+}
+
+typedef struct StackAnalyzer {
+    StackAnalysis* Analysis;
+    uint8_t* Code;
+    uint64_t CodeSize;
+    // Set for the first byte of every label location in the code
+    bool* IsReference;
+    // From the location of a function to its index in the analysis
+    OffsetTable Functions;
+} StackAnalyzer;
+
+// A call of a function to itself, it continues at Next once the function is known to return somewhere else
+typedef struct StackSelfCall {
+    uint64_t Offset;
+    uint64_t Next;
+    int64_t Depth;
+} StackSelfCall;
+
+ARRAY_DECL(StackSelfCall, StackSelfCall);
+ARRAY_IMPL(StackSelfCall, StackSelfCall);
+
+// The paths through one function that still have to be followed
+typedef struct StackWalk {
+    StackStateArray States;
+    // From the offset of an instruction to the state before it
+    OffsetTable Visited;
+    CodeOffsetArray Work;
+    StackSelfCallArray SelfCalls;
+    // Set when the rest of the function cannot be followed
+    bool GaveUp;
+    StackFunction Result;
+} StackWalk;
+
+// The depth of the function has no bound, but its paths are still followed to find how it returns
+static void StackWalk_Unbound(StackWalk* walk, uint64_t offset, const char* reason) {
+    if (walk->Result.IsBounded) {
+        walk->Result.IsBounded       = false;
+        walk->Result.UnboundedAt     = offset;
+        walk->Result.UnboundedReason = reason;
+    }
+}
+
+static void StackWalk_GiveUp(StackWalk* walk, uint64_t offset, const char* reason) {
+    StackWalk_Unbound(walk, offset, reason);
+    walk->GaveUp = true;
+}
+
+static void StackWalk_Reach(StackWalk* walk, int64_t depth) {
+    if (depth > 0 && (uint64_t)depth > walk->Result.MaxDepth) {
+        walk->Result.MaxDepth = (uint64_t)depth;
+    }
+}
+
+static void StackWalk_Return(StackWalk* walk, uint64_t offset, int64_t depth, bool isSizeKnown, uint64_t size) {
+    if (!walk->Result.Returns) {
+        walk->Result.Returns           = true;
+        walk->Result.ReturnDepth       = depth;
+        walk->Result.IsReturnSizeKnown = isSizeKnown;
+        walk->Result.ReturnSize        = size;
+        return;
+    }
+    if (walk->Result.ReturnDepth != depth) {
+        StackWalk_GiveUp(walk, offset, "returns with different stack depths");
+    }
+    if (!isSizeKnown || walk->Result.ReturnSize != size) {
+        walk->Result.IsReturnSizeKnown = false;
+    }
+}
+
+static void StackWalk_Flow(StackAnalyzer* analyzer, StackWalk* walk, uint64_t from, uint64_t offset, StackState* state);
+
+// Self calls return like the function does, so they are followed once some other path returned
+// A path after a self call that returns differently makes the walk give up, so assuming the return up front is sound
+// Returns false when there is nothing left to follow
+static bool StackWalk_ReturnFromSelfCalls(StackAnalyzer* analyzer, StackWalk* walk, uint64_t functionIndex) {
+    if (!walk->Result.Returns) {
+        return false;
+    }
+    while (walk->SelfCalls.Length > 0 && !walk->GaveUp) {
+        StackSelfCall call = StackSelfCallArray_Pop(&walk->SelfCalls);
+        StackCallSiteArray_Push(&analyzer->Analysis->CallSites,
+                                (StackCallSite){
+                                    .Offset = call.Offset,
+                                    .Caller = functionIndex,
+                                    .Callee = functionIndex,
+                                });
+        StackState state = (StackState){
+            .Depth = call.Depth + walk->Result.ReturnDepth,
+        };
+        StackWalk_Flow(analyzer, walk, call.Offset, call.Next, &state);
+    }
+    return walk->Work.Length > 0 && !walk->GaveUp;
+}
+
+// Continues at offset with the state, every path to an instruction has to agree on the depth
+static void StackWalk_Flow(StackAnalyzer* analyzer, StackWalk* walk, uint64_t from, uint64_t offset, StackState* state) {
+    if (offset >= analyzer->CodeSize) {
+        StackWalk_GiveUp(walk, from, "jumps outside of the code");
+        return;
+    }
+
+    StackWalk_Reach(walk, state->Depth);
+
+    uint64_t index;
+    if (OffsetTable_Find(&walk->Visited, offset, &index)) {
+        StackState* existing = &walk->States.Data[index];
+        if (existing->Depth != state->Depth) {
+            StackWalk_GiveUp(walk, offset, "the stack depth depends on the path to this instruction");
+        } else if (StackState_Intersect(existing, state)) {
+            CodeOffsetArray_Push(&walk->Work, offset);
+        }
+        return;
+    }
+
+    OffsetTable_Insert(&walk->Visited, offset, walk->States.Length);
+    StackStateArray_Push(&walk->States, *state);
+    CodeOffsetArray_Push(&walk->Work, offset);
+}
+
+// The length of the instruction, or 0 if it is invalid or has sizes that are too large to analyze
+static uint64_t StackAnalyzer_GetInstructionLength(StackAnalyzer* analyzer, uint64_t offset) {
+    uint8_t* ip        = &analyzer->Code[offset];
+    uint64_t remaining = analyzer->CodeSize - offset;
+    if (*ip == Op_Push || *ip == Op_Data || *ip == Op_JumpTable || *ip == Op_CallCFunc) {
+        if (remaining < 1 + sizeof(uint64_t) || *(uint64_t*)(ip + 1) > STACK_ANALYSIS_MAX_SIZE) {
+            return 0;
+        }
+    }
+
+    if (*ip == Op_Extern) {
+        if (remaining < 1 + 2 * sizeof(uint64_t) || *(uint64_t*)(ip + 1 + sizeof(uint64_t)) > VM_MAX_EXTERN_ARGS) {
+            return 0;
+        }
+        uint64_t argCount = *(uint64_t*)(ip + 1 + sizeof(uint64_t));
+        if (remaining < 1 + (argCount + 4) * sizeof(uint64_t) ||
+            *(uint64_t*)(ip + 1 + (argCount + 3) * sizeof(uint64_t)) > STACK_ANALYSIS_MAX_SIZE) {
+            return 0;
+        }
+    }
+
+    uint64_t length = VM_GetInstructionLength(ip);
+    if (length == 0 || length > remaining) {
+        return 0;
+    }
+    // The function and the name of an extern are not sizes, the emitter already checked the rest
+    if (*ip == Op_Extern) {
+        return length;
+    }
+    // Every operand other than the bytes of a push or data is a size, a count or a location
+    uint64_t operandCount = *ip == Op_Push || *ip == Op_Data ? 1 : (length - 1) / sizeof(uint64_t);
+    for (uint64_t i = 0; i < operandCount; i++) {
+        if (*(uint64_t*)(ip + 1 + i * sizeof(uint64_t)) > STACK_ANALYSIS_MAX_SIZE) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+static uint64_t StackAnalyzer_GetFunction(StackAnalyzer* analyzer, uint64_t location);
+
+static void StackAnalyzer_AnalyzeFunction(StackAnalyzer* analyzer, uint64_t functionIndex) {
+    uint64_t entry = analyzer->Analysis->Functions.Data[functionIndex].Location;
+    analyzer->Analysis->Functions.Data[functionIndex].IsAnalyzing = true;
+
+    StackWalk walk = (StackWalk){
+        .States    = StackStateArray_Create(),
+        .Work      = CodeOffsetArray_Create(),
+        .SelfCalls = StackSelfCallArray_Create(),
+    };
+    walk.Result.Location  = entry;
+    walk.Result.IsBounded = true;
+    OffsetTable_Create(&walk.Visited, 64);
+
+    StackState start = (StackState){};
+    StackWalk_Flow(analyzer, &walk, entry, entry, &start);
+
+    while (!walk.GaveUp && (walk.Work.Length > 0 || StackWalk_ReturnFromSelfCalls(analyzer, &walk, functionIndex))) {
+        uint64_t offset = CodeOffsetArray_Pop(&walk.Work);
+        uint64_t index  = 0;
+        OffsetTable_Find(&walk.Visited, offset, &index);
+        StackState state = walk.States.Data[index];
+
+        uint64_t length = StackAnalyzer_GetInstructionLength(analyzer, offset);
+        if (length == 0) {
+            StackWalk_GiveUp(&walk, offset, "invalid instruction");
+            break;
+        }
+
+        uint8_t* ip   = &analyzer->Code[offset];
+        uint64_t a    = length >= 1 + sizeof(uint64_t) ? *(uint64_t*)(ip + 1) : 0;
+        uint64_t b    = length >= 1 + 2 * sizeof(uint64_t) ? *(uint64_t*)(ip + 1 + sizeof(uint64_t)) : 0;
+        uint64_t next = offset + length;
+
+        bool fallsThrough = true;
+
+        switch ((Op)*ip) {
+            case Op_Exit: {
+                fallsThrough = false;
+            } break;
+
+            case Op_Checkpoint:
+            case Op_HeapReset:
+            case Op_TimerBegin:
+            case Op_TimerEnd: {
+            } break;
+
+            case Op_Push: {
+                if (a == sizeof(uint64_t) && analyzer->IsReference[offset + 1 + sizeof(uint64_t)]) {
+                    StackState_AddLocation(&state, state.Depth, *(uint64_t*)(ip + 1 + sizeof(uint64_t)));
+                }
+                StackState_Push(&state, a);
+            } break;
+
+            case Op_AllocStack:
+            case Op_GetStackTop:
+            case Op_GetStackBottom: {
+                StackState_Push(&state, *ip == Op_AllocStack ? a : sizeof(uint64_t));
+            } break;
+
+            case Op_Pop:
+            case Op_Print:
+            case Op_PrintFloat: {
+                StackState_Pop(&state, a);
+            } break;
+
+            case Op_Dup: {
+                int64_t start  = state.Depth - (int64_t)a;
+                uint64_t count = state.LocationCount;
+                for (uint64_t i = 0; i < count; i++) {
+                    StackLocation location = state.Locations[i];
+                    if (location.Depth >= start) {
+                        StackState_AddLocation(&state, location.Depth + (int64_t)a, location.Location);
+                    }
+                }
+                StackState_Push(&state, a);
+            } break;
+
+            case Op_Add:
+            case Op_Sub:
+            case Op_Mul:
+            case Op_DivSigned:
+            case Op_DivUnsigned:
+            case Op_ModSigned:
+            case Op_ModUnsigned:
+            case Op_And:
+            case Op_Or:
+            case Op_Xor:
+            case Op_ShiftLeft:
+            case Op_ShiftRight:
+            case Op_ShiftRightArith:
+            case Op_FloatAdd:
+            case Op_FloatSub:
+            case Op_FloatMul:
+            case Op_FloatDiv: {
+                StackState_Pop(&state, 2 * a);
+                StackState_Push(&state, a);
+            } break;
+
+            case Op_Not:
+            case Op_FloatSqrt: {
+                StackState_Pop(&state, a);
+                StackState_Push(&state, a);
+            } break;
+
+            case Op_Equal:
+            case Op_LessSigned:
+            case Op_LessUnsigned:
+            case Op_LessEqualSigned:
+            case Op_LessEqualUnsigned:
+            case Op_FloatEqual:
+            case Op_FloatLess:
+            case Op_FloatLessEqual: {
+                StackState_Pop(&state, 2 * a);
+                StackState_Push(&state, sizeof(uint8_t));
+            } break;
+
+            case Op_IntToFloat:
+            case Op_FloatToInt: {
+                StackState_Pop(&state, a);
+                StackState_Push(&state, b);
+            } break;
+
+            case Op_VecAdd:
+            case Op_VecSub:
+            case Op_VecMin:
+            case Op_VecMax:
+            case Op_VecEqual:
+            case Op_VecLess: {
+                StackState_Pop(&state, 2 * b);
+                StackState_Push(&state, b);
+            } break;
+
+            case Op_Load: {
+                StackState_Pop(&state, sizeof(uint64_t));
+                StackState_Push(&state, a);
+            } break;
+
+            // Anything on the stack may be written through the pointer, so the known locations are forgotten
+            case Op_Store: {
+                StackState_Pop(&state, a + sizeof(uint64_t));
+                state.LocationCount = 0;
+            } break;
+
+            case Op_MemCopy:
+            case Op_MemMove: {
+                StackState_Pop(&state, 3 * sizeof(uint64_t));
+                state.LocationCount = 0;
+            } break;
+
+            case Op_MemSet: {
+                StackState_Pop(&state, 2 * sizeof(uint64_t) + sizeof(uint8_t));
+                state.LocationCount = 0;
+            } break;
+
+            case Op_VecAddBuffer:
+            case Op_VecSubBuffer:
+            case Op_VecMinBuffer:
+            case Op_VecMaxBuffer:
+            case Op_VecEqualBuffer:
+            case Op_VecLessBuffer: {
+                StackState_Pop(&state, 4 * sizeof(uint64_t));
+                state.LocationCount = 0;
+            } break;
+
+            case Op_IoOpen: {
+                StackState_Pop(&state, 3 * sizeof(uint64_t));
+                StackState_Push(&state, sizeof(uint64_t));
+            } break;
+
+            case Op_IoRead:
+            case Op_IoWrite: {
+                StackState_Pop(&state, 4 * sizeof(uint64_t));
+                StackState_Push(&state, sizeof(uint64_t));
+                state.LocationCount = 0;
+            } break;
+
+            case Op_IoClose: {
+                StackState_Pop(&state, sizeof(uint64_t));
+            } break;
+
+            case Op_HeapAlloc: {
+                StackState_Pop(&state, sizeof(uint64_t));
+                StackState_Push(&state, sizeof(uint64_t));
+            } break;
+
+            case Op_HeapFree: {
+                StackState_Pop(&state, sizeof(uint64_t));
+            } break;
+
+            case Op_CallCFunc: {
+                uint64_t argSize = 0;
+                for (uint64_t i = 0; i < a; i++) {
+                    argSize += *(uint64_t*)(ip + 1 + (i + 1) * sizeof(uint64_t));
+                }
+                uint64_t retSize = *(uint64_t*)(ip + 1 + (a + 1) * sizeof(uint64_t));
+                StackState_Pop(&state, argSize + sizeof(uint64_t));
+                StackState_Push(&state, retSize);
+            } break;
+
+            case Op_Extern:
+            case Op_Data: {
+            } break;
+
+            case Op_PushData: {
+                StackState_Push(&state, sizeof(uint64_t));
+            } break;
+
+            case Op_CallExtern: {
+                if (a >= analyzer->CodeSize || analyzer->Code[a] != Op_Extern || StackAnalyzer_GetInstructionLength(analyzer, a) == 0) {
+                    StackWalk_GiveUp(&walk, offset, "call-extern to a location that is not an extern");
+                    break;
+                }
+                uint64_t* declaration = (uint64_t*)&analyzer->Code[a + 1];
+                uint64_t argCount     = declaration[1];
+                uint64_t argSize      = 0;
+                for (uint64_t i = 0; i < argCount; i++) {
+                    argSize += declaration[2 + i];
+                }
+                StackState_Pop(&state, argSize);
+                StackState_Push(&state, declaration[2 + argCount]);
+            } break;
+
+            case Op_Jump: {
+                StackWalk_Flow(analyzer, &walk, offset, a, &state);
+                fallsThrough = false;
+            } break;
+
+            case Op_JumpDyn: {
+                uint64_t location;
+                if (!StackState_GetLocation(&state, state.Depth - (int64_t)sizeof(uint64_t), &location)) {
+                    StackWalk_GiveUp(&walk, offset, "jump-dyn to a location that is not known");
+                    break;
+                }
+                StackState_Pop(&state, sizeof(uint64_t));
+                StackWalk_Flow(analyzer, &walk, offset, location, &state);
+                fallsThrough = false;
+            } break;
+
+            case Op_JumpZero:
+            case Op_JumpNonZero: {
+                StackState_Pop(&state, a);
+                StackWalk_Flow(analyzer, &walk, offset, b, &state);
+            } break;
+
+            case Op_JumpEqual:
+            case Op_JumpNotEqual:
+            case Op_JumpLessSigned:
+            case Op_JumpLessUnsigned:
+            case Op_JumpLessEqualSigned:
+            case Op_JumpLessEqualUnsigned: {
+                StackState_Pop(&state, 2 * a);
+                StackWalk_Flow(analyzer, &walk, offset, b, &state);
+            } break;
+
+            case Op_JumpTable: {
+                StackState_Pop(&state, sizeof(uint64_t));
+                for (uint64_t i = 0; i < a; i++) {
+                    StackWalk_Flow(analyzer, &walk, offset, *(uint64_t*)(ip + 1 + (i + 1) * sizeof(uint64_t)), &state);
+                }
+            } break;
+
+            case Op_Call: {
+                // The return location takes the place of the call location, so the callee starts at the current depth
+                uint64_t location;
+                if (!StackState_GetLocation(&state, state.Depth - (int64_t)a - (int64_t)sizeof(uint64_t), &location)) {
+                    StackWalk_GiveUp(&walk, offset, "calls a location that is not known");
+                    break;
+                }
+
+                if (location == entry) {
+                    StackWalk_Unbound(&walk, offset, "recursive call");
+                    StackSelfCallArray_Push(&walk.SelfCalls,
+                                            (StackSelfCall){
+                                                .Offset = offset,
+                                                .Next   = next,
+                                                .Depth  = state.Depth,
+                                            });
+                    fallsThrough = false;
+                    break;
+                }
+
+                // Analyzing the callee may move the functions, so the index is taken first
+                uint64_t calleeIndex = StackAnalyzer_GetFunction(analyzer, location);
+                StackFunction callee = analyzer->Analysis->Functions.Data[calleeIndex];
+                if (callee.IsAnalyzing) {
+                    StackWalk_GiveUp(&walk, offset, "recursive call");
+                    break;
+                }
+                if (!callee.IsComplete) {
+                    StackWalk_GiveUp(&walk, offset, "calls a function that is not bounded");
+                    break;
+                }
+                if (!callee.IsBounded) {
+                    StackWalk_Unbound(&walk, offset, "calls a function that is not bounded");
+                }
+
+                StackWalk_Reach(&walk, state.Depth + (int64_t)callee.MaxDepth);
+                if (!callee.Returns) {
+                    fallsThrough = false;
+                    break;
+                }
+                StackCallSiteArray_Push(&analyzer->Analysis->CallSites,
+                                        (StackCallSite){
+                                            .Offset = offset,
+                                            .Caller = functionIndex,
+                                            .Callee = calleeIndex,
+                                        });
+
+                // The callee may have written to anything on the stack
+                int64_t depth       = state.Depth + callee.ReturnDepth;
+                state.LocationCount = 0;
+                state.Depth         = depth;
+            } break;
+
+            case Op_Ret: {
+                StackWalk_Return(&walk, offset, state.Depth - (int64_t)sizeof(uint64_t), true, a);
+                fallsThrough = false;
+            } break;
+
+            case Op_TailCall: {
+                // The call location is removed and the callee returns for this function
+                uint64_t location;
+                if (!StackState_GetLocation(&state, state.Depth - (int64_t)a - (int64_t)sizeof(uint64_t), &location)) {
+                    StackWalk_GiveUp(&walk, offset, "calls a location that is not known");
+                    break;
+                }
+                fallsThrough = false;
+
+                int64_t depth       = state.Depth - (int64_t)sizeof(uint64_t);
+                state.LocationCount = 0;
+                state.Depth         = depth;
+
+                // A tail call to the function itself is a loop
+                if (location == entry) {
+                    StackWalk_Flow(analyzer, &walk, offset, entry, &state);
+                    break;
+                }
+
+                // Analyzing the callee may move the functions, so the index is taken first
+                uint64_t calleeIndex = StackAnalyzer_GetFunction(analyzer, location);
+                StackFunction callee = analyzer->Analysis->Functions.Data[calleeIndex];
+                if (callee.IsAnalyzing) {
+                    StackWalk_GiveUp(&walk, offset, "recursive call");
+                    break;
+                }
+                if (!callee.IsComplete) {
+                    StackWalk_GiveUp(&walk, offset, "calls a function that is not bounded");
+                    break;
+                }
+                if (!callee.IsBounded) {
+                    StackWalk_Unbound(&walk, offset, "calls a function that is not bounded");
+                }
+
+                StackWalk_Reach(&walk, depth + (int64_t)callee.MaxDepth);
+                if (callee.Returns) {
+                    StackWalk_Return(&walk, offset, depth + callee.ReturnDepth, callee.IsReturnSizeKnown, callee.ReturnSize);
+                }
+            } break;
+
+            default: {
+                StackWalk_GiveUp(&walk, offset, "invalid instruction");
+            } break;
+        }
+
+        if (fallsThrough && !walk.GaveUp) {
+            StackWalk_Flow(analyzer, &walk, offset, next, &state);
+        }
+    }
+
+    StackStateArray_Destroy(&walk.States);
+    CodeOffsetArray_Destroy(&walk.Work);
+    StackSelfCallArray_Destroy(&walk.SelfCalls);
+    OffsetTable_Destroy(&walk.Visited);
+    walk.Result.IsComplete = !walk.GaveUp;
+
+    // Analyzing the callees may have moved the functions
+    analyzer->Analysis->Functions.Data[functionIndex] = walk.Result;
+}
+
+static uint64_t StackAnalyzer_GetFunction(StackAnalyzer* analyzer, uint64_t location) {
+    uint64_t index;
+    if (OffsetTable_Find(&analyzer->Functions, location, &index)) {
+        return index;
+    }
+
+    index = analyzer->Analysis->Functions.Length;
+    StackFunctionArray_Push(&analyzer->Analysis->Functions,
+                            (StackFunction){
+                                .Location = location,
+                            });
+    OffsetTable_Insert(&analyzer->Functions, location, index);
+    StackAnalyzer_AnalyzeFunction(analyzer, index);
+    return index;
+}
+
+void StackAnalysis_Analyze(StackAnalysis* analysis, Emitter* emitter) {
+    *analysis           = (StackAnalysis){};
+    analysis->Functions = StackFunctionArray_Create();
+    analysis->CallSites = StackCallSiteArray_Create();
+    analysis->IsBounded = true;
+    if (emitter->Code.Length == 0) {
+        return;
+    }
+
+    StackAnalyzer analyzer = (StackAnalyzer){
+        .Analysis    = analysis,
+        .Code        = emitter->Code.Data,
+        .CodeSize    = emitter->Code.Length,
+        .IsReference = calloc(emitter->Code.Length, sizeof(bool)),
+    };
+    OffsetTable_Create(&analyzer.Functions, 16);
+    for (uint64_t i = 0; i < emitter->References.Length; i++) {
+        analyzer.IsReference[emitter->References.Data[i].IndexForAddress] = true;
+    }
+
+    StackAnalyzer_GetFunction(&analyzer, 0);
+    analysis->IsBounded = analysis->Functions.Data[0].IsBounded;
+    analysis->MaxDepth  = analysis->Functions.Data[0].MaxDepth;
+
+    OffsetTable_Destroy(&analyzer.Functions);
+    free(analyzer.IsReference);
+}
+
+void StackAnalysis_Destroy(StackAnalysis* analysis) {
+    StackFunctionArray_Destroy(&analysis->Functions);
+    StackCallSiteArray_Destroy(&analysis->CallSites);
+    *analysis = (StackAnalysis){};
+}
+
+void StackAnalysis_Print(StackAnalysis* analysis) {
+    for (uint64_t i = 0; i < analysis->Functions.Length; i++) {
+        StackFunction* function = &analysis->Functions.Data[i];
+        const char* kind        = i == 0 ? "Entry" : "Function";
+        if (function->IsBounded) {
+            printf("%s at %llu: %llu bytes\n", kind, function->Location, function->MaxDepth);
+        } else {
+            printf("%s at %llu: unbounded, %s at %llu\n", kind, function->Location, function->UnboundedReason, function->UnboundedAt);
+        }
+    }
+
+    if (analysis->IsBounded) {
+        printf("Program: %llu bytes\n", analysis->MaxDepth);
+    } else {
+        printf("Program: unbounded\n");
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Emitter.h"
+
+// A piece of code that is entered through a call, the entry of the program is treated as one as well
+typedef struct StackFunction {
+    // Where the function starts in the code
+    uint64_t Location;
+    bool IsBounded;
+    // Set when every path through the function was followed, Returns and what follows are known even if it is not bounded
+    bool IsComplete;
+    // The most bytes the function and everything it calls has above the stack pointer the function was entered with
+    uint64_t MaxDepth;
+    // Where the stack pointer is after the function returned, relative to where it was when the function was entered
+    bool Returns;
+    int64_t ReturnDepth;
+    // Set when every ret of the function returns ReturnSize bytes
+    bool IsReturnSizeKnown;
+    uint64_t ReturnSize;
+    // When the function is not bounded, the instruction where the analysis gave up and why
+    uint64_t UnboundedAt;
+    const char* UnboundedReason;
+    // Set while the function is being analyzed, a call to it then is a recursive call
+    bool IsAnalyzing;
+} StackFunction;
+
+ARRAY_DECL(StackFunction, StackFunction);
+
+// A call whose target the analysis knows and that returns, the indices are into the functions of the analysis
+typedef struct StackCallSite {
+    uint64_t Offset;
+    uint64_t Caller;
+    uint64_t Callee;
+} StackCallSite;
+
+ARRAY_DECL(StackCallSite, StackCallSite);
+
+typedef struct StackAnalysis {
+    // Every function in the order it was found, the first one is the entry of the program
+    StackFunctionArray Functions;
+    // Only the call sites of bounded functions are complete, the walk of the others stopped early
+    StackCallSiteArray CallSites;
+    // The bound of the whole program, a stack of MaxDepth bytes is enough to run it when IsBounded is set
+    bool IsBounded;
+    uint64_t MaxDepth;
+} StackAnalysis;
+
+// Runs over the code of an emitter after Optimizer_Optimize, the code is not changed
+// Call and jump-dyn targets are only known when they were pushed from a label in the same function
+// Recursion, unknown targets and loops that change the stack depth make a function and its callers unbounded
+void StackAnalysis_Analyze(StackAnalysis* analysis, Emitter* emitter);
+void StackAnalysis_Destroy(StackAnalysis* analysis);
+void StackAnalysis_Print(StackAnalysis* analysis);
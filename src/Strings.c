@@ -26,3 +26,12 @@ bool String_Equal(String a, String b) {
 
     return true;
 }
+
+uint64_t String_Hash(String string) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint64_t i = 0; i < string.Length; i++) {
+        hash ^= string.Data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
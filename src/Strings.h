@@ -18,3 +18,5 @@ typedef struct String {
 
 String String_FromCString(const char* cstring);
 bool String_Equal(String a, String b);
+// FNV-1a, fast for the short names and source sections it is used on
+uint64_t String_Hash(String string);
@@ -0,0 +1,453 @@
+#include "Tier.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+
+ARRAY_IMPL(TierInst, TierInst);
+ARRAY_IMPL(TierLoop, TierLoop);
+
+// Counts above the threshold are not counts anymore, the loop was either compiled or cannot be
+#define TIER_COMPILED       (TIER_HOT_LOOP_THRESHOLD + 1)
+#define TIER_NOT_COMPILABLE UINT32_MAX
+
+#define TIER_KEY(op, sizeLog2) ((uint16_t)((op) << 2 | (sizeLog2)))
+
+#define PUSH_STACK(ptr, type, value) \
+    do {                             \
+        *(type*)(ptr) = (value);     \
+        (ptr) += sizeof(type);       \
+    } while (0)
+#define POP_STACK(ptr, type) (((ptr) -= sizeof(type)), *(type*)(ptr))
+
+// Raises the local high water mark over a store through a pointer into the stack, like RaiseHighWater in VM.c
+#define TIER_RAISE_HIGH_WATER(ptr, size)                                         \
+    do {                                                                         \
+        uint64_t offset = (uint64_t)((uint8_t*)(ptr) - vm->Stack);               \
+        if (offset < vm->StackSize && vm->Stack + offset + (size) > highWater) { \
+            highWater = vm->Stack + offset + (size);                             \
+        }                                                                        \
+    } while (0)
+
+// Expands to the switch cases for each integer size of the op, stmt is run with T as the integer type
+#define TIER_INTEGER_CASES(op, sign, stmt) \
+    case TIER_KEY(op, 0): {                \
+        typedef sign##8_t T;               \
+        stmt;                              \
+    } break;                               \
+    case TIER_KEY(op, 1): {                \
+        typedef sign##16_t T;              \
+        stmt;                              \
+    } break;                               \
+    case TIER_KEY(op, 2): {                \
+        typedef sign##32_t T;              \
+        stmt;                              \
+    } break;                               \
+    case TIER_KEY(op, 3): {                \
+        typedef sign##64_t T;              \
+        stmt;                              \
+    } break
+
+#define TIER_FLOAT_CASES(op, stmt) \
+    case TIER_KEY(op, 2): {        \
+        typedef float T;           \
+        stmt;                      \
+    } break;                       \
+    case TIER_KEY(op, 3): {        \
+        typedef double T;          \
+        stmt;                      \
+    } break
+
+#define TIER_BINARY(stmt)   \
+    T b = POP_STACK(sp, T); \
+    T a = POP_STACK(sp, T); \
+    stmt
+
+// Hands the VM back to the interpreter, which continues at the location
+#define TIER_LEAVE(location)                        \
+    do {                                            \
+        vm->Ip             = vm->Code + (location); \
+        vm->Sp             = sp;                    \
+        vm->StackHighWater = highWater;             \
+        return true;                                \
+    } while (0)
+
+// Hands the VM back to the interpreter at the location, and VM_Run returns stopResult right away
+#define TIER_STOP(location, stopResult)             \
+    do {                                            \
+        vm->Ip             = vm->Code + (location); \
+        vm->Sp             = sp;                    \
+        vm->StackHighWater = highWater;             \
+        *result            = (stopResult);          \
+        return false;                               \
+    } while (0)
+
+// Spends fuel on backward jumps like the interpreter, the interpreter continues at the target when it leaves the loop
+#define TIER_JUMP()                                         \
+    do {                                                    \
+        if (inst->IsBackward) {                             \
+            if (vm->Fuel == 0) {                            \
+                TIER_STOP(inst->Operand, VMResult_Yielded); \
+            }                                               \
+            vm->Fuel--;                                     \
+        }                                                   \
+        if (inst->Jump == TIER_EXIT) {                      \
+            TIER_LEAVE(inst->Operand);                      \
+        }                                                   \
+        next = &insts[inst->Jump];                          \
+    } while (0)
+
+#define TIER_DIVISION_BY_ZERO_CHECK(b)           \
+    if ((b) == 0) {                              \
+        fflush(stdout);                          \
+        fprintf(stderr, "Division by zero\n");   \
+        TIER_STOP(inst->Offset, VMResult_Error); \
+    }
+
+static bool Tier_SizeLog2(uint64_t size, uint16_t* sizeLog2) {
+    switch (size) {
+        case 1: {
+            *sizeLog2 = 0;
+        } break;
+
+        case 2: {
+            *sizeLog2 = 1;
+        } break;
+
+        case 4: {
+            *sizeLog2 = 2;
+        } break;
+
+        case 8: {
+            *sizeLog2 = 3;
+        } break;
+
+        default: {
+            return false;
+        } break;
+    }
+    return true;
+}
+
+static bool IsJump(uint8_t op) {
+    return op == Op_Jump || op == Op_JumpZero || op == Op_JumpNonZero || (op >= Op_JumpEqual && op <= Op_JumpLessEqualUnsigned);
+}
+
+// Returns false for instructions the tier does not run, the loop is left there
+static bool Tier_Decode(const uint8_t* ip, uint64_t offset, uint64_t length, TierInst* inst) {
+    uint8_t op    = *ip;
+    uint64_t size = 0;
+    if (length >= 1 + sizeof(uint64_t)) {
+        memcpy(&size, ip + 1, sizeof(size));
+    }
+    uint16_t sizeLog2;
+
+    *inst = (TierInst){
+        .Jump   = TIER_EXIT,
+        .Offset = offset,
+    };
+    switch (op) {
+        case Op_Pop: {
+            inst->Key     = TIER_KEY(op, 0);
+            inst->Operand = size;
+        } break;
+
+        case Op_GetStackTop:
+        case Op_GetStackBottom: {
+            inst->Key = TIER_KEY(op, 0);
+        } break;
+
+        case Op_Jump: {
+            inst->Key     = TIER_KEY(op, 0);
+            inst->Operand = size;
+        } break;
+
+        case Op_Push: {
+            if (!Tier_SizeLog2(size, &sizeLog2)) {
+                return false;
+            }
+            inst->Key = TIER_KEY(op, sizeLog2);
+            memcpy(&inst->Operand, ip + 1 + sizeof(uint64_t), size);
+        } break;
+
+        case Op_Dup:
+        case Op_Load:
+        case Op_Store:
+        case Op_Add:
+        case Op_Sub:
+        case Op_Mul:
+        case Op_DivSigned:
+        case Op_DivUnsigned:
+        case Op_ModSigned:
+        case Op_ModUnsigned:
+        case Op_And:
+        case Op_Or:
+        case Op_Xor:
+        case Op_Not:
+        case Op_ShiftLeft:
+        case Op_ShiftRight:
+        case Op_ShiftRightArith:
+        case Op_Equal:
+        case Op_LessSigned:
+        case Op_LessUnsigned:
+        case Op_LessEqualSigned:
+        case Op_LessEqualUnsigned: {
+            if (!Tier_SizeLog2(size, &sizeLog2)) {
+                return false;
+            }
+            inst->Key = TIER_KEY(op, sizeLog2);
+        } break;
+
+        case Op_FloatAdd:
+        case Op_FloatSub:
+        case Op_FloatMul:
+        case Op_FloatDiv:
+        case Op_FloatEqual:
+        case Op_FloatLess:
+        case Op_FloatLessEqual: {
+            if ((size != 4 && size != 8) || !Tier_SizeLog2(size, &sizeLog2)) {
+                return false;
+            }
+            inst->Key = TIER_KEY(op, sizeLog2);
+        } break;
+
+        case Op_JumpZero:
+        case Op_JumpNonZero:
+        case Op_JumpEqual:
+        case Op_JumpNotEqual:
+        case Op_JumpLessSigned:
+        case Op_JumpLessUnsigned:
+        case Op_JumpLessEqualSigned:
+        case Op_JumpLessEqualUnsigned: {
+            if (!Tier_SizeLog2(size, &sizeLog2)) {
+                return false;
+            }
+            inst->Key = TIER_KEY(op, sizeLog2);
+            memcpy(&inst->Operand, ip + 1 + sizeof(uint64_t), sizeof(uint64_t));
+        } break;
+
+        default: {
+            return false;
+        } break;
+    }
+
+    if (IsJump(op)) {
+        // The same rule as the interpreter, which compares against the end of the jump
+        inst->IsBackward = inst->Operand <= offset + length;
+    }
+    return true;
+}
+
+// Decodes the loop once, jumps to instructions inside of it are resolved to their index so they never leave the tier
+static uint32_t Tier_Compile(Tier* tier, const uint8_t* code, uint64_t codeSize, uint64_t header, uint64_t loopEnd) {
+    TierInstArray insts = TierInstArray_Create();
+    uint64_t offset     = header;
+    while (offset < loopEnd) {
+        uint64_t length = VM_GetInstructionLength(&code[offset]);
+        if (length == 0 || length > codeSize - offset) {
+            // The interpreter reports it when it gets there
+            break;
+        }
+
+        TierInst inst;
+        if (!Tier_Decode(&code[offset], offset, length, &inst)) {
+            inst = (TierInst){
+                .Jump   = TIER_EXIT,
+                .Offset = offset,
+            };
+        }
+        TierInstArray_Push(&insts, inst);
+        offset += length;
+    }
+    // Running off the end of the loop continues in the interpreter
+    TierInstArray_Push(&insts,
+                       (TierInst){
+                           .Jump   = TIER_EXIT,
+                           .Offset = offset,
+                       });
+
+    // A loop that would be left right away is not worth entering
+    if (insts.Data[0].Key == 0) {
+        TierInstArray_Destroy(&insts);
+        return TIER_NOT_COMPILABLE;
+    }
+
+    for (uint64_t i = 0; i < insts.Length; i++) {
+        TierInst* inst = &insts.Data[i];
+        if (!IsJump(inst->Key >> 2)) {
+            continue;
+        }
+
+        // The instructions are in code order so the target is found with a binary search
+        uint64_t low  = 0;
+        uint64_t high = insts.Length - 1;
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            if (insts.Data[middle].Offset < inst->Operand) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        // The last instruction is where the loop is left, jumping there leaves the loop as well
+        if (low < insts.Length - 1 && insts.Data[low].Offset == inst->Operand) {
+            inst->Jump = (uint32_t)low;
+        }
+    }
+
+    uint64_t index = tier->Loops.Length;
+    TierLoopArray_Push(&tier->Loops,
+                       (TierLoop){
+                           .Header = header,
+                           .Insts  = insts,
+                       });
+    return TIER_COMPILED + (uint32_t)index;
+}
+
+static bool Tier_Run(VM* vm, TierLoop* loop, VMResult* result) {
+    TierInst* insts    = loop->Insts.Data;
+    TierInst* inst     = insts;
+    uint8_t* sp        = vm->Sp;
+    uint8_t* highWater = vm->StackHighWater;
+
+    while (true) {
+        if (sp > highWater) {
+            highWater = sp;
+        }
+
+        // Below the stack wraps around to a huge offset, so one compare checks both ends
+        if ((uint64_t)(sp - vm->Stack) > vm->StackSize) {
+            fflush(stdout);
+            fprintf(stderr, "Stack pointer out of range\n");
+            TIER_STOP(inst->Offset, VMResult_Error);
+        }
+
+        TierInst* next = inst + 1;
+        switch (inst->Key) {
+            case TIER_KEY(Op_Pop, 0): {
+                sp -= inst->Operand;
+            } break;
+
+            case TIER_KEY(Op_GetStackTop, 0): {
+                void* ptr = sp;
+                PUSH_STACK(sp, void*, ptr);
+            } break;
+
+            case TIER_KEY(Op_GetStackBottom, 0): {
+                void* ptr = vm->Stack;
+                PUSH_STACK(sp, void*, ptr);
+            } break;
+
+            case TIER_KEY(Op_Jump, 0): {
+                TIER_JUMP();
+            } break;
+
+            TIER_INTEGER_CASES(Op_Push, uint, PUSH_STACK(sp, T, (T)inst->Operand));
+            TIER_INTEGER_CASES(Op_Dup, uint, T value = *(T*)(sp - sizeof(T)); PUSH_STACK(sp, T, value));
+            TIER_INTEGER_CASES(Op_Load, uint, T* ptr = POP_STACK(sp, T*); PUSH_STACK(sp, T, *ptr));
+            TIER_INTEGER_CASES(Op_Store,
+                               uint,
+                               T value = POP_STACK(sp, T);
+                               T* ptr  = POP_STACK(sp, T*);
+                               TIER_RAISE_HIGH_WATER(ptr, sizeof(T));
+                               *ptr = value);
+
+            TIER_INTEGER_CASES(Op_Add, uint, TIER_BINARY(PUSH_STACK(sp, T, a + b)));
+            TIER_INTEGER_CASES(Op_Sub, uint, TIER_BINARY(PUSH_STACK(sp, T, a - b)));
+            TIER_INTEGER_CASES(Op_Mul, uint, TIER_BINARY(PUSH_STACK(sp, T, (T)((uint64_t)a * (uint64_t)b))));
+            TIER_INTEGER_CASES(Op_DivSigned,
+                               int,
+                               TIER_BINARY(TIER_DIVISION_BY_ZERO_CHECK(b);
+                                           PUSH_STACK(sp, T, b == -1 ? (T)(0 - (uint64_t)a) : (T)(a / b))));
+            TIER_INTEGER_CASES(Op_DivUnsigned, uint, TIER_BINARY(TIER_DIVISION_BY_ZERO_CHECK(b); PUSH_STACK(sp, T, a / b)));
+            TIER_INTEGER_CASES(Op_ModSigned,
+                               int,
+                               TIER_BINARY(TIER_DIVISION_BY_ZERO_CHECK(b); PUSH_STACK(sp, T, b == -1 ? 0 : (T)(a % b))));
+            TIER_INTEGER_CASES(Op_ModUnsigned, uint, TIER_BINARY(TIER_DIVISION_BY_ZERO_CHECK(b); PUSH_STACK(sp, T, a % b)));
+            TIER_INTEGER_CASES(Op_And, uint, TIER_BINARY(PUSH_STACK(sp, T, a & b)));
+            TIER_INTEGER_CASES(Op_Or, uint, TIER_BINARY(PUSH_STACK(sp, T, a | b)));
+            TIER_INTEGER_CASES(Op_Xor, uint, TIER_BINARY(PUSH_STACK(sp, T, a ^ b)));
+            TIER_INTEGER_CASES(Op_Not, uint, T a = POP_STACK(sp, T); PUSH_STACK(sp, T, (T)~a));
+            TIER_INTEGER_CASES(Op_ShiftLeft, uint, TIER_BINARY(PUSH_STACK(sp, T, (T)(a << (b & (sizeof(T) * 8 - 1))))));
+            TIER_INTEGER_CASES(Op_ShiftRight, uint, TIER_BINARY(PUSH_STACK(sp, T, (T)(a >> (b & (sizeof(T) * 8 - 1))))));
+            TIER_INTEGER_CASES(Op_ShiftRightArith, int, TIER_BINARY(PUSH_STACK(sp, T, (T)(a >> (b & (sizeof(T) * 8 - 1))))));
+
+            TIER_INTEGER_CASES(Op_Equal, uint, TIER_BINARY(PUSH_STACK(sp, uint8_t, a == b)));
+            TIER_INTEGER_CASES(Op_LessSigned, int, TIER_BINARY(PUSH_STACK(sp, uint8_t, a < b)));
+            TIER_INTEGER_CASES(Op_LessUnsigned, uint, TIER_BINARY(PUSH_STACK(sp, uint8_t, a < b)));
+            TIER_INTEGER_CASES(Op_LessEqualSigned, int, TIER_BINARY(PUSH_STACK(sp, uint8_t, a <= b)));
+            TIER_INTEGER_CASES(Op_LessEqualUnsigned, uint, TIER_BINARY(PUSH_STACK(sp, uint8_t, a <= b)));
+
+            TIER_INTEGER_CASES(Op_JumpZero, uint, T a = POP_STACK(sp, T); if (a == 0) { TIER_JUMP(); });
+            TIER_INTEGER_CASES(Op_JumpNonZero, uint, T a = POP_STACK(sp, T); if (a != 0) { TIER_JUMP(); });
+            TIER_INTEGER_CASES(Op_JumpEqual, uint, TIER_BINARY(if (a == b) { TIER_JUMP(); }));
+            TIER_INTEGER_CASES(Op_JumpNotEqual, uint, TIER_BINARY(if (a != b) { TIER_JUMP(); }));
+            TIER_INTEGER_CASES(Op_JumpLessSigned, int, TIER_BINARY(if (a < b) { TIER_JUMP(); }));
+            TIER_INTEGER_CASES(Op_JumpLessUnsigned, uint, TIER_BINARY(if (a < b) { TIER_JUMP(); }));
+            TIER_INTEGER_CASES(Op_JumpLessEqualSigned, int, TIER_BINARY(if (a <= b) { TIER_JUMP(); }));
+            TIER_INTEGER_CASES(Op_JumpLessEqualUnsigned, uint, TIER_BINARY(if (a <= b) { TIER_JUMP(); }));
+
+            TIER_FLOAT_CASES(Op_FloatAdd, TIER_BINARY(PUSH_STACK(sp, T, a + b)));
+            TIER_FLOAT_CASES(Op_FloatSub, TIER_BINARY(PUSH_STACK(sp, T, a - b)));
+            TIER_FLOAT_CASES(Op_FloatMul, TIER_BINARY(PUSH_STACK(sp, T, a * b)));
+            TIER_FLOAT_CASES(Op_FloatDiv, TIER_BINARY(PUSH_STACK(sp, T, a / b)));
+            TIER_FLOAT_CASES(Op_FloatEqual, TIER_BINARY(PUSH_STACK(sp, uint8_t, a == b)));
+            TIER_FLOAT_CASES(Op_FloatLess, TIER_BINARY(PUSH_STACK(sp, uint8_t, a < b)));
+            TIER_FLOAT_CASES(Op_FloatLessEqual, TIER_BINARY(PUSH_STACK(sp, uint8_t, a <= b)));
+
+            default: {
+                // Deoptimizes, the interpreter runs the instruction and comes back at the next backward jump to a hot loop
+                TIER_LEAVE(inst->Offset);
+            } break;
+        }
+        inst = next;
+    }
+}
+
+bool Tier_RunLoop(VM* vm, uint64_t loopEnd, VMResult* result) {
+    uint64_t header = vm->Ip - vm->Code;
+    if (header >= vm->CodeSize || loopEnd > vm->CodeSize) {
+        return true;
+    }
+
+    if (!vm->Tier) {
+        vm->Tier = calloc(1, sizeof(Tier));
+        if (!vm->Tier) {
+            return true;
+        }
+        vm->Tier->Counts = calloc(vm->CodeSize, sizeof(uint32_t));
+        vm->Tier->Loops  = TierLoopArray_Create();
+        if (!vm->Tier->Counts) {
+            Tier_Destroy(vm->Tier);
+            vm->Tier = NULL;
+            return true;
+        }
+    }
+
+    Tier* tier     = vm->Tier;
+    uint32_t count = tier->Counts[header];
+    if (count < TIER_HOT_LOOP_THRESHOLD) {
+        tier->Counts[header] = count + 1;
+        return true;
+    }
+    if (count == TIER_HOT_LOOP_THRESHOLD) {
+        count                = Tier_Compile(tier, vm->Code, vm->CodeSize, header, loopEnd);
+        tier->Counts[header] = count;
+    }
+    if (count == TIER_NOT_COMPILABLE) {
+        return true;
+    }
+    return Tier_Run(vm, &tier->Loops.Data[count - TIER_COMPILED], result);
+}
+
+void Tier_Destroy(Tier* tier) {
+    if (!tier) {
+        return;
+    }
+    for (uint64_t i = 0; i < tier->Loops.Length; i++) {
+        TierInstArray_Destroy(&tier->Loops.Data[i].Insts);
+    }
+    TierLoopArray_Destroy(&tier->Loops);
+    free(tier->Counts);
+    free(tier);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "VM.h"
+#include "Array.h"
+
+// Backward jumps taken to a location before the loop starting there is compiled, so short scripts never pay for it
+#define TIER_HOT_LOOP_THRESHOLD 1000
+
+// An instruction of a compiled loop, the operands are decoded and the size is part of the key so running it is a single switch
+typedef struct TierInst {
+    // The op combined with the log2 of its size, 0 leaves the loop and continues in the interpreter at Offset
+    uint16_t Key;
+    // Set when a jump spends fuel like it does in the interpreter
+    bool IsBackward;
+    // For jumps, the index of the target in the loop, or TIER_EXIT when the jump leaves the loop
+    uint32_t Jump;
+    // The pushed value, the popped size or the location a jump goes to
+    uint64_t Operand;
+    // Where the instruction is in the code
+    uint64_t Offset;
+} TierInst;
+
+#define TIER_EXIT UINT32_MAX
+
+ARRAY_DECL(TierInst, TierInst);
+
+// The code from the target of a backward jump up to the end of the jump, the first instruction is the target
+// The loop is left through jumps out of it, through instructions the tier does not handle and by running off its end
+typedef struct TierLoop {
+    uint64_t Header;
+    TierInstArray Insts;
+} TierLoop;
+
+ARRAY_DECL(TierLoop, TierLoop);
+
+// The second tier of VM_Run, it counts backward jumps and hot loops are switched to mid-run since they share the stack
+typedef struct Tier {
+    // Per code offset, the number of backward jumps taken to it, or TIER_COMPILED plus the index of its loop
+    uint32_t* Counts;
+    TierLoopArray Loops;
+} Tier;
+
+// Called by VM_Run after taking a backward jump to vm->Ip, loopEnd is where the jump instruction ends
+// Once the loop is hot it runs in the tier until it is left, the VM is then where the interpreter continues
+// Returns false when VM_Run has to return result instead, on errors or when the fuel ran out in the loop
+bool Tier_RunLoop(VM* vm, uint64_t loopEnd, VMResult* result);
+// Frees the tier and every loop compiled in it, the tier of a VM is dropped whenever the VM gets other code
+void Tier_Destroy(Tier* tier);
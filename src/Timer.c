@@ -0,0 +1,105 @@
+#include "Timer.h"
+
+#include <stdbool.h>
+
+#if defined(_WIN32)
+    #include <Windows.h>
+#else
+    #error Unsupported platform
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define TIMER_X86 1
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+        #include <x86intrin.h>
+    #endif
+#else
+    #define TIMER_X86 0
+#endif
+
+// How long the time stamp counter is compared against the performance counter to find its rate
+#define TIMER_CALIBRATION_MILLISECONDS 20
+
+typedef enum TimerClock {
+    TimerClock_Unknown,
+    TimerClock_Tsc,
+    TimerClock_PerformanceCounter,
+} TimerClock;
+
+// Chosen on the first read, every thread that races to choose it picks the same clock
+static TimerClock Clock;
+static double NanosecondsPerTick;
+
+// The counter of older cpus changes its rate with the frequency and may stop in sleep states
+static bool HasInvariantTsc(void) {
+#if TIMER_X86
+    #if defined(_MSC_VER)
+    int registers[4];
+    __cpuid(registers, 0x80000000);
+    if ((uint32_t)registers[0] < 0x80000007) {
+        return false;
+    }
+    __cpuid(registers, 0x80000007);
+    return (registers[3] & (1 << 8)) != 0;
+    #else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (edx & (1u << 8)) != 0;
+    #endif
+#else
+    return false;
+#endif
+}
+
+static uint64_t ReadPerformanceCounter(void) {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+static uint64_t GetPerformanceCounterFrequency(void) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart;
+}
+
+uint64_t Timer_Now(void) {
+#if TIMER_X86
+    if (Clock == TimerClock_Tsc) {
+        return __rdtsc();
+    }
+#endif
+    if (Clock == TimerClock_Unknown) {
+        Clock = HasInvariantTsc() ? TimerClock_Tsc : TimerClock_PerformanceCounter;
+        return Timer_Now();
+    }
+    return ReadPerformanceCounter();
+}
+
+double Timer_TicksToNanoseconds(uint64_t ticks) {
+    if (NanosecondsPerTick == 0) {
+        Timer_Now();
+        uint64_t frequency = GetPerformanceCounterFrequency();
+        double rate        = 1e9 / (double)frequency;
+#if TIMER_X86
+        if (Clock == TimerClock_Tsc) {
+            uint64_t wait         = frequency * TIMER_CALIBRATION_MILLISECONDS / 1000;
+            uint64_t counterStart = ReadPerformanceCounter();
+            uint64_t tscStart     = __rdtsc();
+            uint64_t counterEnd;
+            do {
+                counterEnd = ReadPerformanceCounter();
+            } while (counterEnd - counterStart < wait);
+            uint64_t tscEnd = __rdtsc();
+            rate            = rate * (double)(counterEnd - counterStart) / (double)(tscEnd - tscStart);
+        }
+#endif
+        NanosecondsPerTick = rate;
+    }
+    return (double)ticks * NanosecondsPerTick;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+// Reads a clock that never goes backwards, the ticks are only meaningful as differences
+// Uses the time stamp counter when the cpu keeps its rate constant, since it is read in a few cycles without leaving user mode
+// Falls back to the performance counter of the OS otherwise
+uint64_t Timer_Now(void);
+// Converts a difference of Timer_Now ticks, the first call measures the rate of the time stamp counter which takes a few ms
+double Timer_TicksToNanoseconds(uint64_t ticks);
@@ -0,0 +1,792 @@
+#include "Translator.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <memory.h>
+
+typedef struct Translator {
+    FILE* File;
+    const uint8_t* Code;
+    uint64_t CodeSize;
+    // Indexed by code offset, one past the end is included since a jump can target it
+    bool* IsInstruction;
+    bool* IsLabel;
+    bool* IsDispatchTarget;
+    bool* IsReference;
+    // Set when the code has a call, ret, tail-call or jump-dyn, only then is the dispatch switch written
+    bool UsesDispatch;
+} Translator;
+
+// Everything the translated code needs besides the program itself
+// Values on the stack are unaligned so they are loaded and stored with memcpy, which compilers turn into plain moves
+static const char* TranslatorPrelude =
+    "#include <stdint.h>\n"
+    "#include <stdbool.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <stdio.h>\n"
+    "#include <string.h>\n"
+    "#include <math.h>\n"
+    "#include <float.h>\n"
+    "\n"
+    "static inline uint8_t Load8(const uint8_t* ptr) { return *ptr; }\n"
+    "static inline uint16_t Load16(const uint8_t* ptr) { uint16_t value; memcpy(&value, ptr, sizeof(value)); return value; }\n"
+    "static inline uint32_t Load32(const uint8_t* ptr) { uint32_t value; memcpy(&value, ptr, sizeof(value)); return value; }\n"
+    "static inline uint64_t Load64(const uint8_t* ptr) { uint64_t value; memcpy(&value, ptr, sizeof(value)); return value; }\n"
+    "static inline float LoadF32(const uint8_t* ptr) { float value; memcpy(&value, ptr, sizeof(value)); return value; }\n"
+    "static inline double LoadF64(const uint8_t* ptr) { double value; memcpy(&value, ptr, sizeof(value)); return value; }\n"
+    "static inline uint8_t* LoadPtr(const uint8_t* ptr) { return (uint8_t*)(uintptr_t)Load64(ptr); }\n"
+    "\n"
+    "static inline void Store8(uint8_t* ptr, uint8_t value) { *ptr = value; }\n"
+    "static inline void Store16(uint8_t* ptr, uint16_t value) { memcpy(ptr, &value, sizeof(value)); }\n"
+    "static inline void Store32(uint8_t* ptr, uint32_t value) { memcpy(ptr, &value, sizeof(value)); }\n"
+    "static inline void Store64(uint8_t* ptr, uint64_t value) { memcpy(ptr, &value, sizeof(value)); }\n"
+    "static inline void StoreF32(uint8_t* ptr, float value) { memcpy(ptr, &value, sizeof(value)); }\n"
+    "static inline void StoreF64(uint8_t* ptr, double value) { memcpy(ptr, &value, sizeof(value)); }\n"
+    "static inline void StorePtr(uint8_t* ptr, const void* value) { Store64(ptr, (uint64_t)(uintptr_t)value); }\n"
+    "\n"
+    "static inline bool IsZero(const uint8_t* ptr, uint64_t size) {\n"
+    "    for (uint64_t i = 0; i < size; i++) {\n"
+    "        if (ptr[i] != 0) {\n"
+    "            return false;\n"
+    "        }\n"
+    "    }\n"
+    "    return true;\n"
+    "}\n"
+    "\n"
+    "static inline int64_t FloatToInt(double value, int64_t min, int64_t max) {\n"
+    "    if (value != value) {\n"
+    "        return 0;\n"
+    "    } else if (value <= (double)min) {\n"
+    "        return min;\n"
+    "    } else if (value >= (double)max) {\n"
+    "        return max;\n"
+    "    }\n"
+    "    return (int64_t)value;\n"
+    "}\n"
+    "\n"
+    "static inline int Fail(const char* message) {\n"
+    "    fflush(stdout);\n"
+    "    fprintf(stderr, \"%s\\n\", message);\n"
+    "    return EXIT_FAILURE;\n"
+    "}\n"
+    "\n";
+
+static bool Translator_Error(uint64_t offset, const char* format, ...) {
+    fflush(stdout);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, " at %llu\n", offset);
+    return false;
+}
+
+static void Translator_Write(Translator* translator, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(translator->File, format, args);
+    va_end(args);
+}
+
+static uint64_t Translator_Operand(Translator* translator, uint64_t offset, uint64_t index) {
+    uint64_t value;
+    memcpy(&value, &translator->Code[offset + 1 + index * sizeof(uint64_t)], sizeof(value));
+    return value;
+}
+
+static bool IsScalarSize(uint64_t size) {
+    return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+static bool IsFloatSize(uint64_t size) {
+    return size == 4 || size == 8;
+}
+
+static void Translator_MarkLabel(Translator* translator, uint64_t location, bool isDispatchTarget) {
+    if (location > translator->CodeSize) {
+        // Reported when the labels are checked
+        location = translator->CodeSize + 1;
+    }
+    translator->IsLabel[location] = true;
+    if (isDispatchTarget) {
+        translator->IsDispatchTarget[location] = true;
+    }
+}
+
+// Finds every instruction that is jumped to, and every one that can be reached through the dispatch switch
+// Locations pushed from labels can be called or jumped to dynamically, so all of them are dispatch targets
+static bool Translator_FindLabels(Translator* translator) {
+    for (uint64_t offset = 0; offset < translator->CodeSize;) {
+        const uint8_t* ip = &translator->Code[offset];
+        uint64_t length   = VM_GetInstructionLength(ip);
+        if (length == 0 || length > translator->CodeSize - offset) {
+            return Translator_Error(offset, "Invalid instruction");
+        }
+        translator->IsInstruction[offset] = true;
+
+        switch (*ip) {
+            case Op_Push: {
+                for (uint64_t i = 1 + sizeof(uint64_t); i + sizeof(uint64_t) <= length; i++) {
+                    if (translator->IsReference[offset + i]) {
+                        uint64_t location;
+                        memcpy(&location, &ip[i], sizeof(location));
+                        Translator_MarkLabel(translator, location, true);
+                    }
+                }
+            } break;
+
+            case Op_Jump: {
+                Translator_MarkLabel(translator, Translator_Operand(translator, offset, 0), false);
+            } break;
+
+            case Op_JumpZero:
+            case Op_JumpNonZero:
+            case Op_JumpEqual:
+            case Op_JumpNotEqual:
+            case Op_JumpLessSigned:
+            case Op_JumpLessUnsigned:
+            case Op_JumpLessEqualSigned:
+            case Op_JumpLessEqualUnsigned: {
+                Translator_MarkLabel(translator, Translator_Operand(translator, offset, 1), false);
+            } break;
+
+            case Op_JumpTable: {
+                uint64_t count = Translator_Operand(translator, offset, 0);
+                for (uint64_t i = 0; i < count; i++) {
+                    Translator_MarkLabel(translator, Translator_Operand(translator, offset, 1 + i), false);
+                }
+            } break;
+
+            case Op_Call: {
+                // The return location is the instruction after the call
+                Translator_MarkLabel(translator, offset + length, true);
+                translator->UsesDispatch = true;
+            } break;
+
+            case Op_JumpDyn:
+            case Op_Ret:
+            case Op_TailCall: {
+                translator->UsesDispatch = true;
+            } break;
+
+            default: {
+            } break;
+        }
+        offset += length;
+    }
+
+    translator->IsInstruction[translator->CodeSize] = true;
+    for (uint64_t location = 0; location <= translator->CodeSize + 1; location++) {
+        if (translator->IsLabel[location] && (location > translator->CodeSize || !translator->IsInstruction[location])) {
+            fflush(stdout);
+            fprintf(stderr, "Cannot translate a jump into the middle of an instruction or past the end of the code\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+static void Translator_WriteBytes(Translator* translator, const uint8_t* bytes, uint64_t size) {
+    for (uint64_t i = 0; i < size; i++) {
+        Translator_Write(translator, i % 16 == 0 ? "\n    0x%02x," : " 0x%02x,", bytes[i]);
+    }
+    Translator_Write(translator, "\n");
+}
+
+// Data is written as arrays outside of the function so push-data can point at them
+static void Translator_WriteData(Translator* translator) {
+    for (uint64_t offset = 0; offset < translator->CodeSize; offset += VM_GetInstructionLength(&translator->Code[offset])) {
+        if (translator->Code[offset] != Op_Data) {
+            continue;
+        }
+        uint64_t size = Translator_Operand(translator, offset, 0);
+        Translator_Write(translator, "static const uint8_t Data%llu[%llu] = {", offset, size == 0 ? 1 : size);
+        Translator_WriteBytes(translator, &translator->Code[offset + 1 + sizeof(uint64_t)], size);
+        Translator_Write(translator, "};\n\n");
+    }
+}
+
+typedef enum ResultKind {
+    // The result has the size of the operands
+    ResultKind_Value,
+    // The result is 1 byte
+    ResultKind_Compare,
+    // The result is not pushed, the jump of the instruction is taken when it is not zero
+    ResultKind_Jump,
+} ResultKind;
+
+// a and b are popped as the type T, an integer of the size of the instruction or a float when IsFloat is set
+// The expressions are the ones VM_Run uses so the translated code computes exactly the same results
+typedef struct BinaryOp {
+    const char* Name;
+    bool IsFloat;
+    bool IsSigned;
+    const char* Expression;
+    ResultKind Kind;
+    bool ChecksDivision;
+} BinaryOp;
+
+#define SHIFT_EXPRESSION(op) "a " op " (b & (sizeof(T) * 8 - 1))"
+
+static const BinaryOp BinaryOps[] = {
+    [Op_Add]             = { "add", false, false, "a + b", ResultKind_Value, false },
+    [Op_Sub]             = { "subtract", false, false, "a - b", ResultKind_Value, false },
+    [Op_Mul]             = { "multiply", false, false, "(uint64_t)a * (uint64_t)b", ResultKind_Value, false },
+    [Op_DivSigned]       = { "divide", false, true, "b == -1 ? (T)(0 - (uint64_t)a) : (T)(a / b)", ResultKind_Value, true },
+    [Op_DivUnsigned]     = { "divide", false, false, "a / b", ResultKind_Value, true },
+    [Op_ModSigned]       = { "modulo", false, true, "b == -1 ? 0 : (T)(a % b)", ResultKind_Value, true },
+    [Op_ModUnsigned]     = { "modulo", false, false, "a % b", ResultKind_Value, true },
+    [Op_And]             = { "and", false, false, "a & b", ResultKind_Value, false },
+    [Op_Or]              = { "or", false, false, "a | b", ResultKind_Value, false },
+    [Op_Xor]             = { "xor", false, false, "a ^ b", ResultKind_Value, false },
+    [Op_ShiftLeft]       = { "shift", false, false, SHIFT_EXPRESSION("<<"), ResultKind_Value, false },
+    [Op_ShiftRight]      = { "shift", false, false, SHIFT_EXPRESSION(">>"), ResultKind_Value, false },
+    [Op_ShiftRightArith] = { "shift", false, true, SHIFT_EXPRESSION(">>"), ResultKind_Value, false },
+
+    [Op_Equal]             = { "compare", false, false, "a == b", ResultKind_Compare, false },
+    [Op_LessSigned]        = { "compare", false, true, "a < b", ResultKind_Compare, false },
+    [Op_LessUnsigned]      = { "compare", false, false, "a < b", ResultKind_Compare, false },
+    [Op_LessEqualSigned]   = { "compare", false, true, "a <= b", ResultKind_Compare, false },
+    [Op_LessEqualUnsigned] = { "compare", false, false, "a <= b", ResultKind_Compare, false },
+
+    [Op_JumpEqual]             = { "compare", false, false, "a == b", ResultKind_Jump, false },
+    [Op_JumpNotEqual]          = { "compare", false, false, "a != b", ResultKind_Jump, false },
+    [Op_JumpLessSigned]        = { "compare", false, true, "a < b", ResultKind_Jump, false },
+    [Op_JumpLessUnsigned]      = { "compare", false, false, "a < b", ResultKind_Jump, false },
+    [Op_JumpLessEqualSigned]   = { "compare", false, true, "a <= b", ResultKind_Jump, false },
+    [Op_JumpLessEqualUnsigned] = { "compare", false, false, "a <= b", ResultKind_Jump, false },
+
+    [Op_FloatAdd]       = { "float add", true, true, "a + b", ResultKind_Value, false },
+    [Op_FloatSub]       = { "float subtract", true, true, "a - b", ResultKind_Value, false },
+    [Op_FloatMul]       = { "float multiply", true, true, "a * b", ResultKind_Value, false },
+    [Op_FloatDiv]       = { "float divide", true, true, "a / b", ResultKind_Value, false },
+    [Op_FloatEqual]     = { "float compare", true, true, "a == b", ResultKind_Compare, false },
+    [Op_FloatLess]      = { "float compare", true, true, "a < b", ResultKind_Compare, false },
+    [Op_FloatLessEqual] = { "float compare", true, true, "a <= b", ResultKind_Compare, false },
+};
+
+static bool Translator_WriteBinary(Translator* translator, uint64_t offset, const BinaryOp* binary) {
+    bool isFloat  = binary->IsFloat;
+    uint64_t size = Translator_Operand(translator, offset, 0);
+    if (isFloat ? !IsFloatSize(size) : !IsScalarSize(size)) {
+        return Translator_Error(offset, "Unsupported %s size %llu", binary->Name, size);
+    }
+
+    uint64_t bits        = size * 8;
+    const char* load     = isFloat ? "LoadF" : "Load";
+    const char* store    = isFloat ? "StoreF" : "Store";
+    const char* type     = isFloat ? (size == 4 ? "float" : "double") : binary->IsSigned ? "int" : "uint";
+    const char* typeBits = isFloat ? "" : bits == 8 ? "8_t" : bits == 16 ? "16_t" : bits == 32 ? "32_t" : "64_t";
+
+    Translator_Write(translator, "    {\n");
+    Translator_Write(translator, "        typedef %s%s T;\n", type, typeBits);
+    Translator_Write(translator, "        T b = (T)%s%llu(sp - %llu);\n", load, bits, size);
+    Translator_Write(translator, "        T a = (T)%s%llu(sp - %llu);\n", load, bits, size * 2);
+    Translator_Write(translator, "        sp -= %llu;\n", size * 2);
+    if (binary->ChecksDivision) {
+        Translator_Write(translator, "        if (b == 0) {\n");
+        Translator_Write(translator, "            return Fail(\"Division by zero\");\n");
+        Translator_Write(translator, "        }\n");
+    }
+    switch (binary->Kind) {
+        case ResultKind_Value: {
+            if (isFloat) {
+                Translator_Write(translator, "        %s%llu(sp, (T)(%s));\n", store, bits, binary->Expression);
+            } else {
+                Translator_Write(translator, "        %s%llu(sp, (uint%llu_t)(%s));\n", store, bits, bits, binary->Expression);
+            }
+            Translator_Write(translator, "        sp += %llu;\n", size);
+        } break;
+
+        case ResultKind_Compare: {
+            Translator_Write(translator, "        Store8(sp, (uint8_t)(%s));\n", binary->Expression);
+            Translator_Write(translator, "        sp += 1;\n");
+        } break;
+
+        case ResultKind_Jump: {
+            Translator_Write(translator, "        if (%s) {\n", binary->Expression);
+            Translator_Write(translator, "            goto L%llu;\n", Translator_Operand(translator, offset, 1));
+            Translator_Write(translator, "        }\n");
+        } break;
+    }
+    Translator_Write(translator, "    }\n");
+    return true;
+}
+
+// Lanes are loaded as the unsigned type U, the signed type S is used for min, max and less
+static bool Translator_WriteVector(Translator* translator, uint64_t offset, bool isBuffer) {
+    static const char* expressions[] = {
+        [Op_VecAdd - Op_VecAdd]   = "x + y",
+        [Op_VecSub - Op_VecAdd]   = "x - y",
+        [Op_VecMin - Op_VecAdd]   = "(S)x < (S)y ? x : y",
+        [Op_VecMax - Op_VecAdd]   = "(S)x > (S)y ? x : y",
+        [Op_VecEqual - Op_VecAdd] = "x == y ? (U)~(U)0 : 0",
+        [Op_VecLess - Op_VecAdd]  = "(S)x < (S)y ? (U)~(U)0 : 0",
+    };
+    // The buffer ops are in the same order as the ones on the stack
+    uint8_t op        = isBuffer ? translator->Code[offset] - (Op_VecAddBuffer - Op_VecAdd) : translator->Code[offset];
+    uint64_t laneSize = Translator_Operand(translator, offset, 0);
+    uint64_t laneBits = laneSize * 8;
+    if (!IsScalarSize(laneSize)) {
+        return Translator_Error(offset, "Unsupported vector lane size %llu", laneSize);
+    }
+
+    Translator_Write(translator, "    {\n");
+    Translator_Write(translator, "        typedef uint%llu_t U;\n", laneBits);
+    if (op == Op_VecMin || op == Op_VecMax || op == Op_VecLess) {
+        Translator_Write(translator, "        typedef int%llu_t S;\n", laneBits);
+    }
+    if (isBuffer) {
+        Translator_Write(translator, "        uint64_t size = Load64(sp - 8) * %llu;\n", laneSize);
+        Translator_Write(translator, "        uint8_t* b    = LoadPtr(sp - 16);\n");
+        Translator_Write(translator, "        uint8_t* a    = LoadPtr(sp - 24);\n");
+        Translator_Write(translator, "        uint8_t* dst  = LoadPtr(sp - 32);\n");
+        Translator_Write(translator, "        sp -= 32;\n");
+    } else {
+        uint64_t size = Translator_Operand(translator, offset, 1);
+        if (size % laneSize != 0) {
+            return Translator_Error(offset, "Unsupported vector lane size %llu for size %llu", laneSize, size);
+        }
+        Translator_Write(translator, "        uint64_t size = %llu;\n", size);
+        Translator_Write(translator, "        uint8_t* b    = sp - size;\n");
+        Translator_Write(translator, "        uint8_t* a    = b - size;\n");
+        Translator_Write(translator, "        uint8_t* dst  = a;\n");
+        Translator_Write(translator, "        sp = b;\n");
+    }
+    Translator_Write(translator, "        for (uint64_t i = 0; i < size; i += %llu) {\n", laneSize);
+    Translator_Write(translator, "            U x = Load%llu(a + i);\n", laneBits);
+    Translator_Write(translator, "            U y = Load%llu(b + i);\n", laneBits);
+    Translator_Write(translator, "            Store%llu(dst + i, (U)(%s));\n", laneBits, expressions[op - Op_VecAdd]);
+    Translator_Write(translator, "        }\n");
+    Translator_Write(translator, "    }\n");
+    return true;
+}
+
+static bool Translator_WriteInstruction(Translator* translator, uint64_t offset, uint64_t length) {
+    const uint8_t* ip = &translator->Code[offset];
+    switch (*ip) {
+        case Op_Exit: {
+            Translator_Write(translator, "    return EXIT_SUCCESS;\n");
+        } break;
+
+        case Op_Checkpoint:
+        case Op_Extern:
+        case Op_Data: {
+            // Nothing to do without a host, data was written before the function
+        } break;
+
+        case Op_Push: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            if (IsScalarSize(size)) {
+                uint64_t value = 0;
+                memcpy(&value, &ip[1 + sizeof(uint64_t)], size);
+                Translator_Write(translator, "    Store%llu(sp, UINT%llu_C(%llu));\n", size * 8, size == 8 ? 64 : 32, value);
+            } else if (size != 0) {
+                Translator_Write(translator, "    memcpy(sp, (const uint8_t[]){");
+                Translator_WriteBytes(translator, &ip[1 + sizeof(uint64_t)], size);
+                Translator_Write(translator, "    }, %llu);\n", size);
+            }
+            Translator_Write(translator, "    sp += %llu;\n", size);
+        } break;
+
+        case Op_AllocStack: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            Translator_Write(translator, "    memset(sp, 0, %llu);\n", size);
+            Translator_Write(translator, "    sp += %llu;\n", size);
+        } break;
+
+        case Op_Pop: {
+            Translator_Write(translator, "    sp -= %llu;\n", Translator_Operand(translator, offset, 0));
+        } break;
+
+        case Op_Dup: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            Translator_Write(translator, "    memcpy(sp, sp - %llu, %llu);\n", size, size);
+            Translator_Write(translator, "    sp += %llu;\n", size);
+        } break;
+
+        case Op_Print: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            Translator_Write(translator, "    sp -= %llu;\n", size);
+            if (size == 8) {
+                Translator_Write(translator, "    printf(\"%%llu\\n\", (unsigned long long)Load64(sp));\n");
+            } else if (IsScalarSize(size)) {
+                Translator_Write(translator, "    printf(\"%%u\\n\", (unsigned)Load%llu(sp));\n", size * 8);
+            } else {
+                // Printed from the top of the stack down like VM_Run pops them
+                Translator_Write(translator, "    for (uint64_t i = %llu; i > 0; i--) {\n", size);
+                Translator_Write(translator, "        printf(\"%%x \", sp[i - 1]);\n");
+                Translator_Write(translator, "    }\n");
+                Translator_Write(translator, "    printf(\"\\n\");\n");
+            }
+        } break;
+
+        case Op_PrintFloat: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            if (!IsFloatSize(size)) {
+                return Translator_Error(offset, "Unsupported float print size %llu", size);
+            }
+            Translator_Write(translator, "    sp -= %llu;\n", size);
+            Translator_Write(translator,
+                             "    printf(\"%%.*g\\n\", %s, LoadF%llu(sp));\n",
+                             size == 4 ? "FLT_DIG" : "DBL_DIG",
+                             size * 8);
+        } break;
+
+        case Op_Jump: {
+            Translator_Write(translator, "    goto L%llu;\n", Translator_Operand(translator, offset, 0));
+        } break;
+
+        case Op_JumpDyn: {
+            Translator_Write(translator, "    sp -= 8;\n");
+            Translator_Write(translator, "    target = Load64(sp);\n");
+            Translator_Write(translator, "    goto Dispatch;\n");
+        } break;
+
+        case Op_JumpZero:
+        case Op_JumpNonZero: {
+            uint64_t size     = Translator_Operand(translator, offset, 0);
+            uint64_t location = Translator_Operand(translator, offset, 1);
+            const char* negate = *ip == Op_JumpZero ? "" : "!";
+            Translator_Write(translator, "    sp -= %llu;\n", size);
+            if (IsScalarSize(size)) {
+                const char* compare = *ip == Op_JumpZero ? "==" : "!=";
+                Translator_Write(translator, "    if (Load%llu(sp) %s 0) {\n", size * 8, compare);
+            } else {
+                Translator_Write(translator, "    if (%sIsZero(sp, %llu)) {\n", negate, size);
+            }
+            Translator_Write(translator, "        goto L%llu;\n", location);
+            Translator_Write(translator, "    }\n");
+        } break;
+
+        case Op_JumpTable: {
+            uint64_t count = Translator_Operand(translator, offset, 0);
+            Translator_Write(translator, "    sp -= 8;\n");
+            Translator_Write(translator, "    switch (Load64(sp)) {\n");
+            for (uint64_t i = 0; i < count; i++) {
+                uint64_t location = Translator_Operand(translator, offset, 1 + i);
+                Translator_Write(translator, "        case %llu: goto L%llu;\n", i, location);
+            }
+            Translator_Write(translator, "        default: break;\n");
+            Translator_Write(translator, "    }\n");
+        } break;
+
+        case Op_GetStackTop: {
+            Translator_Write(translator, "    StorePtr(sp, sp);\n");
+            Translator_Write(translator, "    sp += 8;\n");
+        } break;
+
+        case Op_GetStackBottom: {
+            Translator_Write(translator, "    StorePtr(sp, Stack);\n");
+            Translator_Write(translator, "    sp += 8;\n");
+        } break;
+
+        case Op_Load: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            Translator_Write(translator, "    sp -= 8;\n");
+            Translator_Write(translator, "    memmove(sp, LoadPtr(sp), %llu);\n", size);
+            Translator_Write(translator, "    sp += %llu;\n", size);
+        } break;
+
+        case Op_Store: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            Translator_Write(translator, "    sp -= %llu;\n", size);
+            Translator_Write(translator, "    memmove(LoadPtr(sp - 8), sp, %llu);\n", size);
+            Translator_Write(translator, "    sp -= 8;\n");
+        } break;
+
+        case Op_Call: {
+            uint64_t argSize = Translator_Operand(translator, offset, 0);
+            Translator_Write(translator, "    target = Load64(sp - %llu);\n", argSize + 8);
+            Translator_Write(translator, "    Store64(sp - %llu, %llu);\n", argSize + 8, offset + length);
+            Translator_Write(translator, "    goto Dispatch;\n");
+        } break;
+
+        case Op_Ret:
+        case Op_TailCall: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            Translator_Write(translator, "    target = Load64(sp - %llu);\n", size + 8);
+            Translator_Write(translator, "    memmove(sp - %llu, sp - %llu, %llu);\n", size + 8, size, size);
+            Translator_Write(translator, "    sp -= 8;\n");
+            Translator_Write(translator, "    goto Dispatch;\n");
+        } break;
+
+        case Op_PushData: {
+            uint64_t location = Translator_Operand(translator, offset, 0);
+            if (location >= translator->CodeSize || translator->Code[location] != Op_Data) {
+                return Translator_Error(offset, "The target of push-data is not data");
+            }
+            Translator_Write(translator, "    StorePtr(sp, Data%llu);\n", location);
+            Translator_Write(translator, "    sp += 8;\n");
+        } break;
+
+        case Op_MemCopy:
+        case Op_MemMove: {
+            Translator_Write(translator, "    sp -= 24;\n");
+            Translator_Write(translator,
+                             "    %s(LoadPtr(sp), LoadPtr(sp + 8), Load64(sp + 16));\n",
+                             *ip == Op_MemCopy ? "memcpy" : "memmove");
+        } break;
+
+        case Op_MemSet: {
+            Translator_Write(translator, "    sp -= 17;\n");
+            Translator_Write(translator, "    memset(LoadPtr(sp), Load8(sp + 8), Load64(sp + 9));\n");
+        } break;
+
+        case Op_VecAdd:
+        case Op_VecSub:
+        case Op_VecMin:
+        case Op_VecMax:
+        case Op_VecEqual:
+        case Op_VecLess: {
+            return Translator_WriteVector(translator, offset, false);
+        } break;
+
+        case Op_VecAddBuffer:
+        case Op_VecSubBuffer:
+        case Op_VecMinBuffer:
+        case Op_VecMaxBuffer:
+        case Op_VecEqualBuffer:
+        case Op_VecLessBuffer: {
+            return Translator_WriteVector(translator, offset, true);
+        } break;
+
+        case Op_Add:
+        case Op_Sub:
+        case Op_Mul:
+        case Op_DivSigned:
+        case Op_DivUnsigned:
+        case Op_ModSigned:
+        case Op_ModUnsigned:
+        case Op_And:
+        case Op_Or:
+        case Op_Xor:
+        case Op_ShiftLeft:
+        case Op_ShiftRight:
+        case Op_ShiftRightArith:
+        case Op_Equal:
+        case Op_LessSigned:
+        case Op_LessUnsigned:
+        case Op_LessEqualSigned:
+        case Op_LessEqualUnsigned:
+        case Op_JumpEqual:
+        case Op_JumpNotEqual:
+        case Op_JumpLessSigned:
+        case Op_JumpLessUnsigned:
+        case Op_JumpLessEqualSigned:
+        case Op_JumpLessEqualUnsigned:
+        case Op_FloatAdd:
+        case Op_FloatSub:
+        case Op_FloatMul:
+        case Op_FloatDiv:
+        case Op_FloatEqual:
+        case Op_FloatLess:
+        case Op_FloatLessEqual: {
+            return Translator_WriteBinary(translator, offset, &BinaryOps[*ip]);
+        } break;
+
+        case Op_Not: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            if (!IsScalarSize(size)) {
+                return Translator_Error(offset, "Unsupported not size %llu", size);
+            }
+            uint64_t bits = size * 8;
+            Translator_Write(translator,
+                             "    Store%llu(sp - %llu, (uint%llu_t)~Load%llu(sp - %llu));\n",
+                             bits,
+                             size,
+                             bits,
+                             bits,
+                             size);
+        } break;
+
+        case Op_FloatSqrt: {
+            uint64_t size = Translator_Operand(translator, offset, 0);
+            if (!IsFloatSize(size)) {
+                return Translator_Error(offset, "Unsupported float sqrt size %llu", size);
+            }
+            uint64_t bits        = size * 8;
+            const char* function = size == 4 ? "sqrtf" : "sqrt";
+            Translator_Write(translator,
+                             "    StoreF%llu(sp - %llu, %s(LoadF%llu(sp - %llu)));\n",
+                             bits,
+                             size,
+                             function,
+                             bits,
+                             size);
+        } break;
+
+        case Op_IntToFloat: {
+            uint64_t intSize   = Translator_Operand(translator, offset, 0);
+            uint64_t floatSize = Translator_Operand(translator, offset, 1);
+            if (!IsScalarSize(intSize)) {
+                return Translator_Error(offset, "Unsupported int to float int size %llu", intSize);
+            }
+            if (!IsFloatSize(floatSize)) {
+                return Translator_Error(offset, "Unsupported int to float float size %llu", floatSize);
+            }
+            Translator_Write(translator, "    sp -= %llu;\n", intSize);
+            Translator_Write(translator,
+                             "    StoreF%llu(sp, (%s)(int%llu_t)Load%llu(sp));\n",
+                             floatSize * 8,
+                             floatSize == 4 ? "float" : "double",
+                             intSize * 8,
+                             intSize * 8);
+            Translator_Write(translator, "    sp += %llu;\n", floatSize);
+        } break;
+
+        case Op_FloatToInt: {
+            uint64_t floatSize = Translator_Operand(translator, offset, 0);
+            uint64_t intSize   = Translator_Operand(translator, offset, 1);
+            if (!IsFloatSize(floatSize)) {
+                return Translator_Error(offset, "Unsupported float to int float size %llu", floatSize);
+            }
+            if (!IsScalarSize(intSize)) {
+                return Translator_Error(offset, "Unsupported float to int int size %llu", intSize);
+            }
+            uint64_t bits = intSize * 8;
+            Translator_Write(translator, "    sp -= %llu;\n", floatSize);
+            Translator_Write(translator,
+                             "    Store%llu(sp, (uint%llu_t)FloatToInt(LoadF%llu(sp), INT%llu_MIN, INT%llu_MAX));\n",
+                             bits,
+                             bits,
+                             floatSize * 8,
+                             bits,
+                             bits);
+            Translator_Write(translator, "    sp += %llu;\n", intSize);
+        } break;
+
+        case Op_HeapAlloc: {
+            // The VM heap is only needed for heap-reset, so malloc does the same job
+            Translator_Write(translator, "    {\n");
+            Translator_Write(translator, "        void* ptr = malloc(Load64(sp - 8));\n");
+            Translator_Write(translator, "        if (!ptr) {\n");
+            Translator_Write(translator, "            return Fail(\"Failed to allocate from the heap\");\n");
+            Translator_Write(translator, "        }\n");
+            Translator_Write(translator, "        StorePtr(sp - 8, ptr);\n");
+            Translator_Write(translator, "    }\n");
+        } break;
+
+        case Op_HeapFree: {
+            Translator_Write(translator, "    sp -= 8;\n");
+            Translator_Write(translator, "    free(LoadPtr(sp));\n");
+        } break;
+
+        case Op_CallCFunc: {
+            return Translator_Error(offset, "Cannot translate call-c-func");
+        } break;
+
+        case Op_CallExtern: {
+            return Translator_Error(offset, "Cannot translate call-extern");
+        } break;
+
+        case Op_IoOpen:
+        case Op_IoRead:
+        case Op_IoWrite:
+        case Op_IoClose: {
+            return Translator_Error(offset, "Cannot translate io ops");
+        } break;
+
+        case Op_HeapReset: {
+            return Translator_Error(offset, "Cannot translate heap-reset");
+        } break;
+
+        case Op_TimerBegin:
+        case Op_TimerEnd: {
+            return Translator_Error(offset, "Cannot translate timer ops");
+        } break;
+
+        default: {
+            return Translator_Error(offset, "Invalid instruction");
+        } break;
+    }
+    return true;
+}
+
+static bool Translator_WriteProgram(Translator* translator, uint64_t stackSize) {
+    Translator_Write(translator, "%s", TranslatorPrelude);
+    Translator_WriteData(translator);
+    Translator_Write(translator, "static uint8_t Stack[%llu];\n\n", stackSize == 0 ? 1 : stackSize);
+
+    Translator_Write(translator, "int TranslatedProgram_Run(void) {\n");
+    Translator_Write(translator, "    uint8_t* sp = Stack;\n");
+    if (translator->UsesDispatch) {
+        Translator_Write(translator, "    uint64_t target;\n");
+    }
+    Translator_Write(translator, "\n");
+
+    for (uint64_t offset = 0; offset < translator->CodeSize;) {
+        uint64_t length = VM_GetInstructionLength(&translator->Code[offset]);
+        if (translator->IsLabel[offset]) {
+            Translator_Write(translator, "L%llu:;\n", offset);
+        }
+        if (!Translator_WriteInstruction(translator, offset, length)) {
+            return false;
+        }
+        offset += length;
+    }
+
+    // Running off the end of the code
+    if (translator->IsLabel[translator->CodeSize]) {
+        Translator_Write(translator, "L%llu:;\n", translator->CodeSize);
+    }
+    Translator_Write(translator, "    return Fail(\"Instruction pointer out of range\");\n");
+
+    if (translator->UsesDispatch) {
+        Translator_Write(translator, "\nDispatch:\n");
+        Translator_Write(translator, "    switch (target) {\n");
+        for (uint64_t location = 0; location <= translator->CodeSize; location++) {
+            if (translator->IsDispatchTarget[location]) {
+                Translator_Write(translator, "        case %llu: goto L%llu;\n", location, location);
+            }
+        }
+        Translator_Write(translator, "        default: return Fail(\"Instruction pointer out of range\");\n");
+        Translator_Write(translator, "    }\n");
+    }
+    Translator_Write(translator, "}\n\n");
+
+    Translator_Write(translator, "#if !defined(TRANSLATED_PROGRAM_NO_MAIN)\n");
+    Translator_Write(translator, "int main(void) {\n");
+    Translator_Write(translator, "    return TranslatedProgram_Run();\n");
+    Translator_Write(translator, "}\n");
+    Translator_Write(translator, "#endif\n");
+    return true;
+}
+
+bool Translator_WriteC(Emitter* emitter, uint64_t stackSize, const char* path) {
+    Translator translator = (Translator){
+        .Code             = emitter->Code.Data,
+        .CodeSize         = emitter->Code.Length,
+        .IsInstruction    = calloc(emitter->Code.Length + 2, sizeof(bool)),
+        .IsLabel          = calloc(emitter->Code.Length + 2, sizeof(bool)),
+        .IsDispatchTarget = calloc(emitter->Code.Length + 2, sizeof(bool)),
+        .IsReference      = calloc(emitter->Code.Length + 2, sizeof(bool)),
+    };
+    for (uint64_t i = 0; i < emitter->References.Length; i++) {
+        translator.IsReference[emitter->References.Data[i].IndexForAddress] = true;
+    }
+
+    bool written = Translator_FindLabels(&translator);
+    if (written) {
+        translator.File = fopen(path, "w");
+        if (!translator.File) {
+            fflush(stdout);
+            fprintf(stderr, "Failed to open file '%s'\n", path);
+            written = false;
+        }
+    }
+    if (translator.File) {
+        written = Translator_WriteProgram(&translator, stackSize);
+        written = fclose(translator.File) == 0 && written;
+        if (!written) {
+            remove(path);
+        }
+    }
+
+    free(translator.IsInstruction);
+    free(translator.IsLabel);
+    free(translator.IsDispatchTarget);
+    free(translator.IsReference);
+    return written;
+}
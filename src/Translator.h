@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Emitter.h"
+
+// Writes the code of an emitter after Optimizer_Optimize as a C translation unit, so a C compiler can optimize the program
+// Every jump target becomes a label and jumps become gotos, call, ret and jump-dyn go through a switch over their locations
+// The program runs on a static stack of stackSize bytes that is not bounds checked, see StackAnalysis for a size that is enough
+// The unit defines int TranslatedProgram_Run(void) and a main that calls it unless TRANSLATED_PROGRAM_NO_MAIN is defined
+// Ops that need a host at run time (call-c-func, call-extern, the io ops, the timer ops and heap-reset) are reported
+// and nothing is written
+bool Translator_WriteC(Emitter* emitter, uint64_t stackSize, const char* path);
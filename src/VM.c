@@ -1,7 +1,15 @@
 #include "VM.h"
+#include "Simd.h"
+#include "Snapshot.h"
+#include "Io.h"
+#include "Tier.h"
+#include "Timer.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <memory.h>
+#include <math.h>
+#include <float.h>
 
 #if defined(_WIN32)
     #include <Windows.h>
@@ -19,13 +27,221 @@
 
 #define POP_STACK(ptr, type) (((ptr) -= sizeof(type)), *(type*)(ptr))
 
-void VM_Init(VM* vm, uint8_t* code, uint64_t codeSize) {
-    memset(vm, 0, sizeof(VM));
-    vm->Code      = code;
-    vm->CodeSize  = codeSize;
-    vm->Ip        = vm->Code;
-    vm->StackSize = sizeof(vm->Stack) / sizeof(vm->Stack[0]);
-    vm->Sp        = vm->Stack;
+// Expands to the switch cases for each integer size, a and b are popped as the type T and then stmt is run
+#define INTEGER_BINARY_CASES(sign, stmt)                \
+    case 1: {                                           \
+        typedef sign##8_t T;                            \
+        T b = POP_STACK(vm->Sp, T);                     \
+        T a = POP_STACK(vm->Sp, T);                     \
+        stmt;                                           \
+    } break;                                            \
+    case 2: {                                           \
+        typedef sign##16_t T;                           \
+        T b = POP_STACK(vm->Sp, T);                     \
+        T a = POP_STACK(vm->Sp, T);                     \
+        stmt;                                           \
+    } break;                                            \
+    case 4: {                                           \
+        typedef sign##32_t T;                           \
+        T b = POP_STACK(vm->Sp, T);                     \
+        T a = POP_STACK(vm->Sp, T);                     \
+        stmt;                                           \
+    } break;                                            \
+    case 8: {                                           \
+        typedef sign##64_t T;                           \
+        T b = POP_STACK(vm->Sp, T);                     \
+        T a = POP_STACK(vm->Sp, T);                     \
+        stmt;                                           \
+    } break
+
+#define INTEGER_UNARY_CASES(sign, stmt) \
+    case 1: {                           \
+        typedef sign##8_t T;            \
+        T a = POP_STACK(vm->Sp, T);     \
+        stmt;                           \
+    } break;                            \
+    case 2: {                           \
+        typedef sign##16_t T;           \
+        T a = POP_STACK(vm->Sp, T);     \
+        stmt;                           \
+    } break;                            \
+    case 4: {                           \
+        typedef sign##32_t T;           \
+        T a = POP_STACK(vm->Sp, T);     \
+        stmt;                           \
+    } break;                            \
+    case 8: {                           \
+        typedef sign##64_t T;           \
+        T a = POP_STACK(vm->Sp, T);     \
+        stmt;                           \
+    } break
+
+// Expands to the switch cases for each float size, a and b are popped as the type T and then stmt is run
+#define FLOAT_BINARY_CASES(stmt)        \
+    case 4: {                           \
+        typedef float T;                \
+        T b = POP_STACK(vm->Sp, T);     \
+        T a = POP_STACK(vm->Sp, T);     \
+        stmt;                           \
+    } break;                            \
+    case 8: {                           \
+        typedef double T;               \
+        T b = POP_STACK(vm->Sp, T);     \
+        T a = POP_STACK(vm->Sp, T);     \
+        stmt;                           \
+    } break
+
+// Fuel is only spent on calls, rets and backward jumps, every loop goes through one of them and straight-line code stays free
+// A ret is a jump to a location from the stack, so it is charged whichever way it goes
+// The instruction pointer is already at the target when the fuel runs out, so running the VM again continues there
+#define SPEND_FUEL()                 \
+    do {                             \
+        if (vm->Fuel == 0) {         \
+            return VMResult_Yielded; \
+        }                            \
+        vm->Fuel--;                  \
+    } while (0)
+
+// Loops made of jumps go through a backward jump, so that is where hot loops switch to the tier
+#define JUMP(location)                                            \
+    do {                                                          \
+        uint8_t* target = &vm->Code[location];                    \
+        uint8_t* end    = vm->Ip;                                 \
+        vm->Ip          = target;                                 \
+        if (target <= end) {                                      \
+            SPEND_FUEL();                                         \
+            VMResult tierResult;                                  \
+            if (!Tier_RunLoop(vm, end - vm->Code, &tierResult)) { \
+                return tierResult;                                \
+            }                                                     \
+        }                                                         \
+    } while (0)
+
+#define DIVISION_BY_ZERO_CHECK(b)                    \
+    if ((b) == 0) {                                  \
+        fflush(stdout);                              \
+        fprintf(stderr, "Division by zero\n");       \
+        return VMResult_Error;                       \
+    }
+
+// Truncates towards zero, saturating at the limits of the integer and turning NaN into zero
+static inline int64_t FloatToInt(double value, int64_t min, int64_t max) {
+    if (value != value) {
+        return 0;
+    } else if (value <= (double)min) {
+        return min;
+    } else if (value >= (double)max) {
+        return max;
+    }
+    return (int64_t)value;
+}
+
+// Raises the high water mark over a write through a pointer, so VM_Reset clears it, writes outside the stack are ignored
+static inline void RaiseHighWater(VM* vm, uint8_t* dst, uint64_t size) {
+    // Below the stack wraps around to a huge offset, so one compare checks both ends
+    uint64_t offset = (uint64_t)(dst - vm->Stack);
+    if (offset >= vm->StackSize) {
+        return;
+    }
+    uint8_t* end = vm->Stack + (size > vm->StackSize - offset ? vm->StackSize : offset + size);
+    if (end > vm->StackHighWater) {
+        vm->StackHighWater = end;
+    }
+}
+
+// Copies size bytes, the regions may overlap
+// The common scalar widths are a single load and store, everything else goes through memmove which is vectorized
+static inline void MoveBytes(uint8_t* dst, const uint8_t* src, uint64_t size) {
+    switch (size) {
+        case 0: {
+        } break;
+
+        case 1: {
+            *dst = *src;
+        } break;
+
+        case 2: {
+            uint16_t value;
+            memcpy(&value, src, sizeof(value));
+            memcpy(dst, &value, sizeof(value));
+        } break;
+
+        case 4: {
+            uint32_t value;
+            memcpy(&value, src, sizeof(value));
+            memcpy(dst, &value, sizeof(value));
+        } break;
+
+        case 8: {
+            uint64_t value;
+            memcpy(&value, src, sizeof(value));
+            memcpy(dst, &value, sizeof(value));
+        } break;
+
+        case 16: {
+            uint64_t values[2];
+            memcpy(values, src, sizeof(values));
+            memcpy(dst, values, sizeof(values));
+        } break;
+
+        default: {
+            memmove(dst, src, size);
+        } break;
+    }
+}
+
+bool VM_Create(VM* vm, uint64_t stackSize) {
+    *vm       = (VM){};
+    vm->Stack = calloc(stackSize, 1);
+    if (!vm->Stack) {
+        fflush(stdout);
+        fprintf(stderr, "Failed to allocate a %llu byte stack\n", stackSize);
+        return false;
+    }
+    vm->StackSize      = stackSize;
+    vm->Sp             = vm->Stack;
+    vm->StackHighWater = vm->Stack;
+    vm->Fuel           = VM_UNLIMITED_FUEL;
+    Heap_Init(&vm->Heap);
+    return true;
+}
+
+void VM_Destroy(VM* vm) {
+    Heap_Destroy(&vm->Heap);
+    Tier_Destroy(vm->Tier);
+    free(vm->IoRequest);
+    if (vm->StackIsMapped) {
+        Snapshot_ReleaseStack(vm->Stack, vm->StackSize);
+    } else {
+        free(vm->Stack);
+    }
+    *vm = (VM){};
+}
+
+void VM_Load(VM* vm, uint8_t* code, uint64_t codeSize) {
+    VM_Reset(vm);
+    // The loops were compiled from the old code
+    Tier_Destroy(vm->Tier);
+    vm->Tier     = NULL;
+    vm->Code     = code;
+    vm->CodeSize = codeSize;
+    vm->Ip       = vm->Code;
+}
+
+void VM_Reset(VM* vm) {
+    uint8_t* end = vm->StackHighWater;
+    if (end > vm->Stack + vm->StackSize) {
+        end = vm->Stack + vm->StackSize;
+    }
+    if (end > vm->Stack) {
+        memset(vm->Stack, 0, end - vm->Stack);
+    }
+    vm->Sp             = vm->Stack;
+    vm->StackHighWater = vm->Stack;
+    vm->Ip             = vm->Code;
+    vm->Fuel           = VM_UNLIMITED_FUEL;
+    Heap_Reset(&vm->Heap);
+    memset(vm->Timers, 0, sizeof(vm->Timers));
 }
 
 void VM_PrintStack(VM* vm) {
@@ -41,37 +257,262 @@ void VM_PrintStack(VM* vm) {
     }
 }
 
-bool VM_Run(VM* vm) {
+void VM_PrintTimers(VM* vm) {
+    bool printedHeader = false;
+    for (uint64_t id = 0; id < VM_TIMER_COUNT; id++) {
+        VMTimer* timer = &vm->Timers[id];
+        if (timer->Count == 0) {
+            continue;
+        }
+        if (!printedHeader) {
+            fflush(stdout);
+            fprintf(stderr, "Timer |      Count |       Min ns |       Avg ns |       Max ns\n");
+            printedHeader = true;
+        }
+        fprintf(stderr,
+                "%5llu | %10llu | %12.1f | %12.1f | %12.1f\n",
+                id,
+                timer->Count,
+                Timer_TicksToNanoseconds(timer->MinTicks),
+                Timer_TicksToNanoseconds(timer->TotalTicks) / (double)timer->Count,
+                Timer_TicksToNanoseconds(timer->MaxTicks));
+    }
+}
+
+uint64_t VM_GetInstructionLength(const uint8_t* ip) {
+    switch (*ip) {
+        case Op_Exit:
+        case Op_JumpDyn:
+        case Op_GetStackTop:
+        case Op_GetStackBottom:
+        case Op_MemCopy:
+        case Op_MemMove:
+        case Op_MemSet:
+        case Op_HeapAlloc:
+        case Op_HeapFree:
+        case Op_HeapReset:
+        case Op_Checkpoint:
+        case Op_IoOpen:
+        case Op_IoRead:
+        case Op_IoWrite:
+        case Op_IoClose:
+            return 1;
+
+        case Op_AllocStack:
+        case Op_Pop:
+        case Op_Dup:
+        case Op_Add:
+        case Op_Sub:
+        case Op_Print:
+        case Op_Jump:
+        case Op_Load:
+        case Op_Store:
+        case Op_Call:
+        case Op_Ret:
+        case Op_TailCall:
+        case Op_VecAddBuffer:
+        case Op_VecSubBuffer:
+        case Op_VecMinBuffer:
+        case Op_VecMaxBuffer:
+        case Op_VecEqualBuffer:
+        case Op_VecLessBuffer:
+        case Op_Mul:
+        case Op_DivSigned:
+        case Op_DivUnsigned:
+        case Op_ModSigned:
+        case Op_ModUnsigned:
+        case Op_And:
+        case Op_Or:
+        case Op_Xor:
+        case Op_Not:
+        case Op_ShiftLeft:
+        case Op_ShiftRight:
+        case Op_ShiftRightArith:
+        case Op_Equal:
+        case Op_LessSigned:
+        case Op_LessUnsigned:
+        case Op_LessEqualSigned:
+        case Op_LessEqualUnsigned:
+        case Op_FloatAdd:
+        case Op_FloatSub:
+        case Op_FloatMul:
+        case Op_FloatDiv:
+        case Op_FloatEqual:
+        case Op_FloatLess:
+        case Op_FloatLessEqual:
+        case Op_FloatSqrt:
+        case Op_PrintFloat:
+        case Op_CallExtern:
+        case Op_PushData:
+        case Op_TimerBegin:
+        case Op_TimerEnd:
+            return 1 + sizeof(uint64_t);
+
+        case Op_JumpZero:
+        case Op_JumpNonZero:
+        case Op_VecAdd:
+        case Op_VecSub:
+        case Op_VecMin:
+        case Op_VecMax:
+        case Op_VecEqual:
+        case Op_VecLess:
+        case Op_JumpEqual:
+        case Op_JumpNotEqual:
+        case Op_JumpLessSigned:
+        case Op_JumpLessUnsigned:
+        case Op_JumpLessEqualSigned:
+        case Op_JumpLessEqualUnsigned:
+        case Op_IntToFloat:
+        case Op_FloatToInt:
+            return 1 + 2 * sizeof(uint64_t);
+
+        case Op_Push:
+        case Op_Data: {
+            uint64_t size = *(const uint64_t*)(ip + 1);
+            return 1 + sizeof(uint64_t) + size;
+        }
+
+        case Op_JumpTable: {
+            uint64_t count = *(const uint64_t*)(ip + 1);
+            return 1 + sizeof(uint64_t) + count * sizeof(uint64_t);
+        }
+
+        case Op_CallCFunc: {
+            uint64_t argCount = *(const uint64_t*)(ip + 1);
+            return 1 + sizeof(uint64_t) + argCount * sizeof(uint64_t) + sizeof(uint64_t);
+        }
+
+        case Op_Extern: {
+            uint64_t argCount   = *(const uint64_t*)(ip + 1 + sizeof(uint64_t));
+            uint64_t nameLength = *(const uint64_t*)(ip + 1 + (argCount + 3) * sizeof(uint64_t));
+            return 1 + (argCount + 4) * sizeof(uint64_t) + nameLength + 1;
+        }
+
+        default: {
+            return 0;
+        }
+    }
+}
+
+// Every argument takes a whole register or stack slot and the caller cleans up the stack, so extra arguments are ignored
+// That way one signature calls any extern with up to VM_MAX_EXTERN_ARGS integer or pointer arguments
+typedef uint64_t (*ExternFunction)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t);
+
+_Static_assert(VM_MAX_EXTERN_ARGS == 8, "ExternFunction takes VM_MAX_EXTERN_ARGS arguments");
+
+static void* FindExportedFunction(const char* name) {
+#if defined(_WIN32)
+    HMODULE modules[256];
+    DWORD size = 0;
+    if (!K32EnumProcessModules(GetCurrentProcess(), modules, sizeof(modules), &size)) {
+        return NULL;
+    }
+    uint64_t count = size / sizeof(HMODULE);
+    if (count > sizeof(modules) / sizeof(modules[0])) {
+        count = sizeof(modules) / sizeof(modules[0]);
+    }
+    // The executable comes first, so the host can export functions that shadow the ones of the libraries
+    for (uint64_t i = 0; i < count; i++) {
+        FARPROC function = GetProcAddress(modules[i], name);
+        if (function) {
+            return (void*)function;
+        }
+    }
+    return NULL;
+#else
+    #error "Unsupported platform"
+#endif
+}
+
+bool VM_BindExterns(uint8_t* code, uint64_t codeSize, VMExternResolver resolver, void* userData) {
+    bool bound = true;
+    for (uint64_t offset = 0; offset < codeSize;) {
+        uint8_t* ip        = &code[offset];
+        uint64_t remaining = codeSize - offset;
+        if (*ip == Op_Extern && (remaining < 1 + 2 * sizeof(uint64_t) ||
+                                 *(uint64_t*)(ip + 1 + sizeof(uint64_t)) > VM_MAX_EXTERN_ARGS ||
+                                 remaining < 1 + (*(uint64_t*)(ip + 1 + sizeof(uint64_t)) + 4) * sizeof(uint64_t))) {
+            fflush(stdout);
+            fprintf(stderr, "Invalid extern declaration at %llu\n", offset);
+            return false;
+        }
+
+        uint64_t length = VM_GetInstructionLength(ip);
+        if (length == 0 || length > remaining) {
+            fflush(stdout);
+            fprintf(stderr, "Invalid instruction at %llu\n", offset);
+            return false;
+        }
+
+        if (*ip == Op_Extern) {
+            uint64_t argCount = *(uint64_t*)(ip + 1 + sizeof(uint64_t));
+            // Loaded binaries were never checked by the emitter, call-extern copies the arguments and result with these sizes
+            uint64_t* sizes = (uint64_t*)(ip + 1 + 2 * sizeof(uint64_t));
+            bool isValid    = sizes[argCount] <= sizeof(uint64_t) && ip[length - 1] == '\0';
+            for (uint64_t i = 0; i < argCount; i++) {
+                isValid &= sizes[i] >= 1 && sizes[i] <= sizeof(uint64_t);
+            }
+            if (!isValid) {
+                fflush(stdout);
+                fprintf(stderr, "Invalid extern declaration at %llu\n", offset);
+                return false;
+            }
+
+            const char* name = (const char*)(ip + 1 + (argCount + 4) * sizeof(uint64_t));
+            void* function    = resolver ? resolver(userData, name) : NULL;
+            if (!function) {
+                function = FindExportedFunction(name);
+            }
+            if (!function) {
+                fflush(stdout);
+                fprintf(stderr, "Failed to find the extern '%s'\n", name);
+                bound = false;
+            }
+            *(void**)(ip + 1) = function;
+        }
+        offset += length;
+    }
+    return bound;
+}
+
+VMResult VM_Run(VM* vm) {
     while (true) {
+        if (vm->Sp > vm->StackHighWater) {
+            vm->StackHighWater = vm->Sp;
+        }
+
         if (vm->Ip - vm->Code < 0 || vm->Ip - vm->Code >= (int64_t)vm->CodeSize) {
             fflush(stdout);
             fprintf(stderr, "Instruction pointer out of range\n");
-            return false;
+            return VMResult_Error;
         }
 
-        if (vm->Sp - vm->Stack < 0 || vm->Sp - vm->Stack >= (int64_t)vm->StackSize) {
+        if (vm->Sp - vm->Stack < 0 || vm->Sp - vm->Stack > (int64_t)vm->StackSize) {
             fflush(stdout);
             fprintf(stderr, "Stack pointer out of range\n");
-            return false;
+            return VMResult_Error;
         }
 
         switch (*vm->Ip++) {
             case Op_Exit: {
-                return true;
+                return VMResult_Exit;
+            } break;
+
+            case Op_Checkpoint: {
+                return VMResult_Checkpoint;
             } break;
 
             case Op_Push: {
                 uint64_t size = DECODE(vm->Ip, uint64_t);
-                for (uint64_t i = 0; i < size; i++) {
-                    *vm->Sp++ = *vm->Ip++;
-                }
+                MoveBytes(vm->Sp, vm->Ip, size);
+                vm->Sp += size;
+                vm->Ip += size;
             } break;
 
             case Op_AllocStack: {
                 uint64_t size = DECODE(vm->Ip, uint64_t);
-                for (uint64_t i = 0; i < size; i++) {
-                    *vm->Sp++ = 0;
-                }
+                memset(vm->Sp, 0, size);
+                vm->Sp += size;
             } break;
 
             case Op_Pop: {
@@ -81,10 +522,8 @@ bool VM_Run(VM* vm) {
 
             case Op_Dup: {
                 uint64_t size = DECODE(vm->Ip, uint64_t);
-                uint8_t* ptr  = vm->Sp - size;
-                for (uint64_t i = 0; i < size; i++) {
-                    *vm->Sp++ = *ptr++;
-                }
+                MoveBytes(vm->Sp, vm->Sp - size, size);
+                vm->Sp += size;
             } break;
 
             case Op_Add: {
@@ -117,7 +556,7 @@ bool VM_Run(VM* vm) {
                     default: {
                         fflush(stdout);
                         fprintf(stderr, "Unsupported add size %llu\n", size);
-                        return false;
+                        return VMResult_Error;
                     } break;
                 }
             } break;
@@ -152,7 +591,7 @@ bool VM_Run(VM* vm) {
                     default: {
                         fflush(stdout);
                         fprintf(stderr, "Unsupported subtract size %llu\n", size);
-                        return false;
+                        return VMResult_Error;
                     } break;
                 }
             } break;
@@ -187,12 +626,12 @@ bool VM_Run(VM* vm) {
 
             case Op_Jump: {
                 uint64_t location = DECODE(vm->Ip, uint64_t);
-                vm->Ip            = &vm->Code[location];
+                JUMP(location);
             } break;
 
             case Op_JumpDyn: {
                 uint64_t location = POP_STACK(vm->Sp, uint64_t);
-                vm->Ip            = &vm->Code[location];
+                JUMP(location);
             } break;
 
             case Op_JumpZero: {
@@ -205,7 +644,7 @@ bool VM_Run(VM* vm) {
                     }
                 }
                 if (zero) {
-                    vm->Ip = &vm->Code[location];
+                    JUMP(location);
                 }
             } break;
 
@@ -219,7 +658,17 @@ bool VM_Run(VM* vm) {
                     }
                 }
                 if (!zero) {
-                    vm->Ip = &vm->Code[location];
+                    JUMP(location);
+                }
+            } break;
+
+            case Op_JumpTable: {
+                uint64_t count  = DECODE(vm->Ip, uint64_t);
+                uint64_t index  = POP_STACK(vm->Sp, uint64_t);
+                uint64_t* table = (uint64_t*)vm->Ip;
+                vm->Ip += count * sizeof(uint64_t);
+                if (index < count) {
+                    JUMP(table[index]);
                 }
             } break;
 
@@ -236,52 +685,49 @@ bool VM_Run(VM* vm) {
             case Op_Load: {
                 uint64_t size = DECODE(vm->Ip, uint64_t);
                 uint8_t* ptr  = POP_STACK(vm->Sp, uint8_t*);
-                for (uint64_t i = 0; i < size; i++) {
-                    *vm->Sp++ = *ptr++;
-                }
+                MoveBytes(vm->Sp, ptr, size);
+                vm->Sp += size;
             } break;
 
             case Op_Store: {
                 uint64_t size = DECODE(vm->Ip, uint64_t);
-                uint8_t data[size];
                 vm->Sp -= size;
-                for (uint64_t i = 0; i < size; i++) {
-                    data[i] = vm->Sp[i];
-                }
-                uint8_t* ptr = POP_STACK(vm->Sp, uint8_t*);
-                for (uint64_t i = 0; i < size; i++) {
-                    *ptr++ = data[i];
-                }
+                uint8_t* data = vm->Sp;
+                uint8_t* ptr  = POP_STACK(vm->Sp, uint8_t*);
+                RaiseHighWater(vm, ptr, size);
+                MoveBytes(ptr, data, size);
             } break;
 
             case Op_Call: {
-                uint64_t argSize = DECODE(vm->Ip, uint64_t);
-                uint8_t argData[argSize];
-                vm->Sp -= argSize;
-                for (uint64_t i = 0; i < argSize; i++) {
-                    argData[i] = vm->Sp[i];
-                }
-                uint64_t callLoc = POP_STACK(vm->Sp, uint64_t);
+                // The return location takes the place of the call location so the arguments never move
+                uint64_t argSize  = DECODE(vm->Ip, uint64_t);
+                uint8_t* slot     = vm->Sp - argSize - sizeof(uint64_t);
+                uint64_t callLoc  = *(uint64_t*)slot;
                 uint64_t location = vm->Ip - vm->Code;
-                PUSH_STACK(vm->Sp, uint64_t, location);
-                for (uint64_t i = 0; i < argSize; i++) {
-                    *vm->Sp++ = argData[i];
-                }
-                vm->Ip = &vm->Code[callLoc];
+                *(uint64_t*)slot  = location;
+                vm->Ip            = &vm->Code[callLoc];
+                SPEND_FUEL();
             } break;
 
             case Op_Ret: {
-                uint64_t retSize = DECODE(vm->Ip, uint64_t);
-                uint8_t retData[retSize];
-                vm->Sp -= retSize;
-                for (uint64_t i = 0; i < retSize; i++) {
-                    retData[i] = vm->Sp[i];
-                }
-                uint64_t location = POP_STACK(vm->Sp, uint64_t);
-                for (uint64_t i = 0; i < retSize; i++) {
-                    *vm->Sp++ = retData[i];
-                }
+                uint64_t retSize  = DECODE(vm->Ip, uint64_t);
+                uint8_t* slot     = vm->Sp - retSize - sizeof(uint64_t);
+                uint64_t location = *(uint64_t*)slot;
+                MoveBytes(slot, slot + sizeof(uint64_t), retSize);
+                vm->Sp -= sizeof(uint64_t);
                 vm->Ip = &vm->Code[location];
+                SPEND_FUEL();
+            } break;
+
+            case Op_TailCall: {
+                // The current return location stays where it is so the callee returns directly to our caller
+                uint64_t argSize = DECODE(vm->Ip, uint64_t);
+                uint8_t* slot    = vm->Sp - argSize - sizeof(uint64_t);
+                uint64_t callLoc = *(uint64_t*)slot;
+                MoveBytes(slot, slot + sizeof(uint64_t), argSize);
+                vm->Sp -= sizeof(uint64_t);
+                vm->Ip = &vm->Code[callLoc];
+                SPEND_FUEL();
             } break;
 
             case Op_CallCFunc: {
@@ -292,7 +738,7 @@ bool VM_Run(VM* vm) {
                     if (argSizes[i] > 8) {
                         fflush(stdout);
                         fprintf(stderr, "Cannot call C function with argument size greater than 8\n");
-                        return false;
+                        return VMResult_Error;
                     }
                 }
 
@@ -300,7 +746,7 @@ bool VM_Run(VM* vm) {
                 if (retSize > 8) {
                     fflush(stdout);
                     fprintf(stderr, "Cannot call C function with return size greater than 8\n");
-                    return false;
+                    return VMResult_Error;
                 }
 
 #if defined(_WIN32)
@@ -308,7 +754,7 @@ bool VM_Run(VM* vm) {
                 if (!func) {
                     fflush(stdout);
                     fprintf(stderr, "Failed to allocate executable memory for calling C function\n");
-                    return false;
+                    return VMResult_Error;
                 }
 
                 uint8_t* ip = (uint8_t*)func;
@@ -316,9 +762,7 @@ bool VM_Run(VM* vm) {
                 for (int64_t i = (int64_t)argCount - 1; i >= 0; i--) {
                     vm->Sp -= argSizes[i];
                     uint64_t value = 0;
-                    for (uint64_t j = 0; j < argSizes[i]; j++) {
-                        ((uint8_t*)&value)[j] = vm->Sp[j];
-                    }
+                    memcpy(&value, vm->Sp, argSizes[i]);
 
                     switch (i) {
                         case 0: {
@@ -381,15 +825,766 @@ bool VM_Run(VM* vm) {
 #else
     #error "Unsupported platform"
 #endif
-                for (uint64_t i = 0; i < retSize; i++) {
-                    *vm->Sp++ = ((uint8_t*)&result)[i];
+                memcpy(vm->Sp, &result, retSize);
+                vm->Sp += retSize;
+            } break;
+
+            case Op_Extern: {
+                vm->Ip += VM_GetInstructionLength(vm->Ip - 1) - 1;
+            } break;
+
+            case Op_CallExtern: {
+                // The sizes were checked when the extern was emitted, so they are only read here
+                uint64_t location = DECODE(vm->Ip, uint64_t);
+                if (location >= vm->CodeSize || vm->Code[location] != Op_Extern) {
+                    fflush(stdout);
+                    fprintf(stderr, "The target of call-extern is not an extern\n");
+                    return VMResult_Error;
+                }
+
+                uint8_t* declaration    = &vm->Code[location + 1];
+                ExternFunction function = DECODE(declaration, ExternFunction);
+                uint64_t argCount       = DECODE(declaration, uint64_t);
+                uint64_t* argSizes      = (uint64_t*)declaration;
+                if (!function) {
+                    fflush(stdout);
+                    fprintf(stderr, "The extern '%s' is not bound\n", (const char*)&argSizes[argCount + 2]);
+                    return VMResult_Error;
+                }
+
+                uint64_t args[VM_MAX_EXTERN_ARGS] = {};
+                for (int64_t i = (int64_t)argCount - 1; i >= 0; i--) {
+                    vm->Sp -= argSizes[i];
+                    memcpy(&args[i], vm->Sp, argSizes[i]);
                 }
+
+                uint64_t retSize = argSizes[argCount];
+                uint64_t result  = function(args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7]);
+                memcpy(vm->Sp, &result, retSize);
+                vm->Sp += retSize;
             } break;
 
-            default: {
-                fflush(stdout);
-                fprintf(stderr, "Invalid instruction\n");
-                return false;
+            case Op_Data: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                vm->Ip += size;
+            } break;
+
+            case Op_PushData: {
+                uint64_t location = DECODE(vm->Ip, uint64_t);
+                if (location >= vm->CodeSize || vm->Code[location] != Op_Data) {
+                    fflush(stdout);
+                    fprintf(stderr, "The target of push-data is not data\n");
+                    return VMResult_Error;
+                }
+                uint8_t* data = &vm->Code[location + 1 + sizeof(uint64_t)];
+                PUSH_STACK(vm->Sp, uint8_t*, data);
+            } break;
+
+            case Op_TimerBegin: {
+                uint64_t id = DECODE(vm->Ip, uint64_t);
+                if (id >= VM_TIMER_COUNT) {
+                    fflush(stdout);
+                    fprintf(stderr, "The timing region %llu is out of range\n", id);
+                    return VMResult_Error;
+                }
+                if (vm->Timers[id].Start != 0) {
+                    fflush(stdout);
+                    fprintf(stderr, "The timing region %llu is already running\n", id);
+                    return VMResult_Error;
+                }
+                vm->Timers[id].Start = Timer_Now();
+            } break;
+
+            case Op_TimerEnd: {
+                // Read the clock first, so the bookkeeping is not part of the region
+                uint64_t end = Timer_Now();
+                uint64_t id  = DECODE(vm->Ip, uint64_t);
+                if (id >= VM_TIMER_COUNT) {
+                    fflush(stdout);
+                    fprintf(stderr, "The timing region %llu is out of range\n", id);
+                    return VMResult_Error;
+                }
+                if (vm->Timers[id].Start == 0) {
+                    fflush(stdout);
+                    fprintf(stderr, "The timing region %llu is not running\n", id);
+                    return VMResult_Error;
+                }
+                VMTimer* timer  = &vm->Timers[id];
+                uint64_t ticks  = end - timer->Start;
+                timer->Start    = 0;
+                timer->MinTicks = timer->Count == 0 || ticks < timer->MinTicks ? ticks : timer->MinTicks;
+                timer->MaxTicks = ticks > timer->MaxTicks ? ticks : timer->MaxTicks;
+                timer->TotalTicks += ticks;
+                timer->Count++;
+            } break;
+
+            case Op_IoOpen: {
+                uint64_t mode       = POP_STACK(vm->Sp, uint64_t);
+                uint64_t pathLength = POP_STACK(vm->Sp, uint64_t);
+                uint8_t* path       = POP_STACK(vm->Sp, uint8_t*);
+                uint64_t handle     = Io_Open(vm->Io, path, pathLength, mode);
+                PUSH_STACK(vm->Sp, uint64_t, handle);
+            } break;
+
+            case Op_IoRead:
+            case Op_IoWrite: {
+                bool isWrite    = vm->Ip[-1] == Op_IoWrite;
+                uint64_t offset = POP_STACK(vm->Sp, uint64_t);
+                uint64_t size   = POP_STACK(vm->Sp, uint64_t);
+                uint8_t* buffer = POP_STACK(vm->Sp, uint8_t*);
+                uint64_t handle = POP_STACK(vm->Sp, uint64_t);
+                uint64_t count  = 0;
+                if (!isWrite) {
+                    RaiseHighWater(vm, buffer, size);
+                }
+                if (!Io_Transfer(vm, isWrite, handle, buffer, size, offset, &count)) {
+                    return VMResult_Waiting;
+                }
+                PUSH_STACK(vm->Sp, uint64_t, count);
+            } break;
+
+            case Op_IoClose: {
+                uint64_t handle = POP_STACK(vm->Sp, uint64_t);
+                Io_Close(handle);
+            } break;
+
+            case Op_MemCopy: {
+                uint64_t size = POP_STACK(vm->Sp, uint64_t);
+                uint8_t* src  = POP_STACK(vm->Sp, uint8_t*);
+                uint8_t* dst  = POP_STACK(vm->Sp, uint8_t*);
+                RaiseHighWater(vm, dst, size);
+                memcpy(dst, src, size);
+            } break;
+
+            case Op_MemMove: {
+                uint64_t size = POP_STACK(vm->Sp, uint64_t);
+                uint8_t* src  = POP_STACK(vm->Sp, uint8_t*);
+                uint8_t* dst  = POP_STACK(vm->Sp, uint8_t*);
+                RaiseHighWater(vm, dst, size);
+                memmove(dst, src, size);
+            } break;
+
+            case Op_MemSet: {
+                uint64_t size = POP_STACK(vm->Sp, uint64_t);
+                uint8_t value = POP_STACK(vm->Sp, uint8_t);
+                uint8_t* dst  = POP_STACK(vm->Sp, uint8_t*);
+                RaiseHighWater(vm, dst, size);
+                memset(dst, value, size);
+            } break;
+
+            case Op_VecAdd:
+            case Op_VecSub:
+            case Op_VecMin:
+            case Op_VecMax:
+            case Op_VecEqual:
+            case Op_VecLess:
+            {
+                VecOp op          = (VecOp)(vm->Ip[-1] - Op_VecAdd);
+                uint64_t laneSize = DECODE(vm->Ip, uint64_t);
+                uint64_t size     = DECODE(vm->Ip, uint64_t);
+                uint8_t* b        = vm->Sp - size;
+                uint8_t* a        = b - size;
+                if (!Vec_Apply(op, laneSize, a, a, b, size)) {
+                    fflush(stdout);
+                    fprintf(stderr, "Unsupported vector lane size %llu for size %llu\n", laneSize, size);
+                    return VMResult_Error;
+                }
+                vm->Sp = b;
+            } break;
+
+            case Op_VecAddBuffer:
+            case Op_VecSubBuffer:
+            case Op_VecMinBuffer:
+            case Op_VecMaxBuffer:
+            case Op_VecEqualBuffer:
+            case Op_VecLessBuffer:
+            {
+                VecOp op          = (VecOp)(vm->Ip[-1] - Op_VecAddBuffer);
+                uint64_t laneSize = DECODE(vm->Ip, uint64_t);
+                uint64_t count    = POP_STACK(vm->Sp, uint64_t);
+                uint8_t* b        = POP_STACK(vm->Sp, uint8_t*);
+                uint8_t* a        = POP_STACK(vm->Sp, uint8_t*);
+                uint8_t* dst      = POP_STACK(vm->Sp, uint8_t*);
+                RaiseHighWater(vm, dst, count * laneSize);
+                if (!Vec_Apply(op, laneSize, dst, a, b, count * laneSize)) {
+                    fflush(stdout);
+                    fprintf(stderr, "Unsupported vector lane size %llu\n", laneSize);
+                    return VMResult_Error;
+                }
+            } break;
+
+            case Op_Mul: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, PUSH_STACK(vm->Sp, T, (T)((uint64_t)a * (uint64_t)b)));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported multiply size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_DivSigned: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(int, DIVISION_BY_ZERO_CHECK(b); PUSH_STACK(vm->Sp, T, b == -1 ? (T)(0 - (uint64_t)a) : (T)(a / b)));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported divide size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_DivUnsigned: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, DIVISION_BY_ZERO_CHECK(b); PUSH_STACK(vm->Sp, T, a / b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported divide size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_ModSigned: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(int, DIVISION_BY_ZERO_CHECK(b); PUSH_STACK(vm->Sp, T, b == -1 ? 0 : (T)(a % b)));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported modulo size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_ModUnsigned: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, DIVISION_BY_ZERO_CHECK(b); PUSH_STACK(vm->Sp, T, a % b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported modulo size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_And: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, PUSH_STACK(vm->Sp, T, a & b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported and size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_Or: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, PUSH_STACK(vm->Sp, T, a | b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported or size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_Xor: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, PUSH_STACK(vm->Sp, T, a ^ b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported xor size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_Not: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_UNARY_CASES(uint, PUSH_STACK(vm->Sp, T, (T)~a));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported not size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_ShiftLeft: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, PUSH_STACK(vm->Sp, T, (T)(a << (b & (sizeof(T) * 8 - 1)))));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported shift size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_ShiftRight: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, PUSH_STACK(vm->Sp, T, (T)(a >> (b & (sizeof(T) * 8 - 1)))));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported shift size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_ShiftRightArith: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(int, PUSH_STACK(vm->Sp, T, (T)(a >> (b & (sizeof(T) * 8 - 1)))));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported shift size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_Equal: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, PUSH_STACK(vm->Sp, uint8_t, a == b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_LessSigned: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(int, PUSH_STACK(vm->Sp, uint8_t, a < b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_LessUnsigned: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, PUSH_STACK(vm->Sp, uint8_t, a < b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_LessEqualSigned: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(int, PUSH_STACK(vm->Sp, uint8_t, a <= b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_LessEqualUnsigned: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, PUSH_STACK(vm->Sp, uint8_t, a <= b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_JumpEqual: {
+                uint64_t size     = DECODE(vm->Ip, uint64_t);
+                uint64_t location = DECODE(vm->Ip, uint64_t);
+                bool taken        = false;
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, taken = a == b);
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+                if (taken) {
+                    JUMP(location);
+                }
+            } break;
+
+            case Op_JumpNotEqual: {
+                uint64_t size     = DECODE(vm->Ip, uint64_t);
+                uint64_t location = DECODE(vm->Ip, uint64_t);
+                bool taken        = false;
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, taken = a != b);
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+                if (taken) {
+                    JUMP(location);
+                }
+            } break;
+
+            case Op_JumpLessSigned: {
+                uint64_t size     = DECODE(vm->Ip, uint64_t);
+                uint64_t location = DECODE(vm->Ip, uint64_t);
+                bool taken        = false;
+                switch (size) {
+                    INTEGER_BINARY_CASES(int, taken = a < b);
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+                if (taken) {
+                    JUMP(location);
+                }
+            } break;
+
+            case Op_JumpLessUnsigned: {
+                uint64_t size     = DECODE(vm->Ip, uint64_t);
+                uint64_t location = DECODE(vm->Ip, uint64_t);
+                bool taken        = false;
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, taken = a < b);
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+                if (taken) {
+                    JUMP(location);
+                }
+            } break;
+
+            case Op_JumpLessEqualSigned: {
+                uint64_t size     = DECODE(vm->Ip, uint64_t);
+                uint64_t location = DECODE(vm->Ip, uint64_t);
+                bool taken        = false;
+                switch (size) {
+                    INTEGER_BINARY_CASES(int, taken = a <= b);
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+                if (taken) {
+                    JUMP(location);
+                }
+            } break;
+
+            case Op_JumpLessEqualUnsigned: {
+                uint64_t size     = DECODE(vm->Ip, uint64_t);
+                uint64_t location = DECODE(vm->Ip, uint64_t);
+                bool taken        = false;
+                switch (size) {
+                    INTEGER_BINARY_CASES(uint, taken = a <= b);
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+                if (taken) {
+                    JUMP(location);
+                }
+            } break;
+
+            case Op_FloatAdd: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    FLOAT_BINARY_CASES(PUSH_STACK(vm->Sp, T, a + b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float add size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_FloatSub: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    FLOAT_BINARY_CASES(PUSH_STACK(vm->Sp, T, a - b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float subtract size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_FloatMul: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    FLOAT_BINARY_CASES(PUSH_STACK(vm->Sp, T, a * b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float multiply size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_FloatDiv: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    FLOAT_BINARY_CASES(PUSH_STACK(vm->Sp, T, a / b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float divide size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_FloatEqual: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    FLOAT_BINARY_CASES(PUSH_STACK(vm->Sp, uint8_t, a == b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_FloatLess: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    FLOAT_BINARY_CASES(PUSH_STACK(vm->Sp, uint8_t, a < b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_FloatLessEqual: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    FLOAT_BINARY_CASES(PUSH_STACK(vm->Sp, uint8_t, a <= b));
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float compare size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_FloatSqrt: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    case 4: {
+                        float a = POP_STACK(vm->Sp, float);
+                        PUSH_STACK(vm->Sp, float, sqrtf(a));
+                    } break;
+
+                    case 8: {
+                        double a = POP_STACK(vm->Sp, double);
+                        PUSH_STACK(vm->Sp, double, sqrt(a));
+                    } break;
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float sqrt size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_IntToFloat: {
+                uint64_t intSize   = DECODE(vm->Ip, uint64_t);
+                uint64_t floatSize = DECODE(vm->Ip, uint64_t);
+                int64_t value;
+                switch (intSize) {
+                    case 1: {
+                        value = POP_STACK(vm->Sp, int8_t);
+                    } break;
+
+                    case 2: {
+                        value = POP_STACK(vm->Sp, int16_t);
+                    } break;
+
+                    case 4: {
+                        value = POP_STACK(vm->Sp, int32_t);
+                    } break;
+
+                    case 8: {
+                        value = POP_STACK(vm->Sp, int64_t);
+                    } break;
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported int to float int size %llu\n", intSize);
+                        return VMResult_Error;
+                    } break;
+                }
+                switch (floatSize) {
+                    case 4: {
+                        PUSH_STACK(vm->Sp, float, (float)value);
+                    } break;
+
+                    case 8: {
+                        PUSH_STACK(vm->Sp, double, (double)value);
+                    } break;
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported int to float float size %llu\n", floatSize);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_FloatToInt: {
+                uint64_t floatSize = DECODE(vm->Ip, uint64_t);
+                uint64_t intSize   = DECODE(vm->Ip, uint64_t);
+                double value;
+                switch (floatSize) {
+                    case 4: {
+                        value = POP_STACK(vm->Sp, float);
+                    } break;
+
+                    case 8: {
+                        value = POP_STACK(vm->Sp, double);
+                    } break;
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float to int float size %llu\n", floatSize);
+                        return VMResult_Error;
+                    } break;
+                }
+                switch (intSize) {
+                    case 1: {
+                        PUSH_STACK(vm->Sp, int8_t, (int8_t)FloatToInt(value, INT8_MIN, INT8_MAX));
+                    } break;
+
+                    case 2: {
+                        PUSH_STACK(vm->Sp, int16_t, (int16_t)FloatToInt(value, INT16_MIN, INT16_MAX));
+                    } break;
+
+                    case 4: {
+                        PUSH_STACK(vm->Sp, int32_t, (int32_t)FloatToInt(value, INT32_MIN, INT32_MAX));
+                    } break;
+
+                    case 8: {
+                        PUSH_STACK(vm->Sp, int64_t, FloatToInt(value, INT64_MIN, INT64_MAX));
+                    } break;
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float to int int size %llu\n", intSize);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_PrintFloat: {
+                uint64_t size = DECODE(vm->Ip, uint64_t);
+                switch (size) {
+                    case 4: {
+                        printf("%.*g\n", FLT_DIG, POP_STACK(vm->Sp, float));
+                    } break;
+
+                    case 8: {
+                        printf("%.*g\n", DBL_DIG, POP_STACK(vm->Sp, double));
+                    } break;
+
+                    default: {
+                        fflush(stdout);
+                        fprintf(stderr, "Unsupported float print size %llu\n", size);
+                        return VMResult_Error;
+                    } break;
+                }
+            } break;
+
+            case Op_HeapAlloc: {
+                uint64_t size = POP_STACK(vm->Sp, uint64_t);
+                void* ptr     = Heap_Allocate(&vm->Heap, size);
+                if (!ptr) {
+                    fflush(stdout);
+                    fprintf(stderr, "Failed to allocate %llu bytes from the heap\n", size);
+                    return VMResult_Error;
+                }
+                PUSH_STACK(vm->Sp, void*, ptr);
+            } break;
+
+            case Op_HeapFree: {
+                void* ptr = POP_STACK(vm->Sp, void*);
+                Heap_Free(&vm->Heap, ptr);
+            } break;
+
+            case Op_HeapReset: {
+                Heap_Reset(&vm->Heap);
+            } break;
+
+            default: {
+                fflush(stdout);
+                fprintf(stderr, "Invalid instruction\n");
+                return VMResult_Error;
             } break;
         }
     }
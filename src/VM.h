@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Heap.h"
+
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -157,17 +159,606 @@ typedef enum Op {
     // Result:
     //      Stack: ret-value
     Op_CallCFunc,
+
+    // Copies size bytes from src-ptr to dst-ptr, the regions must not overlap
+    // Arguments:
+    //      Inst: op
+    //      Stack: dst-ptr src-ptr size
+    // Result:
+    //      Stack:
+    Op_MemCopy,
+
+    // Copies size bytes from src-ptr to dst-ptr, the regions may overlap
+    // Arguments:
+    //      Inst: op
+    //      Stack: dst-ptr src-ptr size
+    // Result:
+    //      Stack:
+    Op_MemMove,
+
+    // Fills size bytes at dst-ptr with a 1 byte value
+    // Arguments:
+    //      Inst: op
+    //      Stack: dst-ptr value size
+    // Result:
+    //      Stack:
+    Op_MemSet,
+
+    // Adds the lanes of the 2 vectors on the top of the stack
+    // Arguments:
+    //      Inst: op lane-size size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a+b)
+    Op_VecAdd,
+
+    // Subtracts the lanes of the 2 vectors on the top of the stack
+    // Arguments:
+    //      Inst: op lane-size size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a-b)
+    Op_VecSub,
+
+    // Takes the signed minimum of the lanes of the 2 vectors on the top of the stack
+    // Arguments:
+    //      Inst: op lane-size size
+    //      Stack: a b
+    // Result:
+    //      Stack: min(a, b)
+    Op_VecMin,
+
+    // Takes the signed maximum of the lanes of the 2 vectors on the top of the stack
+    // Arguments:
+    //      Inst: op lane-size size
+    //      Stack: a b
+    // Result:
+    //      Stack: max(a, b)
+    Op_VecMax,
+
+    // Compares the lanes of the 2 vectors on the top of the stack for equality, true lanes are all ones and false lanes are zero
+    // Arguments:
+    //      Inst: op lane-size size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a==b)
+    Op_VecEqual,
+
+    // Compares the lanes of the 2 vectors on the top of the stack for signed less than, true lanes are all ones
+    // Arguments:
+    //      Inst: op lane-size size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a<b)
+    Op_VecLess,
+
+    // Adds the lanes of 2 buffers of count lanes each and writes the result to dst-ptr
+    // Arguments:
+    //      Inst: op lane-size
+    //      Stack: dst-ptr a-ptr b-ptr count
+    // Result:
+    //      Stack:
+    Op_VecAddBuffer,
+
+    // Subtracts the lanes of 2 buffers of count lanes each and writes the result to dst-ptr
+    // Arguments:
+    //      Inst: op lane-size
+    //      Stack: dst-ptr a-ptr b-ptr count
+    // Result:
+    //      Stack:
+    Op_VecSubBuffer,
+
+    // Takes the signed minimum of the lanes of 2 buffers of count lanes each and writes the result to dst-ptr
+    // Arguments:
+    //      Inst: op lane-size
+    //      Stack: dst-ptr a-ptr b-ptr count
+    // Result:
+    //      Stack:
+    Op_VecMinBuffer,
+
+    // Takes the signed maximum of the lanes of 2 buffers of count lanes each and writes the result to dst-ptr
+    // Arguments:
+    //      Inst: op lane-size
+    //      Stack: dst-ptr a-ptr b-ptr count
+    // Result:
+    //      Stack:
+    Op_VecMaxBuffer,
+
+    // Compares for equality the lanes of 2 buffers of count lanes each and writes the result to dst-ptr
+    // Arguments:
+    //      Inst: op lane-size
+    //      Stack: dst-ptr a-ptr b-ptr count
+    // Result:
+    //      Stack:
+    Op_VecEqualBuffer,
+
+    // Compares for signed less than the lanes of 2 buffers of count lanes each and writes the result to dst-ptr
+    // Arguments:
+    //      Inst: op lane-size
+    //      Stack: dst-ptr a-ptr b-ptr count
+    // Result:
+    //      Stack:
+    Op_VecLessBuffer,
+
+    // Multiplies the 2 numbers on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a*b)
+    Op_Mul,
+
+    // Divides the 2 signed numbers on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a/b)
+    Op_DivSigned,
+
+    // Divides the 2 unsigned numbers on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a/b)
+    Op_DivUnsigned,
+
+    // Takes the remainder of dividing the 2 signed numbers on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a%b)
+    Op_ModSigned,
+
+    // Takes the remainder of dividing the 2 unsigned numbers on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a%b)
+    Op_ModUnsigned,
+
+    // Bitwise ands the 2 numbers on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a&b)
+    Op_And,
+
+    // Bitwise ors the 2 numbers on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a|b)
+    Op_Or,
+
+    // Bitwise xors the 2 numbers on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a^b)
+    Op_Xor,
+
+    // Bitwise inverts the number on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a
+    // Result:
+    //      Stack: (~a)
+    Op_Not,
+
+    // Shifts a left by b bits, b is masked to the bit width of a
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a<<b)
+    Op_ShiftLeft,
+
+    // Shifts a right by b bits filling with zeros, b is masked to the bit width of a
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a>>b)
+    Op_ShiftRight,
+
+    // Shifts a right by b bits filling with the sign bit, b is masked to the bit width of a
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a>>b)
+    Op_ShiftRightArith,
+
+    // Compares the 2 numbers on the top of the stack for equality, the result is 1 byte
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a==b)
+    Op_Equal,
+
+    // Compares the 2 signed numbers on the top of the stack, the result is 1 byte
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a<b)
+    Op_LessSigned,
+
+    // Compares the 2 unsigned numbers on the top of the stack, the result is 1 byte
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a<b)
+    Op_LessUnsigned,
+
+    // Compares the 2 signed numbers on the top of the stack, the result is 1 byte
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a<=b)
+    Op_LessEqualSigned,
+
+    // Compares the 2 unsigned numbers on the top of the stack, the result is 1 byte
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a<=b)
+    Op_LessEqualUnsigned,
+
+    // Jumps to the location if a is equal to b
+    // Arguments:
+    //      Inst: op size loc
+    //      Stack: a b
+    // Result:
+    //      Stack:
+    Op_JumpEqual,
+
+    // Jumps to the location if a is not equal to b
+    // Arguments:
+    //      Inst: op size loc
+    //      Stack: a b
+    // Result:
+    //      Stack:
+    Op_JumpNotEqual,
+
+    // Jumps to the location if a is less than b, both signed
+    // Arguments:
+    //      Inst: op size loc
+    //      Stack: a b
+    // Result:
+    //      Stack:
+    Op_JumpLessSigned,
+
+    // Jumps to the location if a is less than b, both unsigned
+    // Arguments:
+    //      Inst: op size loc
+    //      Stack: a b
+    // Result:
+    //      Stack:
+    Op_JumpLessUnsigned,
+
+    // Jumps to the location if a is less than or equal to b, both signed
+    // Arguments:
+    //      Inst: op size loc
+    //      Stack: a b
+    // Result:
+    //      Stack:
+    Op_JumpLessEqualSigned,
+
+    // Jumps to the location if a is less than or equal to b, both unsigned
+    // Arguments:
+    //      Inst: op size loc
+    //      Stack: a b
+    // Result:
+    //      Stack:
+    Op_JumpLessEqualUnsigned,
+
+    // Adds the 2 floats on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a+b)
+    Op_FloatAdd,
+
+    // Subtracts the 2 floats on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a-b)
+    Op_FloatSub,
+
+    // Multiplies the 2 floats on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a*b)
+    Op_FloatMul,
+
+    // Divides the 2 floats on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a/b)
+    Op_FloatDiv,
+
+    // Compares the 2 floats on the top of the stack for equality, the result is 1 byte
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a==b)
+    Op_FloatEqual,
+
+    // Compares the 2 floats on the top of the stack, the result is 1 byte
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a<b)
+    Op_FloatLess,
+
+    // Compares the 2 floats on the top of the stack, the result is 1 byte
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a b
+    // Result:
+    //      Stack: (a<=b)
+    Op_FloatLessEqual,
+
+    // Takes the square root of the float on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: a
+    // Result:
+    //      Stack: sqrt(a)
+    Op_FloatSqrt,
+
+    // Converts a signed integer to a float
+    // Arguments:
+    //      Inst: op int-size float-size
+    //      Stack: int
+    // Result:
+    //      Stack: float
+    Op_IntToFloat,
+
+    // Converts a float to a signed integer, truncating towards zero and saturating when out of range
+    // Arguments:
+    //      Inst: op float-size int-size
+    //      Stack: float
+    // Result:
+    //      Stack: int
+    Op_FloatToInt,
+
+    // Prints the float on the top of the stack
+    // Arguments:
+    //      Inst: op size
+    //      Stack: float
+    // Result:
+    //      Stack:
+    Op_PrintFloat,
+
+    // Allocates memory from the VM heap
+    // Arguments:
+    //      Inst: op
+    //      Stack: size
+    // Result:
+    //      Stack: ptr
+    Op_HeapAlloc,
+
+    // Frees memory allocated with heap-alloc
+    // Arguments:
+    //      Inst: op
+    //      Stack: ptr
+    // Result:
+    //      Stack:
+    Op_HeapFree,
+
+    // Frees every allocation in the VM heap at once
+    // Arguments:
+    //      Inst: op
+    //      Stack:
+    // Result:
+    //      Stack:
+    Op_HeapReset,
+
+    // Calls a function that returns straight to the caller of the current function, replaces a call followed by a ret
+    // Arguments:
+    //      Inst: op arg-size
+    //      Stack: ret-loc ptr arg-data
+    // Result:
+    //      Stack: ret-loc arg-data
+    Op_TailCall,
+
+    // Jumps to the location at index in the table, falls through when the index is out of range
+    // Arguments:
+    //      Inst: op count locs
+    //      Stack: index
+    // Result:
+    //      Stack:
+    Op_JumpTable,
+
+    // Stops the VM so the host can snapshot it, running the VM again continues after the checkpoint
+    // Arguments:
+    //      Inst: op
+    //      Stack:
+    // Result:
+    //      Stack:
+    Op_Checkpoint,
+
+    // Declares a host function, running it does nothing, the func is filled in by VM_BindExterns before the code runs
+    // The name is followed by a 0 byte so it can be passed to the host as it is
+    // Arguments:
+    //      Inst: op func arg-count arg-sizes ret-size name-length name
+    //      Stack:
+    // Result:
+    //      Stack:
+    Op_Extern,
+
+    // Calls the host function of the extern declared at the location
+    // Arguments:
+    //      Inst: op loc
+    //      Stack: arg-data
+    // Result:
+    //      Stack: ret-value
+    Op_CallExtern,
+
+    // Opens a file for io-read and io-write, the path is not null terminated and mode is an IoMode
+    // Arguments:
+    //      Inst: op
+    //      Stack: path-ptr path-length mode
+    // Result:
+    //      Stack: handle
+    Op_IoOpen,
+
+    // Reads up to size bytes at the offset of the file into the buffer, count is IO_FAILED on errors and 0 at the end
+    // With an I/O queue the VM waits in the queue while the read is in flight
+    // Arguments:
+    //      Inst: op
+    //      Stack: handle buffer-ptr size offset
+    // Result:
+    //      Stack: count
+    Op_IoRead,
+
+    // Writes up to size bytes from the buffer at the offset of the file, count is IO_FAILED on errors
+    // With an I/O queue the VM waits in the queue while the write is in flight
+    // Arguments:
+    //      Inst: op
+    //      Stack: handle buffer-ptr size offset
+    // Result:
+    //      Stack: count
+    Op_IoWrite,
+
+    // Closes a handle from io-open
+    // Arguments:
+    //      Inst: op
+    //      Stack: handle
+    // Result:
+    //      Stack:
+    Op_IoClose,
+
+    // Holds read-only bytes in the code, running it skips over them
+    // Arguments:
+    //      Inst: op size data
+    //      Stack:
+    // Result:
+    //      Stack:
+    Op_Data,
+
+    // Pushes a pointer to the bytes of the data at the location, the bytes must not be written to
+    // Arguments:
+    //      Inst: op loc
+    //      Stack:
+    // Result:
+    //      Stack: ptr
+    Op_PushData,
+
+    // Starts the timing region id, regions may overlap and nest but a region cannot be started again while it runs
+    // Arguments:
+    //      Inst: op id
+    //      Stack:
+    // Result:
+    //      Stack:
+    Op_TimerBegin,
+
+    // Ends the timing region id and adds the time since its timer-begin to the stats of the region
+    // Arguments:
+    //      Inst: op id
+    //      Stack:
+    // Result:
+    //      Stack:
+    Op_TimerEnd,
 } Op;
 
+#define VM_DEFAULT_STACK_SIZE (4 * 1024 * 1024)
+// Externs take integer or pointer arguments of up to 8 bytes each
+#define VM_MAX_EXTERN_ARGS 8
+// Never runs out in practice, the VM starts with it after being created or reset
+#define VM_UNLIMITED_FUEL UINT64_MAX
+// The ids of timing regions go from 0 up to this
+#define VM_TIMER_COUNT 64
+
+typedef struct IoQueue IoQueue;
+typedef struct IoRequest IoRequest;
+typedef struct Tier Tier;
+
+// The stats of a timing region in Timer_Now ticks, a region that never ended has a count of 0
+typedef struct VMTimer {
+    uint64_t Count;
+    uint64_t TotalTicks;
+    uint64_t MinTicks;
+    uint64_t MaxTicks;
+    // When the running region started, 0 while it is not running
+    uint64_t Start;
+} VMTimer;
+
 typedef struct VM {
     uint8_t* Code;
     uint64_t CodeSize;
     uint8_t* Ip;
-    uint8_t Stack[4 * 1024 * 1024];
+    uint8_t* Stack;
     uint64_t StackSize;
     uint8_t* Sp;
+    // The highest the stack was written since the last reset, the stack above it is still zero
+    // Covers the stack pointer and the ops that write through a pointer, but not host functions writing into the stack
+    uint8_t* StackHighWater;
+    // Set when the stack is a copy-on-write view of a snapshot instead of being allocated
+    bool StackIsMapped;
+    // The number of calls, rets and backward jumps the VM can still take before VM_Run yields, the host refills it between runs
+    uint64_t Fuel;
+    // When set, reads and writes complete through the queue and VM_Run returns VMResult_Waiting instead of blocking
+    IoQueue* Io;
+    // Reused for every read and write, a VM has at most one in flight
+    IoRequest* IoRequest;
+    // Counts backward jumps and runs the loops that got hot, allocated on the first backward jump and dropped by VM_Load
+    Tier* Tier;
+    Heap Heap;
+    // Cleared by VM_Reset, so they cover a single run of the program
+    VMTimer Timers[VM_TIMER_COUNT];
 } VM;
 
-void VM_Init(VM* vm, uint8_t* code, uint64_t codeSize);
+typedef enum VMResult {
+    VMResult_Error,
+    VMResult_Exit,
+    // Stopped at a checkpoint op, VM_Run can be called again to continue
+    VMResult_Checkpoint,
+    // Ran out of fuel at a call, ret or backward jump, VM_Run can be called again with more fuel to continue
+    VMResult_Yielded,
+    // Started a read or write on its I/O queue, IoQueue_Wait hands the VM back once the result is on the stack
+    VMResult_Waiting,
+} VMResult;
+
+// Allocates a zeroed stack, the VM can then run any number of programs through VM_Load
+bool VM_Create(VM* vm, uint64_t stackSize);
+void VM_Destroy(VM* vm);
+// Resets the VM and points it at new code, the code is not copied
+void VM_Load(VM* vm, uint8_t* code, uint64_t codeSize);
+// Only clears the part of the stack that was used since the last reset
+void VM_Reset(VM* vm);
 void VM_PrintStack(VM* vm);
-bool VM_Run(VM* vm);
+// Prints the count and the min, average and max time of every timing region that ended, does nothing when none did
+void VM_PrintTimers(VM* vm);
+// Returns the length in bytes of the instruction including its operands, or 0 if the op is invalid
+uint64_t VM_GetInstructionLength(const uint8_t* ip);
+VMResult VM_Run(VM* vm);
+
+// Returns the host function for an extern, or NULL to look for it in the modules loaded into the process
+typedef void* (*VMExternResolver)(void* userData, const char* name);
+// Fills in the function of every extern declared in the code, call-extern then calls it without looking anything up
+// Every extern that could not be found is reported and left unbound, calling it is an error
+// Declarations with argument sizes outside 1 to 8 bytes or a result over 8 bytes fail the whole binding
+bool VM_BindExterns(uint8_t* code, uint64_t codeSize, VMExternResolver resolver, void* userData);
@@ -0,0 +1,58 @@
+// Assembles a file the way --watch does and the way a plain run does, and checks that both link to the same code
+// Run on tests/import.vm, where the file and the modules it imports define labels with the same names
+
+#include "Assembler.h"
+#include "Optimizer.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool IsSameCode(ByteArray* linked, Emitter* emitter) {
+    return linked->Length == emitter->Code.Length && memcmp(linked->Data, emitter->Code.Data, linked->Length) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    String path = String_FromCString(argv[1]);
+
+    Lexer lexer;
+    if (!Lexer_Create(&lexer, path)) {
+        return EXIT_FAILURE;
+    }
+    Emitter emitter;
+    if (!Emitter_CreatePreLexed(&emitter, lexer, 0)) {
+        return EXIT_FAILURE;
+    }
+    Emitter_Emit(&emitter);
+    if (emitter.WasError) {
+        return EXIT_FAILURE;
+    }
+    Optimizer_Optimize(&emitter);
+
+    Assembler assembler;
+    if (!Assembler_Create(&assembler, path)) {
+        return EXIT_FAILURE;
+    }
+
+    // The second update links the sections it kept from the first one
+    bool passed = true;
+    for (uint64_t i = 0; i < 2; i++) {
+        if (!Assembler_Update(&assembler)) {
+            fprintf(stderr, "assembler-link: Update %llu failed\n", i + 1);
+            passed = false;
+            break;
+        }
+        if (!IsSameCode(&assembler.Code, &emitter)) {
+            fprintf(stderr, "assembler-link: Update %llu linked different code than the emitter\n", i + 1);
+            passed = false;
+        }
+    }
+
+    Assembler_Destroy(&assembler);
+    Emitter_Destroy(&emitter);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
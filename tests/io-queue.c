@@ -0,0 +1,272 @@
+// Runs a program that uses a file and one that uses a socket on a single thread, both wait in one VMIoQueue
+// Exits with 0 when every read and write the programs report is what was expected
+
+#include "LibVM.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #include <WinSock2.h>
+    #include <Windows.h>
+#else
+    #error Unsupported platform
+#endif
+
+// Small, so the programs yield a few times around their I/O
+#define TEST_FUEL 4
+
+// The first value on the stack of both programs is the handle, the second the buffer that is read into
+#define TEST_PROGRAM_MACROS                                                                                                       \
+    "macro handle (\n"                                                                                                            \
+    "    get-stack-bottom\n"                                                                                                      \
+    "    load 8\n"                                                                                                                \
+    ")\n"                                                                                                                         \
+    "macro buffer (\n"                                                                                                            \
+    "    get-stack-bottom\n"                                                                                                      \
+    "    push 8 8\n"                                                                                                              \
+    "    add 8\n"                                                                                                                 \
+    "    load 8\n"                                                                                                                \
+    ")\n"
+
+static const char FileProgram[] = TEST_PROGRAM_MACROS
+    "extern wrote (8) 0\n"
+    "extern received (8 8) 0\n"
+    "data path \"io-queue.txt\"\n"
+    "data message \"queued\"\n"
+    "push-data path\n"
+    "push 8 12\n"
+    "push 8 2\n"
+    "io-open\n"
+    "push 8 16\n"
+    "heap-alloc\n"
+    "!handle\n"
+    "push-data message\n"
+    "push 8 6\n"
+    "push 8 0\n"
+    "io-write\n"
+    "call-extern wrote\n"
+    "!buffer\n"
+    "!handle\n"
+    "!buffer\n"
+    "push 8 16\n"
+    "push 8 0\n"
+    "io-read\n"
+    "call-extern received\n"
+    "!handle\n"
+    "io-close\n"
+    "exit\n";
+
+static const char SocketProgram[] = TEST_PROGRAM_MACROS
+    "extern get-socket () 8\n"
+    "extern wrote (8) 0\n"
+    "extern received (8 8) 0\n"
+    "data message \"ping\"\n"
+    "call-extern get-socket\n"
+    "push 8 16\n"
+    "heap-alloc\n"
+    "!handle\n"
+    "push-data message\n"
+    "push 8 4\n"
+    "push 8 0\n"
+    "io-write\n"
+    "call-extern wrote\n"
+    "!buffer\n"
+    "!handle\n"
+    "!buffer\n"
+    "push 8 16\n"
+    "push 8 0\n"
+    "io-read\n"
+    "call-extern received\n"
+    "exit\n";
+
+// What one program reported through its externs
+typedef struct TestReport {
+    uint64_t WriteCount;
+    uint64_t ReadCount;
+    char Read[16];
+} TestReport;
+
+static uint64_t Socket;
+// Both programs bind the same extern names, so the host points this at the report of the program it is about to run
+static TestReport* CurrentReport;
+
+static uint64_t GetSocket(void) {
+    return Socket;
+}
+
+static uint64_t Wrote(uint64_t count) {
+    CurrentReport->WriteCount = count;
+    return 0;
+}
+
+static uint64_t Received(uint64_t buffer, uint64_t count) {
+    CurrentReport->ReadCount = count;
+    if (count <= sizeof(CurrentReport->Read)) {
+        memcpy(CurrentReport->Read, (const void*)buffer, count);
+    }
+    return 0;
+}
+
+static void* ResolveExtern(void* userData, const char* name) {
+    if (strcmp(name, "get-socket") == 0) {
+        return (void*)GetSocket;
+    }
+    if (strcmp(name, "wrote") == 0) {
+        return (void*)Wrote;
+    }
+    if (strcmp(name, "received") == 0) {
+        return (void*)Received;
+    }
+    return NULL;
+}
+
+typedef struct TestContext {
+    VMContext* Context;
+    TestReport Report;
+    bool HasExited;
+} TestContext;
+
+// Runs the context until it waits in the queue or exits
+static bool Step(TestContext* test) {
+    CurrentReport = &test->Report;
+    VMRunResult result;
+    do {
+        result = VMContext_RunSlice(test->Context, TEST_FUEL);
+    } while (result == VMRunResult_Yielded);
+
+    if (result == VMRunResult_Error) {
+        return false;
+    }
+    test->HasExited = result == VMRunResult_Exit;
+    return true;
+}
+
+static bool Check(bool condition, const char* message) {
+    if (!condition) {
+        fflush(stdout);
+        fprintf(stderr, "io-queue: %s\n", message);
+    }
+    return condition;
+}
+
+// A connected pair of sockets on the loopback interface, both can be used for overlapped I/O
+static bool CreateSocketPair(SOCKET* client, SOCKET* server) {
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET) {
+        return false;
+    }
+
+    struct sockaddr_in address = {};
+    address.sin_family         = AF_INET;
+    address.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+    int addressLength          = sizeof(address);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 1) != 0 ||
+        getsockname(listener, (struct sockaddr*)&address, &addressLength) != 0) {
+        closesocket(listener);
+        return false;
+    }
+
+    *client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (*client == INVALID_SOCKET) {
+        closesocket(listener);
+        return false;
+    }
+    if (connect(*client, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        closesocket(*client);
+        closesocket(listener);
+        return false;
+    }
+
+    *server = accept(listener, NULL, NULL);
+    closesocket(listener);
+    if (*server == INVALID_SOCKET) {
+        closesocket(*client);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    WSADATA winsock;
+    if (WSAStartup(MAKEWORD(2, 2), &winsock) != 0) {
+        fprintf(stderr, "io-queue: Failed to start Winsock\n");
+        return EXIT_FAILURE;
+    }
+
+    SOCKET client;
+    SOCKET server;
+    if (!CreateSocketPair(&client, &server)) {
+        fprintf(stderr, "io-queue: Failed to connect a pair of sockets\n");
+        WSACleanup();
+        return EXIT_FAILURE;
+    }
+    Socket = (uint64_t)client;
+
+    // Sent before the program reads, so its read completes without the host having to answer on another thread
+    if (send(server, "pong", 4, 0) != 4) {
+        fprintf(stderr, "io-queue: Failed to send to the program\n");
+        return EXIT_FAILURE;
+    }
+
+    VMIoQueue* queue = VMIoQueue_Create();
+    if (!queue || !VMIoQueue_AddHandle(queue, Socket)) {
+        fprintf(stderr, "io-queue: Failed to create the queue\n");
+        return EXIT_FAILURE;
+    }
+
+    VMProgram* programs[2] = {
+        VMProgram_AssembleSource("file", FileProgram, sizeof(FileProgram) - 1),
+        VMProgram_AssembleSource("socket", SocketProgram, sizeof(SocketProgram) - 1),
+    };
+    TestContext tests[2] = {};
+    for (uint64_t i = 0; i < 2; i++) {
+        if (!programs[i] || !VMProgram_BindExterns(programs[i], ResolveExtern, NULL)) {
+            return EXIT_FAILURE;
+        }
+        tests[i].Context = VMContext_Create(0);
+        if (!tests[i].Context) {
+            return EXIT_FAILURE;
+        }
+        VMContext_SetIoQueue(tests[i].Context, queue);
+        VMContext_Start(tests[i].Context, programs[i]);
+    }
+
+    // Both programs start their first write before either is handed back by the queue
+    bool passed = true;
+    for (uint64_t i = 0; i < 2; i++) {
+        passed &= Check(Step(&tests[i]), "A program failed before waiting");
+        passed &= Check(!tests[i].HasExited, "A program exited without waiting in the queue");
+    }
+
+    VMContext* context;
+    while (passed && (context = VMIoQueue_Wait(queue))) {
+        TestContext* test = context == tests[0].Context ? &tests[0] : &tests[1];
+        passed &= Check(Step(test), "A program failed after waiting");
+    }
+
+    char received[4] = {};
+    passed &= Check(recv(server, received, sizeof(received), 0) == 4 && memcmp(received, "ping", 4) == 0,
+                    "The socket program did not send ping");
+    for (uint64_t i = 0; i < 2; i++) {
+        passed &= Check(tests[i].HasExited, "A program did not exit");
+    }
+    passed &= Check(tests[0].Report.WriteCount == 6, "The file program did not write its message");
+    passed &= Check(tests[0].Report.ReadCount == 6 && memcmp(tests[0].Report.Read, "queued", 6) == 0,
+                    "The file program did not read its message back");
+    passed &= Check(tests[1].Report.WriteCount == 4, "The socket program did not write its message");
+    passed &= Check(tests[1].Report.ReadCount == 4 && memcmp(tests[1].Report.Read, "pong", 4) == 0,
+                    "The socket program did not receive pong");
+
+    for (uint64_t i = 0; i < 2; i++) {
+        VMContext_Destroy(tests[i].Context);
+        VMProgram_Destroy(programs[i]);
+    }
+    VMIoQueue_Destroy(queue);
+    closesocket(client);
+    closesocket(server);
+    WSACleanup();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}